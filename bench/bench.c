@@ -0,0 +1,75 @@
+#include "bench.h"
+
+#include "fu/core/alloc.h"
+#include "fu/core/trace.h"
+
+#include <stdatomic.h>
+
+#define MAX_RUN_COUNT 1000
+
+static volatile uint64_t sink;
+
+void keep_value(uint64_t value) {
+    sink ^= value;
+}
+
+void start_bench_timer(BenchTimer* timer) {
+    timer->begin_alloc_count = atomic_load_explicit(&alloc_count, memory_order_relaxed);
+    timer->begin_time = get_time_in_ns();
+}
+
+void stop_bench_timer(BenchTimer* timer) {
+    timer->elapsed_time += get_time_in_ns() - timer->begin_time;
+    timer->alloc_count += atomic_load_explicit(&alloc_count, memory_order_relaxed) - timer->begin_alloc_count;
+}
+
+BenchResult run_bench(const Bench* bench, uint64_t min_time) {
+    uint64_t best_time = UINT64_MAX, total_time = 0;
+    size_t total_alloc_count = 0, run_count = 0;
+    while (run_count < MAX_RUN_COUNT && (run_count == 0 || total_time < min_time)) {
+        BenchTimer timer = { 0 };
+        bench->run(&timer, bench->op_count);
+        best_time = timer.elapsed_time < best_time ? timer.elapsed_time : best_time;
+        total_time += timer.elapsed_time;
+        total_alloc_count += timer.alloc_count;
+        run_count++;
+    }
+    double op_count = (double)bench->op_count;
+    return (BenchResult) {
+        .name = bench->name,
+        .op_count = bench->op_count,
+        .run_count = run_count,
+        .best_ns_per_op = (double)best_time / op_count,
+        .mean_ns_per_op = (double)total_time / (op_count * (double)run_count),
+        .allocs_per_op = (double)total_alloc_count / (op_count * (double)run_count)
+    };
+}
+
+void print_bench_results(FILE* file, const BenchResult* results, size_t count) {
+    fprintf(file, "%-32s %10s %12s %12s %12s\n", "benchmark", "runs", "best ns/op", "mean ns/op", "allocs/op");
+    for (size_t i = 0; i < count; ++i) {
+        fprintf(file, "%-32s %10zu %12.2f %12.2f %12.4f\n",
+            results[i].name,
+            results[i].run_count,
+            results[i].best_ns_per_op,
+            results[i].mean_ns_per_op,
+            results[i].allocs_per_op);
+    }
+}
+
+void write_bench_results_json(FILE* file, const BenchResult* results, size_t count) {
+    fprintf(file, "{\"benchmarks\":[");
+    for (size_t i = 0; i < count; ++i) {
+        fprintf(file,
+            "%s\n{\"name\":\"%s\",\"op_count\":%zu,\"run_count\":%zu,"
+            "\"best_ns_per_op\":%.3f,\"mean_ns_per_op\":%.3f,\"allocs_per_op\":%.6f}",
+            i > 0 ? "," : "",
+            results[i].name,
+            results[i].op_count,
+            results[i].run_count,
+            results[i].best_ns_per_op,
+            results[i].mean_ns_per_op,
+            results[i].allocs_per_op);
+    }
+    fprintf(file, "\n]}\n");
+}
@@ -0,0 +1,58 @@
+#ifndef FU_BENCH_BENCH_H
+#define FU_BENCH_BENCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+/*
+ * Minimal harness for micro-benchmarks. A benchmark performs a given number of operations, and
+ * surrounds the code to measure with calls to `start_bench_timer()` and `stop_bench_timer()`, so
+ * that setup and cleanup code is not measured. The harness runs each benchmark repeatedly, and
+ * reports the best time per operation, along with the number of allocations per operation.
+ */
+
+typedef struct {
+    uint64_t begin_time;
+    uint64_t elapsed_time;
+    size_t begin_alloc_count;
+    size_t alloc_count;
+} BenchTimer;
+
+typedef struct {
+    const char* name;
+    void (*run)(BenchTimer*, size_t op_count);
+    size_t op_count;
+} Bench;
+
+typedef struct {
+    const char* name;
+    size_t op_count;
+    size_t run_count;
+    double best_ns_per_op;
+    double mean_ns_per_op;
+    double allocs_per_op;
+} BenchResult;
+
+void start_bench_timer(BenchTimer*);
+void stop_bench_timer(BenchTimer*);
+
+/// Runs the given benchmark until at least `min_time` nanoseconds have been measured.
+BenchResult run_bench(const Bench*, uint64_t min_time);
+
+void print_bench_results(FILE*, const BenchResult*, size_t count);
+void write_bench_results_json(FILE*, const BenchResult*, size_t count);
+
+/// Prevents the compiler from optimizing away the computation of the given value.
+void keep_value(uint64_t);
+
+/// Benchmarks for the data structures in `fu/core`.
+extern const Bench core_benches[];
+extern const size_t core_bench_count;
+
+/// Benchmarks for the creation of types in `fu/lang/type_table.h`.
+extern const Bench type_benches[];
+extern const size_t type_bench_count;
+
+#endif
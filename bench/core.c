@@ -0,0 +1,271 @@
+#include "bench.h"
+
+#include "fu/core/hash_table.h"
+#include "fu/core/hash.h"
+#include "fu/core/str_pool.h"
+#include "fu/core/mem_pool.h"
+#include "fu/core/dyn_array.h"
+#include "fu/core/format.h"
+#include "fu/core/alloc.h"
+
+#include <string.h>
+
+#define OP_COUNT 65536
+#define MAX_STR_LEN 32
+
+static bool compare_uint32(const void* left, const void* right) {
+    return *(const uint32_t*)left == *(const uint32_t*)right;
+}
+
+static inline uint32_t get_key(size_t i) {
+    // Spread the keys so that they are not inserted in hash order
+    return (uint32_t)(i * UINT32_C(2654435761));
+}
+
+static inline HashCode hash_key(uint32_t key) {
+    return hash_uint32(hash_init(), key);
+}
+
+static HashTable make_filled_hash_table(size_t op_count) {
+    HashTable hash_table = new_hash_table(sizeof(uint32_t));
+    for (size_t i = 0; i < op_count; ++i) {
+        uint32_t key = get_key(i);
+        insert_in_hash_table(&hash_table, &key, hash_key(key), sizeof(uint32_t), compare_uint32);
+    }
+    return hash_table;
+}
+
+static void bench_hash_table_insert(BenchTimer* timer, size_t op_count) {
+    HashTable hash_table = new_hash_table(sizeof(uint32_t));
+    start_bench_timer(timer);
+    for (size_t i = 0; i < op_count; ++i) {
+        uint32_t key = get_key(i);
+        insert_in_hash_table(&hash_table, &key, hash_key(key), sizeof(uint32_t), compare_uint32);
+    }
+    stop_bench_timer(timer);
+    free_hash_table(&hash_table);
+}
+
+static void bench_hash_table_find_hit(BenchTimer* timer, size_t op_count) {
+    HashTable hash_table = make_filled_hash_table(op_count);
+    size_t found = 0;
+    start_bench_timer(timer);
+    for (size_t i = 0; i < op_count; ++i) {
+        uint32_t key = get_key(op_count - i - 1);
+        found += find_in_hash_table(&hash_table, &key, hash_key(key), sizeof(uint32_t), compare_uint32) != NULL;
+    }
+    stop_bench_timer(timer);
+    keep_value(found);
+    free_hash_table(&hash_table);
+}
+
+static void bench_hash_table_find_miss(BenchTimer* timer, size_t op_count) {
+    HashTable hash_table = make_filled_hash_table(op_count);
+    size_t found = 0;
+    start_bench_timer(timer);
+    for (size_t i = 0; i < op_count; ++i) {
+        uint32_t key = get_key(op_count + i);
+        found += find_in_hash_table(&hash_table, &key, hash_key(key), sizeof(uint32_t), compare_uint32) != NULL;
+    }
+    stop_bench_timer(timer);
+    keep_value(found);
+    free_hash_table(&hash_table);
+}
+
+static void bench_hash_table_remove(BenchTimer* timer, size_t op_count) {
+    HashTable hash_table = make_filled_hash_table(op_count);
+    start_bench_timer(timer);
+    for (size_t i = 0; i < op_count; ++i) {
+        uint32_t key = get_key(i);
+        void* elem = find_in_hash_table(&hash_table, &key, hash_key(key), sizeof(uint32_t), compare_uint32);
+        remove_from_hash_table(&hash_table, elem, sizeof(uint32_t));
+    }
+    stop_bench_timer(timer);
+    keep_value(hash_table.size);
+    free_hash_table(&hash_table);
+}
+
+static char* make_strs(size_t op_count) {
+    char* strs = malloc_or_die(op_count * MAX_STR_LEN);
+    for (size_t i = 0; i < op_count; ++i)
+        snprintf(strs + i * MAX_STR_LEN, MAX_STR_LEN, "ident_%zu", i);
+    return strs;
+}
+
+static void bench_make_str_new(BenchTimer* timer, size_t op_count) {
+    char* strs = make_strs(op_count);
+    MemPool mem_pool = new_mem_pool();
+    StrPool str_pool = new_str_pool(&mem_pool);
+    start_bench_timer(timer);
+    for (size_t i = 0; i < op_count; ++i)
+        make_str(&str_pool, strs + i * MAX_STR_LEN);
+    stop_bench_timer(timer);
+    free_str_pool(&str_pool);
+    free_mem_pool(&mem_pool);
+    free(strs);
+}
+
+static void bench_make_str_existing(BenchTimer* timer, size_t op_count) {
+    char* strs = make_strs(op_count);
+    MemPool mem_pool = new_mem_pool();
+    StrPool str_pool = new_str_pool(&mem_pool);
+    for (size_t i = 0; i < op_count; ++i)
+        make_str(&str_pool, strs + i * MAX_STR_LEN);
+    uintptr_t sum = 0;
+    start_bench_timer(timer);
+    for (size_t i = 0; i < op_count; ++i)
+        sum += (uintptr_t)make_str(&str_pool, strs + (op_count - i - 1) * MAX_STR_LEN);
+    stop_bench_timer(timer);
+    keep_value(sum);
+    free_str_pool(&str_pool);
+    free_mem_pool(&mem_pool);
+    free(strs);
+}
+
+static void bench_mem_pool_alloc_small(BenchTimer* timer, size_t op_count) {
+    MemPool mem_pool = new_mem_pool();
+    uintptr_t sum = 0;
+    start_bench_timer(timer);
+    for (size_t i = 0; i < op_count; ++i)
+        sum += (uintptr_t)alloc_from_mem_pool(&mem_pool, 16);
+    stop_bench_timer(timer);
+    keep_value(sum);
+    free_mem_pool(&mem_pool);
+}
+
+static void bench_mem_pool_alloc_mixed(BenchTimer* timer, size_t op_count) {
+    static const size_t sizes[] = { 8, 24, 64, 16, 256, 32, 96, 8 };
+    MemPool mem_pool = new_mem_pool();
+    uintptr_t sum = 0;
+    start_bench_timer(timer);
+    for (size_t i = 0; i < op_count; ++i)
+        sum += (uintptr_t)alloc_from_mem_pool(&mem_pool, sizes[i % 8]);
+    stop_bench_timer(timer);
+    keep_value(sum);
+    free_mem_pool(&mem_pool);
+}
+
+static void bench_dyn_array_push(BenchTimer* timer, size_t op_count) {
+    DynArray array = new_dyn_array(sizeof(size_t));
+    start_bench_timer(timer);
+    for (size_t i = 0; i < op_count; ++i)
+        push_on_dyn_array(&array, &i);
+    stop_bench_timer(timer);
+    keep_value(array.size);
+    free_dyn_array(&array);
+}
+
+static void run_format_bench(
+    BenchTimer* timer,
+    size_t op_count,
+    const char* format_str,
+    const FormatArg* args)
+{
+    FormatState state = new_format_state("    ", false);
+    start_bench_timer(timer);
+    for (size_t i = 0; i < op_count; ++i)
+        format(&state, format_str, args);
+    stop_bench_timer(timer);
+    free_format_state(&state);
+}
+
+static void bench_format_str(BenchTimer* timer, size_t op_count) {
+    run_format_bench(timer, op_count, "{s} ", (FormatArg[]) { { .s = "identifier" } });
+}
+
+static void bench_format_ints(BenchTimer* timer, size_t op_count) {
+    run_format_bench(timer, op_count, "{u32}, {i64}, {u} ",
+        (FormatArg[]) { { .u32 = 42 }, { .i64 = -123456789 }, { .u = 7 } });
+}
+
+static void bench_format_mixed(BenchTimer* timer, size_t op_count) {
+    run_format_bench(timer, op_count, "{$}{s}{$}({f64}, {u8}) ",
+        (FormatArg[]) {
+            { .style = keyword_style },
+            { .s = "const" },
+            { .style = reset_style },
+            { .f64 = 3.14 },
+            { .u8 = 'a' }
+        });
+}
+
+static void bench_format_styled(BenchTimer* timer, size_t op_count) {
+    FormatState state = new_format_state("    ", false);
+    start_bench_timer(timer);
+    for (size_t i = 0; i < op_count; ++i)
+        print_keyword(&state, "struct");
+    stop_bench_timer(timer);
+    free_format_state(&state);
+}
+
+static void bench_hash_uint32(BenchTimer* timer, size_t op_count) {
+    HashCode hash = hash_init();
+    start_bench_timer(timer);
+    for (size_t i = 0; i < op_count; ++i)
+        hash = hash_uint32(hash, (uint32_t)i);
+    stop_bench_timer(timer);
+    keep_value(hash);
+}
+
+static void bench_hash_uint64(BenchTimer* timer, size_t op_count) {
+    HashCode hash = hash_init();
+    start_bench_timer(timer);
+    for (size_t i = 0; i < op_count; ++i)
+        hash = hash_uint64(hash, (uint64_t)i);
+    stop_bench_timer(timer);
+    keep_value(hash);
+}
+
+static void bench_hash_ptr(BenchTimer* timer, size_t op_count) {
+    HashCode hash = hash_init();
+    start_bench_timer(timer);
+    for (size_t i = 0; i < op_count; ++i)
+        hash = hash_ptr(hash, (const void*)(uintptr_t)(i * 16));
+    stop_bench_timer(timer);
+    keep_value(hash);
+}
+
+static void bench_hash_str(BenchTimer* timer, size_t op_count) {
+    char* strs = make_strs(op_count);
+    HashCode hash = hash_init();
+    start_bench_timer(timer);
+    for (size_t i = 0; i < op_count; ++i)
+        hash = hash_str(hash, strs + i * MAX_STR_LEN);
+    stop_bench_timer(timer);
+    keep_value(hash);
+    free(strs);
+}
+
+static void bench_hash_raw_bytes(BenchTimer* timer, size_t op_count) {
+    char bytes[64];
+    memset(bytes, 0x5A, sizeof(bytes));
+    HashCode hash = hash_init();
+    start_bench_timer(timer);
+    for (size_t i = 0; i < op_count; ++i)
+        hash = hash_raw_bytes(hash, bytes, sizeof(bytes));
+    stop_bench_timer(timer);
+    keep_value(hash);
+}
+
+const Bench core_benches[] = {
+    { "hash_table_insert",     bench_hash_table_insert,     OP_COUNT },
+    { "hash_table_find_hit",   bench_hash_table_find_hit,   OP_COUNT },
+    { "hash_table_find_miss",  bench_hash_table_find_miss,  OP_COUNT },
+    { "hash_table_remove",     bench_hash_table_remove,     OP_COUNT },
+    { "make_str_new",          bench_make_str_new,          OP_COUNT },
+    { "make_str_existing",     bench_make_str_existing,     OP_COUNT },
+    { "mem_pool_alloc_small",  bench_mem_pool_alloc_small,  OP_COUNT },
+    { "mem_pool_alloc_mixed",  bench_mem_pool_alloc_mixed,  OP_COUNT },
+    { "dyn_array_push",        bench_dyn_array_push,        OP_COUNT },
+    { "format_str",            bench_format_str,            OP_COUNT },
+    { "format_ints",           bench_format_ints,           OP_COUNT },
+    { "format_mixed",          bench_format_mixed,          OP_COUNT },
+    { "format_styled",         bench_format_styled,         OP_COUNT },
+    { "hash_uint32",           bench_hash_uint32,           OP_COUNT },
+    { "hash_uint64",           bench_hash_uint64,           OP_COUNT },
+    { "hash_ptr",              bench_hash_ptr,              OP_COUNT },
+    { "hash_str",              bench_hash_str,              OP_COUNT },
+    { "hash_raw_bytes",        bench_hash_raw_bytes,        OP_COUNT }
+};
+
+const size_t core_bench_count = sizeof(core_benches) / sizeof(core_benches[0]);
@@ -0,0 +1,121 @@
+#include "bench.h"
+
+#include "fu/core/alloc.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_MIN_TIME 200 // ms
+
+typedef struct {
+    const char* name;
+    const Bench* benches;
+    const size_t* bench_count;
+} BenchSuite;
+
+static const BenchSuite suites[] = {
+    { "core",  core_benches, &core_bench_count },
+    { "types", type_benches, &type_bench_count }
+};
+
+#define SUITE_COUNT (sizeof(suites) / sizeof(suites[0]))
+
+static void usage(void) {
+    printf(
+        "usage: bench [options] [benchmarks...]\n"
+        "options:\n"
+        "  -h    --help      Shows this message\n"
+        "        --list      Lists the available benchmarks\n"
+        "        --suite     Only runs the benchmarks of the given suite ('core' or 'types')\n"
+        "        --json      Writes the results in JSON format to the given file ('-' for stdout)\n"
+        "        --min-time  Sets the minimum measured time per benchmark, in milliseconds (default: %d)\n"
+        "Only the benchmarks whose name starts with one of the given prefixes are run.\n",
+        DEFAULT_MIN_TIME);
+}
+
+static bool is_bench_selected(const Bench* bench, char** prefixes, size_t prefix_count) {
+    if (prefix_count == 0)
+        return true;
+    for (size_t i = 0; i < prefix_count; ++i) {
+        if (!strncmp(bench->name, prefixes[i], strlen(prefixes[i])))
+            return true;
+    }
+    return false;
+}
+
+static bool is_suite_selected(const BenchSuite* suite, const char* suite_name) {
+    return !suite_name || !strcmp(suite->name, suite_name);
+}
+
+int main(int argc, char** argv) {
+    const char* json_file = NULL;
+    const char* suite_name = NULL;
+    uint64_t min_time = DEFAULT_MIN_TIME;
+    char** prefixes = malloc_or_die(sizeof(char*) * argc);
+    size_t prefix_count = 0;
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help")) {
+            usage();
+            free(prefixes);
+            return EXIT_SUCCESS;
+        } else if (!strcmp(argv[i], "--list")) {
+            for (size_t j = 0; j < SUITE_COUNT; ++j) {
+                for (size_t k = 0; k < *suites[j].bench_count; ++k)
+                    printf("%s\n", suites[j].benches[k].name);
+            }
+            free(prefixes);
+            return EXIT_SUCCESS;
+        } else if (
+            (!strcmp(argv[i], "--json") || !strcmp(argv[i], "--min-time") || !strcmp(argv[i], "--suite")) &&
+            i + 1 >= argc)
+        {
+            fprintf(stderr, "missing argument for option '%s'\n", argv[i]);
+            free(prefixes);
+            return EXIT_FAILURE;
+        } else if (!strcmp(argv[i], "--json"))
+            json_file = argv[++i];
+        else if (!strcmp(argv[i], "--min-time"))
+            min_time = strtoull(argv[++i], NULL, 10);
+        else if (!strcmp(argv[i], "--suite"))
+            suite_name = argv[++i];
+        else if (argv[i][0] == '-') {
+            fprintf(stderr, "invalid option '%s'\n", argv[i]);
+            free(prefixes);
+            return EXIT_FAILURE;
+        } else
+            prefixes[prefix_count++] = argv[i];
+    }
+
+    size_t bench_count = 0;
+    for (size_t i = 0; i < SUITE_COUNT; ++i)
+        bench_count += *suites[i].bench_count;
+
+    BenchResult* results = malloc_or_die(sizeof(BenchResult) * bench_count);
+    size_t result_count = 0;
+    for (size_t i = 0; i < SUITE_COUNT; ++i) {
+        if (!is_suite_selected(&suites[i], suite_name))
+            continue;
+        for (size_t j = 0; j < *suites[i].bench_count; ++j) {
+            if (is_bench_selected(&suites[i].benches[j], prefixes, prefix_count))
+                results[result_count++] = run_bench(&suites[i].benches[j], min_time * 1000000);
+        }
+    }
+
+    int status = EXIT_SUCCESS;
+    print_bench_results(stdout, results, result_count);
+    if (json_file) {
+        FILE* file = strcmp(json_file, "-") ? fopen(json_file, "wb") : stdout;
+        if (file) {
+            write_bench_results_json(file, results, result_count);
+            if (file != stdout)
+                fclose(file);
+        } else {
+            fprintf(stderr, "cannot open file '%s'\n", json_file);
+            status = EXIT_FAILURE;
+        }
+    }
+
+    free(results);
+    free(prefixes);
+    return status;
+}
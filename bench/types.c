@@ -0,0 +1,178 @@
+#include "bench.h"
+
+#include "fu/lang/type_table.h"
+#include "fu/core/thread_pool.h"
+#include "fu/core/mem_pool.h"
+#include "fu/core/alloc.h"
+
+#include <stdlib.h>
+
+#define OP_COUNT 16384
+#define THREAD_COUNT 4
+#define SHARDS_PER_THREAD 4
+
+typedef enum {
+    PTR_TYPE,
+    FUN_TYPE,
+    PAIR_TYPE,
+    TUPLE_TYPE
+} TypeShape;
+
+typedef struct {
+    MemPool mem_pool;
+    TypeTable* type_table;
+    const Type** types;
+} TypeBench;
+
+static void init_type_bench(TypeBench* type_bench, size_t type_count) {
+    // The type table keeps a pointer to the memory pool, which must thus stay in place
+    type_bench->mem_pool = new_mem_pool();
+    type_bench->type_table = new_type_table(&type_bench->mem_pool);
+    type_bench->types = malloc_or_die(sizeof(Type*) * type_count);
+
+    // Distinct types to build other types from, obtained by nesting mutable pointers
+    const Type* type = make_prim_type(type_bench->type_table, TYPE_I32);
+    for (size_t i = 0; i < type_count; ++i)
+        type_bench->types[i] = type = make_ptr_type(type_bench->type_table, false, type);
+}
+
+static void free_type_bench(TypeBench* type_bench) {
+    free_type_table(type_bench->type_table);
+    free_mem_pool(&type_bench->mem_pool);
+    free(type_bench->types);
+}
+
+static inline const Type* get_type(const TypeBench* type_bench, size_t op_count, size_t i) {
+    // Pick the types out of order, so that consecutive operations use unrelated types
+    return type_bench->types[(i * 7919) % op_count];
+}
+
+static const Type* make_bench_type(TypeBench* type_bench, size_t op_count, size_t i, TypeShape shape) {
+    const Type* types[] = {
+        get_type(type_bench, op_count, i),
+        get_type(type_bench, op_count, i + 1),
+        get_type(type_bench, op_count, i + 2),
+        get_type(type_bench, op_count, i + 3),
+        get_type(type_bench, op_count, i + 4)
+    };
+    switch (shape) {
+        case PTR_TYPE:  return make_ptr_type(type_bench->type_table, true, types[0]);
+        case FUN_TYPE:  return make_fun_type(type_bench->type_table, types[0], types[1]);
+        case PAIR_TYPE: return make_tuple_type(type_bench->type_table, types, 2);
+        default:        return make_tuple_type(type_bench->type_table, types, 5);
+    }
+}
+
+static void run_make_type_bench(BenchTimer* timer, size_t op_count, TypeShape shape, bool is_existing) {
+    TypeBench type_bench;
+    init_type_bench(&type_bench, op_count);
+    for (size_t i = 0; i < op_count && is_existing; ++i)
+        make_bench_type(&type_bench, op_count, i, shape);
+    uintptr_t sum = 0;
+    start_bench_timer(timer);
+    for (size_t i = 0; i < op_count; ++i)
+        sum += (uintptr_t)make_bench_type(&type_bench, op_count, i, shape);
+    stop_bench_timer(timer);
+    keep_value(sum);
+    free_type_bench(&type_bench);
+}
+
+static void bench_make_ptr_type_new(BenchTimer* timer, size_t op_count) {
+    run_make_type_bench(timer, op_count, PTR_TYPE, false);
+}
+
+static void bench_make_ptr_type_existing(BenchTimer* timer, size_t op_count) {
+    run_make_type_bench(timer, op_count, PTR_TYPE, true);
+}
+
+static void bench_make_fun_type_new(BenchTimer* timer, size_t op_count) {
+    run_make_type_bench(timer, op_count, FUN_TYPE, false);
+}
+
+static void bench_make_fun_type_existing(BenchTimer* timer, size_t op_count) {
+    run_make_type_bench(timer, op_count, FUN_TYPE, true);
+}
+
+static void bench_make_pair_type_new(BenchTimer* timer, size_t op_count) {
+    run_make_type_bench(timer, op_count, PAIR_TYPE, false);
+}
+
+static void bench_make_pair_type_existing(BenchTimer* timer, size_t op_count) {
+    run_make_type_bench(timer, op_count, PAIR_TYPE, true);
+}
+
+static void bench_make_tuple_type_new(BenchTimer* timer, size_t op_count) {
+    run_make_type_bench(timer, op_count, TUPLE_TYPE, false);
+}
+
+static void bench_make_tuple_type_existing(BenchTimer* timer, size_t op_count) {
+    run_make_type_bench(timer, op_count, TUPLE_TYPE, true);
+}
+
+typedef struct {
+    TypeBench* type_bench;
+    TypeTable** type_tables;
+    const Type** results;
+    size_t op_count;
+} ConcurrentTypeTasks;
+
+static void make_types_task(void* data, size_t task_index, size_t thread_index) {
+    ConcurrentTypeTasks* tasks = data;
+    TypeTable* type_table = tasks->type_tables[thread_index];
+    const Type** results = tasks->results + task_index * tasks->op_count;
+    for (size_t i = 0; i < tasks->op_count; ++i) {
+        // Every task creates the same types, starting at a different offset
+        size_t j = (i + task_index * tasks->op_count / THREAD_COUNT) % tasks->op_count;
+        results[j] = make_fun_type(type_table,
+            get_type(tasks->type_bench, tasks->op_count, j),
+            get_type(tasks->type_bench, tasks->op_count, j + 1));
+    }
+}
+
+static void bench_make_fun_type_concurrent(BenchTimer* timer, size_t op_count) {
+    // The base types are created by a type table with a single-shard interner, which can
+    // only be used by one thread. The concurrent type tables use a separate interner.
+    TypeBench type_bench;
+    init_type_bench(&type_bench, op_count);
+    TypeInterner* interner = new_type_interner(THREAD_COUNT * SHARDS_PER_THREAD);
+    ThreadPool* thread_pool = new_thread_pool(THREAD_COUNT);
+    MemPool mem_pools[THREAD_COUNT];
+    TypeTable* type_tables[THREAD_COUNT];
+    for (size_t i = 0; i < THREAD_COUNT; ++i) {
+        mem_pools[i] = new_mem_pool();
+        type_tables[i] = new_shared_type_table(interner, &mem_pools[i]);
+    }
+    const Type** results = malloc_or_die(sizeof(Type*) * op_count * THREAD_COUNT);
+
+    start_bench_timer(timer);
+    run_tasks(thread_pool, THREAD_COUNT, make_types_task,
+        &(ConcurrentTypeTasks) { &type_bench, type_tables, results, op_count });
+    stop_bench_timer(timer);
+
+    for (size_t i = op_count; i < op_count * THREAD_COUNT; ++i) {
+        if (results[i] != results[i % op_count])
+            die("types created concurrently are not unique\n");
+    }
+    free(results);
+    for (size_t i = 0; i < THREAD_COUNT; ++i)
+        free_type_table(type_tables[i]);
+    free_type_interner(interner);
+    for (size_t i = 0; i < THREAD_COUNT; ++i)
+        free_mem_pool(&mem_pools[i]);
+    free_thread_pool(thread_pool);
+    free_type_bench(&type_bench);
+}
+
+const Bench type_benches[] = {
+    { "make_ptr_type_new",         bench_make_ptr_type_new,         OP_COUNT },
+    { "make_ptr_type_existing",    bench_make_ptr_type_existing,    OP_COUNT },
+    { "make_fun_type_new",         bench_make_fun_type_new,         OP_COUNT },
+    { "make_fun_type_existing",    bench_make_fun_type_existing,    OP_COUNT },
+    { "make_pair_type_new",        bench_make_pair_type_new,        OP_COUNT },
+    { "make_pair_type_existing",   bench_make_pair_type_existing,   OP_COUNT },
+    { "make_tuple_type_new",       bench_make_tuple_type_new,       OP_COUNT },
+    { "make_tuple_type_existing",  bench_make_tuple_type_existing,  OP_COUNT },
+    { "make_fun_type_concurrent",  bench_make_fun_type_concurrent,  OP_COUNT }
+};
+
+const size_t type_bench_count = sizeof(type_benches) / sizeof(type_benches[0]);
@@ -7,7 +7,21 @@
 
 #include "fu/core/utils.h"
 
+/*
+ * When compiled with `FU_ALLOC_STATS`, the allocation functions count the number of times they are
+ * called. This is used by the benchmarks to report the number of allocations per operation.
+ */
+
+#ifdef FU_ALLOC_STATS
+#include <stdatomic.h>
+extern atomic_size_t alloc_count;
+#define count_alloc() atomic_fetch_add_explicit(&alloc_count, 1, memory_order_relaxed)
+#else
+#define count_alloc() ((void)0)
+#endif
+
 static inline void* malloc_or_die(size_t size) {
+    count_alloc();
     void* ptr = malloc(size);
     if (!ptr)
         die("out of memory, malloc() failed\n"); // GCOV_EXCL_LINE
@@ -15,6 +29,7 @@ static inline void* malloc_or_die(size_t size) {
 }
 
 static inline void* calloc_or_die(size_t count, size_t size) {
+    count_alloc();
     void* ptr = calloc(count, size);
     if (!ptr)
         die("out of memory, calloc() failed\n"); // GCOV_EXCL_LINE
@@ -22,6 +37,7 @@ static inline void* calloc_or_die(size_t count, size_t size) {
 }
 
 static inline void* realloc_or_die(void* ptr, size_t size) {
+    count_alloc();
     ptr = realloc(ptr, size);
     if (!ptr)
         die("out of memory, realloc() failed\n"); // GCOV_EXCL_LINE
@@ -0,0 +1,32 @@
+#include "fu/core/bit_set.h"
+#include "fu/core/alloc.h"
+
+#include <string.h>
+
+#define DEFAULT_WORD_COUNT 4
+
+BitSet new_bit_set(void) {
+    return (BitSet) {
+        .words = calloc_or_die(DEFAULT_WORD_COUNT, sizeof(uint64_t)),
+        .word_count = DEFAULT_WORD_COUNT
+    };
+}
+
+void grow_bit_set(BitSet* bit_set, size_t word_count) {
+    if (word_count <= bit_set->word_count)
+        return;
+    size_t double_count = bit_set->word_count * 2;
+    word_count = double_count > word_count ? double_count : word_count;
+    bit_set->words = realloc_or_die(bit_set->words, sizeof(uint64_t) * word_count);
+    memset(bit_set->words + bit_set->word_count, 0, sizeof(uint64_t) * (word_count - bit_set->word_count));
+    bit_set->word_count = word_count;
+}
+
+void clear_bit_set(BitSet* bit_set) {
+    memset(bit_set->words, 0, sizeof(uint64_t) * bit_set->word_count);
+}
+
+void free_bit_set(BitSet* bit_set) {
+    free(bit_set->words);
+    memset(bit_set, 0, sizeof(BitSet));
+}
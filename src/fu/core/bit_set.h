@@ -0,0 +1,43 @@
+#ifndef FU_CORE_BIT_SET_H
+#define FU_CORE_BIT_SET_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Dynamically-growing set of integers, represented as an array of bits.
+ * This is meant to be used with dense identifiers, in which case membership tests, insertions and
+ * removals are simple array operations. Elements that were never inserted are not in the set.
+ */
+
+typedef struct BitSet {
+    uint64_t* words;
+    size_t word_count;
+} BitSet;
+
+BitSet new_bit_set(void);
+void grow_bit_set(BitSet*, size_t);
+void clear_bit_set(BitSet*);
+void free_bit_set(BitSet*);
+
+static inline bool is_in_bit_set(const BitSet* bit_set, size_t elem) {
+    return elem / 64 < bit_set->word_count && (bit_set->words[elem / 64] & (UINT64_C(1) << (elem % 64)));
+}
+
+static inline bool insert_in_bit_set(BitSet* bit_set, size_t elem) {
+    if (elem / 64 >= bit_set->word_count)
+        grow_bit_set(bit_set, elem / 64 + 1);
+    uint64_t mask = UINT64_C(1) << (elem % 64);
+    if (bit_set->words[elem / 64] & mask)
+        return false;
+    bit_set->words[elem / 64] |= mask;
+    return true;
+}
+
+static inline void remove_from_bit_set(BitSet* bit_set, size_t elem) {
+    if (elem / 64 < bit_set->word_count)
+        bit_set->words[elem / 64] &= ~(UINT64_C(1) << (elem % 64));
+}
+
+#endif
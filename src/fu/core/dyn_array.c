@@ -45,12 +45,16 @@ void push_on_dyn_array_explicit(DynArray* array, const void* elem, size_t elem_s
     array->size++;
 }
 
-void resize_dyn_array_explicit(DynArray* array, size_t size) {
+void resize_dyn_array(DynArray* array, size_t size) {
     if (size > array->capacity)
         grow_dyn_array(array, size);
     array->size = size;
 }
 
+void clear_dyn_array(DynArray* array) {
+    array->size = 0;
+}
+
 void free_dyn_array(DynArray* array) {
     free(array->elems);
     memset(array, 0, sizeof(DynArray));
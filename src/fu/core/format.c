@@ -36,14 +36,15 @@ static char* reserve_buf(FormatState* state, size_t size) {
     return buf->data;
 }
 
-static void advance_buf(FormatBuf* buf, size_t inc) {
-    assert(buf->capacity >= buf->size + inc);
-    buf->size += inc;
+static void advance_buf(FormatState* state, size_t inc) {
+    assert(state->cur_buf->capacity >= state->cur_buf->size + inc);
+    state->cur_buf->size += inc;
+    state->size += inc;
 }
 
 static void write(FormatState* state, const char* ptr, size_t size) {
     memcpy(reserve_buf(state, size), ptr, size);
-    advance_buf(state->cur_buf, size);
+    advance_buf(state, size);
 }
 
 static void write_char(FormatState* state, char c) {
@@ -106,7 +107,7 @@ static const char* format_arg(FormatState* state, const char* ptr, size_t* index
             break;
     }
     assert(n < MAX_FORMAT_CHARS);
-    advance_buf(state->cur_buf, n);
+    advance_buf(state, n);
     return ptr;
 }
 
@@ -223,3 +224,12 @@ void write_format_state(FormatState* state, FILE* file) {
     for (FormatBuf* buf = state->first_buf; buf; buf = buf->next)
         fwrite(buf->data, 1, buf->size, file);
 }
+
+void append_format_state(FormatState* state, const FormatState* other, size_t size) {
+    assert(size <= other->size);
+    for (FormatBuf* buf = other->first_buf; buf && size > 0; buf = buf->next) {
+        size_t buf_size = buf->size < size ? buf->size : size;
+        write(state, buf->data, buf_size);
+        size -= buf_size;
+    }
+}
@@ -58,6 +58,7 @@ typedef union {
 typedef struct {
     FormatBuf* cur_buf;
     FormatBuf* first_buf;
+    size_t size; // Number of characters written so far
     bool ignore_style;
     size_t indent;
     const char* tab;
@@ -80,5 +81,7 @@ void print_with_style(FormatState*, const char*, FormatStyle);
 void print_keyword(FormatState*, const char*);
 
 void write_format_state(FormatState*, FILE*);
+/// Appends the first `size` characters of another state to the given state.
+void append_format_state(FormatState*, const FormatState*, size_t size);
 
 #endif
@@ -56,7 +56,7 @@ static inline void rehash_table(HashTable* hash_table, size_t elem_size) {
     if (new_capacity <= hash_table->capacity)
         new_capacity = hash_table->capacity * 2 + 1;
     void* new_elems = malloc_or_die(new_capacity * elem_size);
-    HashCode* new_hashes = calloc_or_die(new_capacity, elem_size);
+    HashCode* new_hashes = calloc_or_die(new_capacity, sizeof(HashCode));
     for (size_t i = 0, n = hash_table->capacity; i < n; ++i) {
         HashCode hash = hash_table->hashes[i];
         if (!is_occupied_hash(hash))
@@ -152,3 +152,22 @@ void clear_hash_table(HashTable* hash_table) {
     hash_table->size = 0;
     memset(hash_table->hashes, 0, sizeof(HashCode) * hash_table->capacity);
 }
+
+HashTableStats get_hash_table_stats(const HashTable* hash_table) {
+    size_t total_probe_length = 0, max_probe_length = 0;
+    for (size_t i = 0, n = hash_table->capacity; i < n; ++i) {
+        if (!is_occupied_hash(hash_table->hashes[i]))
+            continue;
+        size_t index = mod_prime(hash_table->hashes[i], n);
+        size_t probe_length = (i >= index ? i - index : i + n - index) + 1;
+        total_probe_length += probe_length;
+        max_probe_length = max_probe_length < probe_length ? probe_length : max_probe_length;
+    }
+    return (HashTableStats) {
+        .capacity = hash_table->capacity,
+        .size = hash_table->size,
+        .load_factor = hash_table->capacity > 0 ? (double)hash_table->size / (double)hash_table->capacity : 0,
+        .avg_probe_length = hash_table->size > 0 ? (double)total_probe_length / (double)hash_table->size : 0,
+        .max_probe_length = max_probe_length
+    };
+}
@@ -24,6 +24,16 @@ typedef struct {
     void* elems;
 } HashTable;
 
+/// Statistics about the occupancy of a hash table. The probe length of an element is the number of
+/// buckets that have to be visited to find it, starting from its ideal bucket.
+typedef struct {
+    size_t capacity;
+    size_t size;
+    double load_factor;
+    double avg_probe_length;
+    size_t max_probe_length;
+} HashTableStats;
+
 HashTable new_hash_table(size_t elem_size);
 HashTable new_hash_table_with_capacity(size_t elem_size, size_t capacity);
 void free_hash_table(HashTable*);
@@ -46,4 +56,6 @@ void* find_in_hash_table(
 void remove_from_hash_table(HashTable*, void* elem, size_t elem_size);
 void clear_hash_table(HashTable*);
 
+HashTableStats get_hash_table_stats(const HashTable*);
+
 #endif
@@ -29,6 +29,15 @@ Log new_log(FormatState* state) {
     };
 }
 
+Log new_buffered_log(FormatState* state, const Log* other) {
+    Log log = new_log(state);
+    log.max_errors = other->max_errors;
+    log.show_diagnostics = other->show_diagnostics;
+    log.is_buffered = true;
+    log.error_offsets = new_dyn_array(sizeof(size_t));
+    return log;
+}
+
 void free_log(Log* log) {
     FileEntry* entries = log->file_cache.elems;
     for (size_t i = 0; i < log->file_cache.capacity; ++i) {
@@ -37,6 +46,26 @@ void free_log(Log* log) {
         fclose(entries[i].file);
     }
     free_hash_table(&log->file_cache);
+    if (log->is_buffered)
+        free_dyn_array(&log->error_offsets);
+}
+
+void merge_log(Log* log, const Log* other) {
+    assert(other->is_buffered);
+    // Stop before the first error that `print_msg()` would not print. The other log has the same
+    // maximum but fewer errors than this one after merging, so it printed every message that is kept.
+    size_t size = other->state->size;
+    if (log->error_count >= log->max_errors)
+        size = 0;
+    else if (log->max_errors - log->error_count <= other->error_offsets.size)
+        size = ((size_t*)other->error_offsets.elems)[log->max_errors - log->error_count - 1];
+
+    // Messages are separated by a new line (see `print_msg()`)
+    if (log->error_count + log->warning_count > 0 && size > 0)
+        format(log->state, "\n", NULL);
+    append_format_state(log->state, other->state, size);
+    log->error_count += other->error_count;
+    log->warning_count += other->warning_count;
 }
 
 static bool compare_file_entries(const void* left, const void* right) {
@@ -192,8 +221,11 @@ static void print_msg(
     const char* format_str,
     const FormatArg* args)
 {
-    if (msg_type == LOG_ERROR)
+    if (msg_type == LOG_ERROR) {
+        if (log->is_buffered)
+            push_on_dyn_array(&log->error_offsets, &log->state->size);
         log->error_count++;
+    }
     else if (msg_type == LOG_WARNING)
         log->warning_count++;
 
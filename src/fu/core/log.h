@@ -5,6 +5,7 @@
 
 #include "fu/core/format.h"
 #include "fu/core/hash_table.h"
+#include "fu/core/dyn_array.h"
 
 /*
  * The log object is used to report messages from various passes of the compiler.
@@ -28,11 +29,21 @@ typedef struct Log {
     size_t warning_count;
     size_t max_errors;
     bool show_diagnostics;
+    bool is_buffered;
+    DynArray error_offsets; // Position of each error in the output, for buffered logs only
 } Log;
 
 Log new_log(FormatState*);
 void free_log(Log*);
 
+/// Creates a log that buffers messages, with the same settings as the given log. Those messages
+/// can later be appended to another log with `merge_log()`.
+Log new_buffered_log(FormatState*, const Log*);
+
+/// Appends the messages of a buffered log to the given log, as if they had been reported to it.
+/// In particular, the messages that come after the maximum number of errors are dropped.
+void merge_log(Log*, const Log*);
+
 void log_error(Log*, const FileLoc*, const char*, const FormatArg*);
 void log_warning(Log*, const FileLoc*, const char*, const FormatArg*);
 void log_note(Log*, const FileLoc*, const char*, const FormatArg*);
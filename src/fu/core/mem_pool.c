@@ -14,9 +14,10 @@ typedef struct MemBlock {
 } MemBlock;
 
 #define MIN_MEM_BLOCK_CAPACITY 1024
+#define MAX_MEM_BLOCK_GROWTH (1024 * 1024)
 
 MemPool new_mem_pool(void) {
-    return (MemPool) { NULL, NULL };
+    return (MemPool) { NULL, NULL, 0, 0 };
 }
 
 static size_t remaining_mem(MemBlock* block) {
@@ -49,17 +50,32 @@ void* alloc_from_mem_pool(MemPool* mem_pool, size_t size) {
     } else {
         // Try to re-use the next memory pools if they are appropriately sized
         while (remaining_mem(mem_pool->cur) < size) {
-            if (!mem_pool->cur->next) {
-                mem_pool->cur = alloc_mem_block(mem_pool->cur, size);
+            MemBlock* next = mem_pool->cur->next;
+            if (!next) {
+                // Blocks grow geometrically, so that a sequence of growing requests allocates
+                // a logarithmic number of blocks
+                size_t growth = mem_pool->cur->capacity < MAX_MEM_BLOCK_GROWTH
+                    ? mem_pool->cur->capacity : MAX_MEM_BLOCK_GROWTH;
+                mem_pool->cur = alloc_mem_block(mem_pool->cur,
+                    size > mem_pool->cur->capacity + growth ? size : mem_pool->cur->capacity + growth);
                 break;
             }
-            mem_pool->cur = mem_pool->cur->next;
-            assert(mem_pool->cur->size == 0 && "next memory pool block must have been reset");
+            assert(next->size == 0 && "next memory pool block must have been reset");
+            if (next->capacity < size) {
+                // Blocks that are too small are freed, as every larger request would skip them
+                mem_pool->cur->next = next->next;
+                free(next);
+                continue;
+            }
+            mem_pool->cur = next;
         }
     }
     assert(remaining_mem(mem_pool->cur) >= size);
     void* ptr = ((char*)mem_pool->cur->data) + mem_pool->cur->size;
     mem_pool->cur->size += size;
+    mem_pool->alloc_size += size;
+    if (mem_pool->alloc_size > mem_pool->peak_alloc_size)
+        mem_pool->peak_alloc_size = mem_pool->alloc_size;
     return ptr;
 }
 
@@ -70,6 +86,28 @@ void reset_mem_pool(MemPool* mem_pool) {
         block = block->next;
     }
     mem_pool->cur = mem_pool->first;
+    mem_pool->alloc_size = 0;
+}
+
+void merge_mem_pool(MemPool* mem_pool, MemPool* other) {
+    if (!other->first)
+        return;
+    if (!mem_pool->first) {
+        mem_pool->first = other->first;
+        mem_pool->cur = other->cur;
+    } else {
+        // The blocks of the other pool are placed before the blocks of this pool,
+        // so that they are never used for new allocations.
+        MemBlock* last = other->first;
+        while (last->next)
+            last = last->next;
+        last->next = mem_pool->first;
+        mem_pool->first = other->first;
+    }
+    mem_pool->alloc_size += other->alloc_size;
+    if (mem_pool->alloc_size > mem_pool->peak_alloc_size)
+        mem_pool->peak_alloc_size = mem_pool->alloc_size;
+    *other = new_mem_pool();
 }
 
 void free_mem_pool(MemPool* mem_pool) {
@@ -79,5 +117,29 @@ void free_mem_pool(MemPool* mem_pool) {
         free(block);
         block = next;
     }
-    mem_pool->first = mem_pool->cur = NULL;
+    *mem_pool = new_mem_pool();
+}
+
+MemPoolState save_mem_pool(const MemPool* mem_pool) {
+    return (MemPoolState) {
+        .block = mem_pool->cur,
+        .block_size = mem_pool->cur ? mem_pool->cur->size : 0,
+        .alloc_size = mem_pool->alloc_size
+    };
+}
+
+void restore_mem_pool(MemPool* mem_pool, MemPoolState state) {
+    if (!state.block) {
+        reset_mem_pool(mem_pool);
+        return;
+    }
+    // Reset the blocks that have been used since the state was saved
+    for (MemBlock* block = state.block; block != mem_pool->cur;) {
+        block = block->next;
+        block->size = 0;
+    }
+    assert(state.block->size >= state.block_size);
+    state.block->size = state.block_size;
+    mem_pool->cur = state.block;
+    mem_pool->alloc_size = state.alloc_size;
 }
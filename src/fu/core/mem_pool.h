@@ -4,8 +4,12 @@
 #include <stddef.h>
 
 /*
- * The memory pool is a block-based allocator that allocates blocks of memory of fixed size
+ * The memory pool is a block-based allocator that allocates blocks of memory of increasing size
  * to hold the allocated data. The blocks are reclaimed when the memory pool is destroyed.
+ * The pool keeps track of the number of bytes allocated since it was last reset, as well
+ * as the maximum of that number over its lifetime. The state of the pool can be saved and
+ * restored later, which frees everything allocated in between: This makes it possible to use a
+ * pool as a stack of scratch buffers.
  */
 
 struct MemBlock;
@@ -13,11 +17,26 @@ struct MemBlock;
 typedef struct MemPool {
     struct MemBlock* first;
     struct MemBlock* cur;
+    size_t alloc_size;
+    size_t peak_alloc_size;
 } MemPool;
 
+typedef struct MemPoolState {
+    struct MemBlock* block;
+    size_t block_size;
+    size_t alloc_size;
+} MemPoolState;
+
 MemPool new_mem_pool(void);
 void* alloc_from_mem_pool(MemPool*, size_t);
 void reset_mem_pool(MemPool*);
+void merge_mem_pool(MemPool*, MemPool* other);
 void free_mem_pool(MemPool*);
 
+/// Saves the current state of the pool. Pools must not be merged between saving and restoring.
+MemPoolState save_mem_pool(const MemPool*);
+/// Frees all the allocations made since the given state was saved. States must be restored in
+/// reverse order of saving.
+void restore_mem_pool(MemPool*, MemPoolState);
+
 #endif
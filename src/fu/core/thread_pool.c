@@ -0,0 +1,184 @@
+#include "fu/core/thread_pool.h"
+#include "fu/core/alloc.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+typedef struct {
+    pthread_mutex_t mutex;
+    size_t* tasks;
+    size_t begin, end;
+} TaskQueue;
+
+typedef struct {
+    ThreadPool* thread_pool;
+    size_t thread_index;
+} Worker;
+
+struct ThreadPool {
+    size_t thread_count;
+    size_t max_tasks_per_queue;
+    TaskQueue* queues;
+    Worker* workers;
+    pthread_t* threads;
+    pthread_mutex_t mutex;
+    pthread_cond_t start_cond;
+    pthread_cond_t done_cond;
+    size_t generation;
+    size_t busy_count;
+    bool should_stop;
+    TaskFn task_fn;
+    void* data;
+};
+
+static bool pop_task(TaskQueue* queue, size_t* task_index) {
+    pthread_mutex_lock(&queue->mutex);
+    bool found = queue->begin < queue->end;
+    if (found)
+        *task_index = queue->tasks[--queue->end];
+    pthread_mutex_unlock(&queue->mutex);
+    return found;
+}
+
+static bool steal_task(TaskQueue* queue, size_t* task_index) {
+    pthread_mutex_lock(&queue->mutex);
+    bool found = queue->begin < queue->end;
+    if (found)
+        *task_index = queue->tasks[queue->begin++];
+    pthread_mutex_unlock(&queue->mutex);
+    return found;
+}
+
+static bool find_task(ThreadPool* thread_pool, size_t thread_index, size_t* task_index) {
+    if (pop_task(&thread_pool->queues[thread_index], task_index))
+        return true;
+    for (size_t i = 1; i < thread_pool->thread_count; ++i) {
+        size_t victim = (thread_index + i) % thread_pool->thread_count;
+        if (steal_task(&thread_pool->queues[victim], task_index))
+            return true;
+    }
+    return false;
+}
+
+static void process_tasks(ThreadPool* thread_pool, size_t thread_index) {
+    // No task is added while a batch is running, so all the tasks
+    // have been taken once every queue has been found empty.
+    size_t task_index;
+    while (find_task(thread_pool, thread_index, &task_index))
+        thread_pool->task_fn(thread_pool->data, task_index, thread_index);
+}
+
+static void* run_worker(void* data) {
+    Worker* worker = data;
+    ThreadPool* thread_pool = worker->thread_pool;
+    size_t generation = 0;
+    while (true) {
+        pthread_mutex_lock(&thread_pool->mutex);
+        while (thread_pool->generation == generation && !thread_pool->should_stop)
+            pthread_cond_wait(&thread_pool->start_cond, &thread_pool->mutex);
+        generation = thread_pool->generation;
+        bool should_stop = thread_pool->should_stop;
+        pthread_mutex_unlock(&thread_pool->mutex);
+        if (should_stop)
+            break;
+
+        process_tasks(thread_pool, worker->thread_index);
+
+        pthread_mutex_lock(&thread_pool->mutex);
+        if (--thread_pool->busy_count == 0)
+            pthread_cond_signal(&thread_pool->done_cond);
+        pthread_mutex_unlock(&thread_pool->mutex);
+    }
+    return NULL;
+}
+
+ThreadPool* new_thread_pool(size_t thread_count) {
+    assert(thread_count > 0);
+    ThreadPool* thread_pool = malloc_or_die(sizeof(ThreadPool));
+    *thread_pool = (ThreadPool) {
+        .thread_count = thread_count,
+        .queues = calloc_or_die(thread_count, sizeof(TaskQueue)),
+        .workers = malloc_or_die(sizeof(Worker) * thread_count),
+        .threads = malloc_or_die(sizeof(pthread_t) * thread_count)
+    };
+    pthread_mutex_init(&thread_pool->mutex, NULL);
+    pthread_cond_init(&thread_pool->start_cond, NULL);
+    pthread_cond_init(&thread_pool->done_cond, NULL);
+    for (size_t i = 0; i < thread_count; ++i)
+        pthread_mutex_init(&thread_pool->queues[i].mutex, NULL);
+
+    // The first thread is the one that submits tasks
+    for (size_t i = 1; i < thread_count; ++i) {
+        thread_pool->workers[i] = (Worker) { .thread_pool = thread_pool, .thread_index = i };
+        if (pthread_create(&thread_pool->threads[i], NULL, run_worker, &thread_pool->workers[i]))
+            die("cannot create thread\n");
+    }
+    return thread_pool;
+}
+
+void free_thread_pool(ThreadPool* thread_pool) {
+    pthread_mutex_lock(&thread_pool->mutex);
+    thread_pool->should_stop = true;
+    pthread_cond_broadcast(&thread_pool->start_cond);
+    pthread_mutex_unlock(&thread_pool->mutex);
+    for (size_t i = 1; i < thread_pool->thread_count; ++i)
+        pthread_join(thread_pool->threads[i], NULL);
+
+    for (size_t i = 0; i < thread_pool->thread_count; ++i) {
+        pthread_mutex_destroy(&thread_pool->queues[i].mutex);
+        free(thread_pool->queues[i].tasks);
+    }
+    pthread_cond_destroy(&thread_pool->done_cond);
+    pthread_cond_destroy(&thread_pool->start_cond);
+    pthread_mutex_destroy(&thread_pool->mutex);
+    free(thread_pool->queues);
+    free(thread_pool->workers);
+    free(thread_pool->threads);
+    free(thread_pool);
+}
+
+size_t get_thread_count(const ThreadPool* thread_pool) {
+    return thread_pool->thread_count;
+}
+
+static void fill_queues(ThreadPool* thread_pool, size_t task_count) {
+    size_t max_tasks_per_queue = (task_count + thread_pool->thread_count - 1) / thread_pool->thread_count;
+    if (max_tasks_per_queue > thread_pool->max_tasks_per_queue) {
+        for (size_t i = 0; i < thread_pool->thread_count; ++i) {
+            TaskQueue* queue = &thread_pool->queues[i];
+            queue->tasks = realloc_or_die(queue->tasks, sizeof(size_t) * max_tasks_per_queue);
+        }
+        thread_pool->max_tasks_per_queue = max_tasks_per_queue;
+    }
+
+    // Tasks are distributed in a round-robin fashion, and each thread processes its own queue
+    // starting from the end, so that neighboring tasks tend to run at the same time.
+    for (size_t i = 0; i < thread_pool->thread_count; ++i)
+        thread_pool->queues[i].begin = thread_pool->queues[i].end = 0;
+    for (size_t i = task_count; i-- > 0;) {
+        TaskQueue* queue = &thread_pool->queues[i % thread_pool->thread_count];
+        queue->tasks[queue->end++] = i;
+    }
+}
+
+void run_tasks(ThreadPool* thread_pool, size_t task_count, TaskFn task_fn, void* data) {
+    if (task_count == 0)
+        return;
+    fill_queues(thread_pool, task_count);
+
+    pthread_mutex_lock(&thread_pool->mutex);
+    thread_pool->task_fn = task_fn;
+    thread_pool->data = data;
+    thread_pool->busy_count = thread_pool->thread_count - 1;
+    thread_pool->generation++;
+    pthread_cond_broadcast(&thread_pool->start_cond);
+    pthread_mutex_unlock(&thread_pool->mutex);
+
+    process_tasks(thread_pool, 0);
+
+    pthread_mutex_lock(&thread_pool->mutex);
+    while (thread_pool->busy_count > 0)
+        pthread_cond_wait(&thread_pool->done_cond, &thread_pool->mutex);
+    pthread_mutex_unlock(&thread_pool->mutex);
+}
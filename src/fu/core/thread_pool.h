@@ -0,0 +1,25 @@
+#ifndef FU_CORE_THREAD_POOL_H
+#define FU_CORE_THREAD_POOL_H
+
+#include <stddef.h>
+
+/*
+ * Thread pool that runs a batch of independent tasks using work stealing. Tasks are identified by
+ * their index in the batch, and are initially distributed evenly among the threads. Each thread
+ * processes its own tasks first, and then steals the remaining tasks of the other threads.
+ * The thread that submits the batch participates in the computation, and the task function
+ * receives the index of the thread that runs it, which can be used to access per-thread data.
+ */
+
+typedef struct ThreadPool ThreadPool;
+typedef void (*TaskFn)(void* data, size_t task_index, size_t thread_index);
+
+ThreadPool* new_thread_pool(size_t thread_count);
+void free_thread_pool(ThreadPool*);
+
+size_t get_thread_count(const ThreadPool*);
+
+/// Runs the tasks `0, ..., task_count - 1` and waits until they are all completed.
+void run_tasks(ThreadPool*, size_t task_count, TaskFn, void* data);
+
+#endif
@@ -0,0 +1,144 @@
+#include "fu/core/trace.h"
+#include "fu/core/mem_pool.h"
+#include "fu/core/format.h"
+#include "fu/core/alloc.h"
+
+#include <assert.h>
+#include <string.h>
+#include <time.h>
+#include <inttypes.h>
+
+#define MAX_SUMMARY_LINE 128
+
+typedef struct {
+    size_t index;
+    size_t alloc_size;
+} OpenSpan;
+
+uint64_t get_time_in_ns(void) {
+    struct timespec time;
+    timespec_get(&time, TIME_UTC);
+    return (uint64_t)time.tv_sec * UINT64_C(1000000000) + (uint64_t)time.tv_nsec;
+}
+
+Trace new_trace(MemPool* mem_pool) {
+    return (Trace) {
+        .mem_pool = mem_pool,
+        .start_time = get_time_in_ns(),
+        .spans = new_dyn_array(sizeof(Span)),
+        .open_spans = new_dyn_array(sizeof(OpenSpan))
+    };
+}
+
+void free_trace(Trace* trace) {
+    free_dyn_array(&trace->spans);
+    free_dyn_array(&trace->open_spans);
+}
+
+void begin_span(Trace* trace, const char* category, const char* name) {
+    push_on_dyn_array(&trace->open_spans, &(OpenSpan) {
+        .index = trace->spans.size,
+        .alloc_size = trace->mem_pool->alloc_size
+    });
+    push_on_dyn_array(&trace->spans, &(Span) {
+        .category = category,
+        .name = name,
+        .begin_time = get_time_in_ns()
+    });
+}
+
+void end_span(Trace* trace) {
+    assert(trace->open_spans.size > 0);
+    const OpenSpan* open_span = &((OpenSpan*)trace->open_spans.elems)[trace->open_spans.size - 1];
+    Span* span = &((Span*)trace->spans.elems)[open_span->index];
+    span->end_time = get_time_in_ns();
+    span->alloc_size = trace->mem_pool->alloc_size - open_span->alloc_size;
+    resize_dyn_array(&trace->open_spans, trace->open_spans.size - 1);
+}
+
+void add_span(Trace* trace, const Span* span) {
+    push_on_dyn_array(&trace->spans, span);
+}
+
+typedef struct {
+    const char* name;
+    uint64_t time;
+    size_t alloc_size;
+    size_t count;
+} SpanSummary;
+
+void print_trace_summary(const Trace* trace, const char* category, FormatState* state) {
+    DynArray summaries = new_dyn_array(sizeof(SpanSummary));
+    uint64_t total_time = 0;
+    const Span* spans = trace->spans.elems;
+    for (size_t i = 0; i < trace->spans.size; ++i) {
+        if (strcmp(spans[i].category, category))
+            continue;
+        SpanSummary* summary = NULL;
+        for (size_t j = 0; j < summaries.size && !summary; ++j) {
+            if (!strcmp(((SpanSummary*)summaries.elems)[j].name, spans[i].name))
+                summary = &((SpanSummary*)summaries.elems)[j];
+        }
+        if (!summary) {
+            push_on_dyn_array(&summaries, &(SpanSummary) { .name = spans[i].name });
+            summary = &((SpanSummary*)summaries.elems)[summaries.size - 1];
+        }
+        uint64_t time = spans[i].end_time - spans[i].begin_time;
+        summary->time += time;
+        summary->alloc_size += spans[i].alloc_size;
+        summary->count++;
+        total_time += time;
+    }
+
+    char line[MAX_SUMMARY_LINE];
+    snprintf(line, MAX_SUMMARY_LINE, "%-24s%12s%8s%14s%8s",
+        category, "time (ms)", "%", "memory (KB)", "count");
+    format(state, "{$}{s}{$}\n", (FormatArg[]) { { .style = loc_style }, { .s = line }, { .style = reset_style } });
+    const SpanSummary* elems = summaries.elems;
+    for (size_t i = 0; i < summaries.size; ++i) {
+        snprintf(line, MAX_SUMMARY_LINE, "%-24s%12.3f%8.1f%14zu%8zu",
+            elems[i].name,
+            (double)elems[i].time * 1.0e-6,
+            total_time > 0 ? 100.0 * (double)elems[i].time / (double)total_time : 0.0,
+            elems[i].alloc_size / 1024,
+            elems[i].count);
+        format(state, "{s}\n", (FormatArg[]) { { .s = line } });
+    }
+    snprintf(line, MAX_SUMMARY_LINE, "%-24s%12.3f", "total", (double)total_time * 1.0e-6);
+    format(state, "{s}\n", (FormatArg[]) { { .s = line } });
+    format(state, "peak memory pool size: {u} KB\n", (FormatArg[]) {
+        { .u = trace->mem_pool->peak_alloc_size / 1024 } });
+    free_dyn_array(&summaries);
+}
+
+static void write_json_str(FILE* file, const char* str) {
+    fputc('\"', file);
+    for (; *str; ++str) {
+        if (*str == '\"' || *str == '\\')
+            fprintf(file, "\\%c", *str);
+        else if ((unsigned char)*str < 0x20)
+            fprintf(file, "\\u%04x", (unsigned)*str);
+        else
+            fputc(*str, file);
+    }
+    fputc('\"', file);
+}
+
+void write_trace_json(const Trace* trace, FILE* file) {
+    // Complete events (phase "X"), with time stamps and durations in microseconds
+    fprintf(file, "{\"traceEvents\":[");
+    const Span* spans = trace->spans.elems;
+    for (size_t i = 0; i < trace->spans.size; ++i) {
+        fprintf(file, "%s\n{\"name\":", i > 0 ? "," : "");
+        write_json_str(file, spans[i].name);
+        fprintf(file, ",\"cat\":");
+        write_json_str(file, spans[i].category);
+        fprintf(file,
+            ",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%zu,\"args\":{\"alloc_size\":%zu}}",
+            (double)(spans[i].begin_time - trace->start_time) * 1.0e-3,
+            (double)(spans[i].end_time - spans[i].begin_time) * 1.0e-3,
+            spans[i].thread_index,
+            spans[i].alloc_size);
+    }
+    fprintf(file, "\n],\"displayTimeUnit\":\"ms\"}\n");
+}
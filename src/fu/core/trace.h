@@ -0,0 +1,53 @@
+#ifndef FU_CORE_TRACE_H
+#define FU_CORE_TRACE_H
+
+#include "fu/core/dyn_array.h"
+#include "fu/core/format.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * A trace records spans, which measure the time spent in a region of code, along with the amount of
+ * memory allocated from a given memory pool during that time. Spans can be nested, and are grouped
+ * by category (e.g. "pass", "file", or "decl"). The recorded spans can be summarized as a table, or
+ * written in the Chrome trace-event format, which can be viewed with `chrome://tracing` or Perfetto.
+ */
+
+typedef struct MemPool MemPool;
+
+typedef struct {
+    const char* category;
+    const char* name;
+    size_t thread_index;
+    uint64_t begin_time;
+    uint64_t end_time;
+    size_t alloc_size;
+} Span;
+
+typedef struct Trace {
+    MemPool* mem_pool;
+    uint64_t start_time;
+    DynArray spans;
+    DynArray open_spans;
+} Trace;
+
+/// Returns a time stamp in nanoseconds.
+uint64_t get_time_in_ns(void);
+
+Trace new_trace(MemPool*);
+void free_trace(Trace*);
+
+/// Starts a new span. The strings must outlive the trace.
+void begin_span(Trace*, const char* category, const char* name);
+void end_span(Trace*);
+
+/// Adds a span that was recorded separately (e.g. on another thread).
+/// The times of the span must come from `get_time_in_ns()`.
+void add_span(Trace*, const Span*);
+
+/// Prints the total time and memory spent in the spans of the given category, grouped by name.
+void print_trace_summary(const Trace*, const char* category, FormatState*);
+void write_trace_json(const Trace*, FILE*);
+
+#endif
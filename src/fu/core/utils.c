@@ -4,6 +4,7 @@
 #include <ctype.h>
 #include <stdlib.h>
 #include <errno.h>
+#include <assert.h>
 
 #ifdef WIN32
 #define isatty _isatty
@@ -19,6 +20,10 @@
 #define CHUNK_SIZE 4096
 #endif
 
+#ifdef FU_ALLOC_STATS
+atomic_size_t alloc_count = 0;
+#endif
+
 static size_t convert_str_to_char_ord(const char* ptr, int base, char* res) {
     char* next = NULL;
     unsigned int ord = strtoul(ptr, &next, base);
@@ -26,6 +31,60 @@ static size_t convert_str_to_char_ord(const char* ptr, int base, char* res) {
     return ord <= 255 && !errno ? next - ptr : 0;
 }
 
+static inline size_t min_size(size_t a, size_t b) {
+    return a < b ? a : b;
+}
+
+size_t bounded_edit_distance(
+    const char* left, size_t left_len,
+    const char* right, size_t right_len,
+    size_t max_dist)
+{
+    assert(max_dist <= MAX_EDIT_DISTANCE);
+    size_t too_far = max_dist + 1;
+    if ((left_len > right_len ? left_len - right_len : right_len - left_len) > max_dist)
+        return too_far;
+
+    // The common prefix and suffix do not change the distance
+    while (left_len > 0 && right_len > 0 && *left == *right)
+        left++, right++, left_len--, right_len--;
+    while (left_len > 0 && right_len > 0 && left[left_len - 1] == right[right_len - 1])
+        left_len--, right_len--;
+
+    // The distance between the first `i` characters of `left` and the first `j` characters of
+    // `right` is stored at index `j - i + max_dist` of the row `i`. Only two rows are kept.
+    size_t rows[2][2 * MAX_EDIT_DISTANCE + 1];
+    size_t* prev = rows[0], *cur = rows[1];
+    size_t width = 2 * max_dist + 1;
+    for (size_t d = 0; d < width; ++d)
+        prev[d] = d >= max_dist ? d - max_dist : too_far;
+    for (size_t i = 1; i <= left_len; ++i) {
+        size_t row_min = too_far;
+        for (size_t d = 0; d < width; ++d) {
+            size_t j = i + d - max_dist;
+            if (i + d < max_dist || j > right_len) {
+                cur[d] = too_far;
+                continue;
+            }
+            size_t dist = i;
+            if (j > 0) {
+                dist = prev[d] + (left[i - 1] != right[j - 1]);
+                if (d + 1 < width) dist = min_size(dist, prev[d + 1] + 1);
+                if (d > 0)         dist = min_size(dist, cur[d - 1] + 1);
+            }
+            cur[d] = min_size(dist, too_far);
+            row_min = min_size(row_min, cur[d]);
+        }
+        // The distance can only grow from one row to the next
+        if (row_min > max_dist)
+            return too_far;
+        size_t* tmp = prev;
+        prev = cur;
+        cur = tmp;
+    }
+    return prev[right_len + max_dist - left_len];
+}
+
 size_t convert_escape_seq(const char* ptr, size_t n, char* res) {
     if (n == 0) return 0;
     if (ptr[0] == '\\') {
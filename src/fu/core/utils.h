@@ -21,6 +21,16 @@ static inline unsigned ilog2(uintmax_t i) {
     return p;
 }
 
+#define MAX_EDIT_DISTANCE 8
+
+/// Computes the Levenshtein distance between two strings, if it is lower or equal to the given
+/// maximum distance, or returns `max_dist + 1` otherwise. This only looks at a band of
+/// `2 * max_dist + 1` diagonals, and thus runs in `O(max_dist * min(left_len, right_len))`.
+size_t bounded_edit_distance(
+    const char* left, size_t left_len,
+    const char* right, size_t right_len,
+    size_t max_dist);
+
 size_t convert_escape_seq(const char* str, size_t n, char* res);
 bool is_color_supported(FILE*);
 char* read_file(const char* file_name, size_t* file_size);
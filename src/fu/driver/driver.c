@@ -1,5 +1,7 @@
 #include "fu/driver/driver.h"
 #include "fu/driver/options.h"
+#include "fu/driver/session.h"
+#include "fu/driver/query.h"
 #include "fu/lang/ast.h"
 #include "fu/lang/lexer.h"
 #include "fu/lang/parser.h"
@@ -9,55 +11,232 @@
 #include "fu/lang/type_table.h"
 #include "fu/core/utils.h"
 #include "fu/core/mem_pool.h"
+#include "fu/core/thread_pool.h"
+#include "fu/core/alloc.h"
+#include "fu/core/trace.h"
 
-static AstNode* parse_file(const char* file_name, MemPool* mem_pool, Log* log) {
+static AstNode* parse_file(
+    const char* file_name,
+    MemPool* mem_pool,
+    Log* log,
+    atomic_size_t* node_id_count,
+    ParseStats* parse_stats,
+    DynArray* decl_hashes)
+{
     size_t file_size = 0;
     char* file_data = read_file(file_name, &file_size);
     if (!file_data) {
         log_error(log, NULL, "cannot open file '{s}'", (FormatArg[]) { { .s = file_name } });
         return NULL;
     }
+    if (file_size > MAX_LEXER_FILE_SIZE) {
+        log_error(log, NULL, "file '{s}' is too large", (FormatArg[]) { { .s = file_name } });
+        free(file_data);
+        return NULL;
+    }
     Lexer lexer = new_lexer(file_name, file_data, file_size, log);
-    Parser parser = make_parser(&lexer, mem_pool);
+    Parser parser = make_parser(&lexer, mem_pool, node_id_count);
+    parser.ast_node_counts = parse_stats->ast_node_counts;
+    parser.decl_hashes = decl_hashes;
     AstNode* program = parse_program(&parser);
+    parse_stats->token_count += lexer.token_count;
     free_lexer(&lexer);
     free(file_data);
     return program;
 }
 
-bool compile_file(const char* file_name, const Options* options, Log* log) {
-    MemPool mem_pool = new_mem_pool();
-    AstNode* program = parse_file(file_name, &mem_pool, log);
-    if (!program)
-        return false;
+static inline void begin_pass(Session* session, const char* name) {
+    if (session->trace)
+        begin_span(session->trace, "pass", name);
+}
 
-    // Bind names to their declaration sites
-    if (log->error_count == 0) {
-        Env env = new_env(log);
-        bind_program(&env, program);
-        free_env(&env);
-    }
+static inline void end_pass(Session* session) {
+    if (session->trace)
+        end_span(session->trace);
+}
+
+static void bind_and_export_program(Session* session, AstNode* program) {
+    // Bind names to their declaration sites, and make public declarations visible to other files
+    begin_pass(session, "bind");
+    bind_program(&session->env, program);
+    export_program(&session->env, program);
+    end_pass(session);
+}
+
+static bool compile_program(Session* session, AstNode* program) {
+    Log* log = session->log;
+
+    if (log->error_count == 0)
+        bind_and_export_program(session, program);
 
     // Check types
-    if (!options->no_type_check && log->error_count == 0) {
-        TypeTable* type_table = new_type_table(&mem_pool);
-        TypingContext context = new_typing_context(type_table, &mem_pool, log);
-        infer_program(&context, program);
-        free_typing_context(&context);
-        free_type_table(type_table);
+    if (!session->options->no_type_check && log->error_count == 0) {
+        begin_pass(session, "check");
+        if (session->thread_pool)
+            infer_program_in_parallel(&session->typing_context, program, session->thread_pool);
+        else
+            infer_program(&session->typing_context, program);
+        end_pass(session);
     }
 
     // Print the AST
-    if (options->print_ast) {
+    if (session->options->print_ast) {
+        begin_pass(session, "print");
         FormatState state = new_format_state("    ",
             log->state->ignore_style || !is_color_supported(stdout));
         print_ast(&state, program);
         write_format_state(&state, stdout);
         free_format_state(&state);
         printf("\n");
+        end_pass(session);
     }
 
-    free_mem_pool(&mem_pool);
     return log->error_count == 0;
 }
 
+bool compile_file(Session* session, const char* file_name) {
+    if (session->trace)
+        begin_span(session->trace, "file", file_name);
+    begin_pass(session, "parse");
+    AstNode* program = parse_file(file_name, &session->mem_pool, session->log,
+        &session->ast_node_id_count, &session->parse_stats, NULL);
+    end_pass(session);
+    bool status = program && compile_program(session, program);
+    if (session->trace)
+        end_span(session->trace);
+    return status;
+}
+
+AstNode* parse_and_bind_file(Session* session, const char* file_name, DynArray* decl_hashes) {
+    begin_pass(session, "parse");
+    AstNode* program = parse_file(file_name, &session->mem_pool, session->log,
+        &session->ast_node_id_count, &session->parse_stats, decl_hashes);
+    end_pass(session);
+    if (!program || session->log->error_count > 0)
+        return NULL;
+    bind_and_export_program(session, program);
+    return session->log->error_count == 0 ? program : NULL;
+}
+
+typedef struct {
+    const char* file_name;
+    AstNode* program;
+    FormatState state;
+    Log log;
+    Span parse_span;
+    ParseStats parse_stats;
+} ParsedFile;
+
+typedef struct {
+    ParsedFile* files;
+    MemPool* mem_pools;
+    atomic_size_t* node_id_count;
+} ParseTasks;
+
+static void parse_file_task(void* data, size_t file_index, size_t thread_index) {
+    ParseTasks* tasks = data;
+    ParsedFile* file = &tasks->files[file_index];
+    MemPool* mem_pool = &tasks->mem_pools[thread_index];
+    size_t alloc_size = mem_pool->alloc_size;
+    uint64_t begin_time = get_time_in_ns();
+    file->program = parse_file(file->file_name, mem_pool, &file->log,
+        tasks->node_id_count, &file->parse_stats, NULL);
+    file->parse_span = (Span) {
+        .category = "pass",
+        .name = "parse",
+        .thread_index = thread_index,
+        .begin_time = begin_time,
+        .end_time = get_time_in_ns(),
+        .alloc_size = mem_pool->alloc_size - alloc_size
+    };
+}
+
+static bool compile_files_in_parallel(Session* session, const char* const* file_names, size_t file_count) {
+    // Files are parsed in parallel, each with its own log, so that diagnostics can be buffered
+    // and then printed in the order in which files appear on the command line.
+    Log* log = session->log;
+    size_t job_count = session->options->job_count;
+    ParsedFile* files = malloc_or_die(sizeof(ParsedFile) * file_count);
+    MemPool* mem_pools = malloc_or_die(sizeof(MemPool) * job_count);
+    for (size_t i = 0; i < job_count; ++i)
+        mem_pools[i] = new_mem_pool();
+    for (size_t i = 0; i < file_count; ++i) {
+        files[i].file_name = file_names[i];
+        files[i].program = NULL;
+        files[i].parse_stats = (ParseStats) { 0 };
+        files[i].state = new_format_state(log->state->tab, log->state->ignore_style);
+        files[i].log = new_buffered_log(&files[i].state, log);
+    }
+
+    run_tasks(session->thread_pool, file_count, parse_file_task, &(ParseTasks) { files, mem_pools, &session->ast_node_id_count });
+
+    // The AST of every file is now owned by the session
+    for (size_t i = 0; i < job_count; ++i)
+        merge_mem_pool(&session->mem_pool, &mem_pools[i]);
+
+    bool status = true;
+    for (size_t i = 0; i < file_count && status; ++i) {
+        merge_log(log, &files[i].log);
+        add_parse_stats(session, &files[i].parse_stats);
+        if (session->trace) {
+            add_span(session->trace, &files[i].parse_span);
+            begin_span(session->trace, "file", files[i].file_name);
+        }
+        status = files[i].program && compile_program(session, files[i].program);
+        if (session->trace)
+            end_span(session->trace);
+    }
+
+    for (size_t i = 0; i < file_count; ++i) {
+        free_log(&files[i].log);
+        free_format_state(&files[i].state);
+    }
+    free(mem_pools);
+    free(files);
+    return status;
+}
+
+bool compile_files(Session* session, const char* const* file_names, size_t file_count) {
+    if (session->options->job_count > 1 && file_count > 1)
+        return compile_files_in_parallel(session, file_names, file_count);
+    bool status = true;
+    for (size_t i = 0; i < file_count && status; ++i)
+        status &= compile_file(session, file_names[i]);
+    return status;
+}
+
+bool print_decl_type(Session* session, const char* const* file_names, size_t file_count, const char* decl_name) {
+    QueryEngine* engine = new_query_engine(session);
+    AstNode* decl = NULL;
+    bool status = true;
+    for (size_t i = 0; i < file_count && status; ++i) {
+        const ParsedProgram* parsed_program = query_parse(engine, file_names[i]);
+        status = parsed_program != NULL;
+        // Declarations in later files take precedence over those in earlier files
+        AstNode* found_decl = status ? find_top_level_decl(parsed_program->program, decl_name) : NULL;
+        decl = found_decl ? found_decl : decl;
+    }
+    if (status && !decl) {
+        log_error(session->log, NULL, "unknown declaration '{s}'", (FormatArg[]) { { .s = decl_name } });
+        status = false;
+    }
+
+    // Only the declarations that the requested one depends on are checked
+    if (status) {
+        begin_pass(session, "check");
+        const Type* type = query_decl_type(engine, decl);
+        end_pass(session);
+        status = session->log->error_count == 0;
+        if (status) {
+            FormatState state = new_format_state("    ",
+                session->log->state->ignore_style || !is_color_supported(stdout));
+            format(&state, "{s} : ", (FormatArg[]) { { .s = decl_name } });
+            print_type(&state, type);
+            write_format_state(&state, stdout);
+            free_format_state(&state);
+            printf("\n");
+        }
+    }
+    free_query_engine(engine);
+    return status;
+}
@@ -2,10 +2,27 @@
 #define FU_DRIVER_DRIVER_H
 
 #include <stdbool.h>
+#include <stddef.h>
 
-typedef struct Log Log;
-typedef struct Options Options;
+typedef struct Session Session;
+typedef struct AstNode AstNode;
+typedef struct DynArray DynArray;
 
-bool compile_file(const char* file_name, const Options* options, Log* log);
+/// Compiles a file in the given session. The public declarations of the file are
+/// visible to the files that are compiled afterwards in the same session.
+bool compile_file(Session*, const char* file_name);
+
+/// Compiles the given files in order, stopping at the first file that contains errors. When more than
+/// one job is requested, files are parsed in parallel, but diagnostics are still reported in order.
+bool compile_files(Session*, const char* const* file_names, size_t file_count);
+
+/// Parses a file, binds its names, and makes its public declarations visible to the files that are
+/// compiled afterwards in the same session. Returns `NULL` if errors were reported. The hash of the
+/// tokens of each top-level declaration is pushed on the given array, if it is not `NULL`.
+AstNode* parse_and_bind_file(Session*, const char* file_name, DynArray* decl_hashes);
+
+/// Prints the type of the top-level declaration with the given name in the given files. Only that
+/// declaration and the declarations it depends on are checked.
+bool print_decl_type(Session*, const char* const* file_names, size_t file_count, const char* decl_name);
 
 #endif
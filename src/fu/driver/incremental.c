@@ -0,0 +1,424 @@
+#include "fu/driver/incremental.h"
+#include "fu/driver/query.h"
+#include "fu/driver/session.h"
+#include "fu/lang/ast.h"
+#include "fu/core/hash_table.h"
+#include "fu/core/str_pool.h"
+#include "fu/core/mem_pool.h"
+#include "fu/core/dyn_array.h"
+#include "fu/core/alloc.h"
+#include "fu/core/trace.h"
+#include "fu/core/log.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+#define CACHE_HEADER "fu-cache-1"
+#define MAX_CACHE_STR_LEN 4096
+#define CACHE_STR_FORMAT "%4095s"
+#define CACHE_LINE_FORMAT " %4095[^\n]"
+
+typedef struct {
+    size_t file_index; // Index of the file in the current compilation, or `SIZE_MAX` if unknown
+    const char* name;  // Interned
+} DeclRef;
+
+typedef struct {
+    HashCode hash;
+    bool is_clean;     // `true` if no error was reported when checking the declaration
+    DynArray deps;     // Top-level declarations read when checking the declaration, as `DeclRef`
+} DeclRecord;
+
+typedef struct {
+    DeclRef ref;       // The name is `NULL` for declarations that cannot be found by name
+    AstNode* decl;
+    HashCode hash;
+    DeclRecord* cached_record;
+    DeclRecord record;
+    bool is_changed;   // `true` if the declaration or one of its dependencies has changed
+    DynArray dependents;
+} DeclEntry;
+
+typedef struct {
+    HashCode scope_hash; // Hash of the top-level names that are visible in the file
+    DynArray entries;
+} FileEntry;
+
+typedef struct {
+    DeclRef ref;
+    DeclRecord record;
+} CachedDecl;
+
+typedef struct {
+    Session* session;
+    QueryEngine* engine;
+    MemPool mem_pool;
+    StrPool str_pool;
+    const char* const* file_names;
+    FileEntry* files;
+    size_t file_count;
+    HashTable entries_by_ref;
+    HashTable entries_by_decl;
+    DynArray cached_decls;
+} IncrementalCheck;
+
+static bool compare_entries_by_ref(const void* left, const void* right) {
+    const DeclEntry* left_entry = *(const DeclEntry**)left;
+    const DeclEntry* right_entry = *(const DeclEntry**)right;
+    return
+        left_entry->ref.file_index == right_entry->ref.file_index &&
+        left_entry->ref.name == right_entry->ref.name;
+}
+
+static bool compare_entries_by_decl(const void* left, const void* right) {
+    return (*(const DeclEntry**)left)->decl == (*(const DeclEntry**)right)->decl;
+}
+
+static inline HashCode hash_decl_ref(const DeclRef* ref) {
+    return hash_ptr(hash_uint64(hash_init(), ref->file_index), ref->name);
+}
+
+static DeclEntry* find_entry_by_ref(const IncrementalCheck* check, const DeclRef* ref) {
+    DeclEntry* entry = &(DeclEntry) { .ref = *ref };
+    DeclEntry** found = find_in_hash_table(&check->entries_by_ref,
+        &entry, hash_decl_ref(ref), sizeof(DeclEntry*), compare_entries_by_ref);
+    return found ? *found : NULL;
+}
+
+static DeclEntry* find_entry_by_decl(const IncrementalCheck* check, const AstNode* decl) {
+    DeclEntry* entry = &(DeclEntry) { .decl = (AstNode*)decl };
+    DeclEntry** found = find_in_hash_table(&check->entries_by_decl,
+        &entry, hash_ptr(hash_init(), decl), sizeof(DeclEntry*), compare_entries_by_decl);
+    return found ? *found : NULL;
+}
+
+static const char* get_entry_name(const AstNode* decl) {
+    if (decl->tag != AST_CONST_DECL && decl->tag != AST_VAR_DECL)
+        return get_decl_name(decl);
+    const AstNode* pattern = decl->var_decl.pattern;
+    if (pattern->tag == AST_TYPED_PATTERN)
+        pattern = pattern->typed_pattern.left;
+    return pattern->tag == AST_IDENT_PATTERN ? pattern->ident_pattern.name : NULL;
+}
+
+static void add_entry(IncrementalCheck* check, size_t file_index, AstNode* decl, HashCode hash) {
+    DeclEntry* entry = alloc_from_mem_pool(&check->mem_pool, sizeof(DeclEntry));
+    const char* name = get_entry_name(decl);
+    *entry = (DeclEntry) {
+        .ref = { .file_index = file_index, .name = name ? make_str(&check->str_pool, name) : NULL },
+        .decl = decl,
+        .hash = hash,
+        .record = { .hash = hash, .is_clean = true, .deps = new_dyn_array(sizeof(DeclRef)) },
+        .dependents = new_dyn_array(sizeof(DeclEntry*))
+    };
+    // Declarations with the same name as a previous one can only be checked from scratch
+    if (entry->ref.name && !insert_in_hash_table(&check->entries_by_ref,
+        &entry, hash_decl_ref(&entry->ref), sizeof(DeclEntry*), compare_entries_by_ref))
+        entry->ref.name = NULL;
+    insert_in_hash_table(&check->entries_by_decl,
+        &entry, hash_ptr(hash_init(), decl), sizeof(DeclEntry*), compare_entries_by_decl);
+    push_on_dyn_array(&check->files[file_index].entries, &entry);
+}
+
+static inline HashCode hash_entry_name(const DeclEntry* entry) {
+    // Declarations without a name can declare several identifiers: Any change to them may change
+    // the names that are visible in the file.
+    return entry->ref.name ? hash_str(hash_init(), entry->ref.name) : entry->hash;
+}
+
+static void compute_scope_hashes(IncrementalCheck* check) {
+    // Hashes are summed, since the order of declarations does not matter for name resolution
+    HashCode exported_names = 0;
+    for (size_t i = 0; i < check->file_count; ++i) {
+        DeclEntry** entries = check->files[i].entries.elems;
+        HashCode own_names = 0;
+        for (size_t j = 0; j < check->files[i].entries.size; ++j)
+            own_names += hash_entry_name(entries[j]);
+        check->files[i].scope_hash = hash_uint32(hash_uint32(hash_init(), own_names), exported_names);
+        for (size_t j = 0; j < check->files[i].entries.size; ++j) {
+            if (is_public_decl(entries[j]->decl))
+                exported_names += hash_entry_name(entries[j]);
+        }
+    }
+}
+
+static size_t find_file_index(const IncrementalCheck* check, const char* file_name) {
+    for (size_t i = 0; i < check->file_count; ++i) {
+        if (!strcmp(check->file_names[i], file_name))
+            return i;
+    }
+    return SIZE_MAX;
+}
+
+static bool read_cache_str(FILE* file, const char* format, char* str) {
+    return fscanf(file, format, str) == 1 && strlen(str) < MAX_CACHE_STR_LEN - 1;
+}
+
+static bool read_cached_decls(IncrementalCheck* check, FILE* file, DynArray* file_indices) {
+    // The declarations of a file are only kept if the names that are visible in it are the same
+    char str[MAX_CACHE_STR_LEN];
+    if (!read_cache_str(file, CACHE_STR_FORMAT, str) || strcmp(str, CACHE_HEADER))
+        return false;
+    while (read_cache_str(file, CACHE_STR_FORMAT, str)) {
+        HashCode scope_hash;
+        size_t decl_count;
+        if (strcmp(str, "file") ||
+            fscanf(file, " %" SCNx32 " %zu", &scope_hash, &decl_count) != 2 ||
+            !read_cache_str(file, CACHE_LINE_FORMAT, str))
+            return false;
+        size_t file_index = find_file_index(check, str);
+        bool is_valid = file_index != SIZE_MAX && check->files[file_index].scope_hash == scope_hash;
+        push_on_dyn_array(file_indices, &file_index);
+        for (size_t i = 0; i < decl_count; ++i) {
+            HashCode hash;
+            int is_clean;
+            size_t dep_count;
+            CachedDecl cached_decl = { .ref = { .file_index = is_valid ? file_index : SIZE_MAX } };
+            if (!read_cache_str(file, CACHE_STR_FORMAT, str) ||
+                fscanf(file, " %" SCNx32 " %d %zu", &hash, &is_clean, &dep_count) != 3)
+                return false;
+            cached_decl.ref.name = make_str(&check->str_pool, str);
+            cached_decl.record = (DeclRecord) {
+                .hash = hash,
+                .is_clean = is_clean,
+                .deps = new_dyn_array(sizeof(DeclRef))
+            };
+            push_on_dyn_array(&check->cached_decls, &cached_decl);
+            DynArray* deps = &((CachedDecl*)check->cached_decls.elems)[check->cached_decls.size - 1].record.deps;
+            for (size_t j = 0; j < dep_count; ++j) {
+                DeclRef dep;
+                if (fscanf(file, " %zu", &dep.file_index) != 1 || !read_cache_str(file, CACHE_STR_FORMAT, str))
+                    return false;
+                dep.name = make_str(&check->str_pool, str);
+                push_on_dyn_array(deps, &dep);
+            }
+        }
+    }
+    return feof(file);
+}
+
+static void free_cached_decls(IncrementalCheck* check) {
+    CachedDecl* cached_decls = check->cached_decls.elems;
+    for (size_t i = 0; i < check->cached_decls.size; ++i)
+        free_dyn_array(&cached_decls[i].record.deps);
+    clear_dyn_array(&check->cached_decls);
+}
+
+static void load_cache(IncrementalCheck* check, const char* cache_file) {
+    FILE* file = fopen(cache_file, "rb");
+    if (!file)
+        return;
+
+    // Dependencies refer to files by their index in the cache, which has to be translated
+    DynArray file_indices = new_dyn_array(sizeof(size_t));
+    if (read_cached_decls(check, file, &file_indices)) {
+        CachedDecl* cached_decls = check->cached_decls.elems;
+        for (size_t i = 0; i < check->cached_decls.size; ++i) {
+            DeclRef* deps = cached_decls[i].record.deps.elems;
+            for (size_t j = 0; j < cached_decls[i].record.deps.size; ++j) {
+                deps[j].file_index = deps[j].file_index < file_indices.size
+                    ? ((size_t*)file_indices.elems)[deps[j].file_index] : SIZE_MAX;
+            }
+            DeclEntry* entry = cached_decls[i].ref.file_index != SIZE_MAX
+                ? find_entry_by_ref(check, &cached_decls[i].ref) : NULL;
+            if (entry)
+                entry->cached_record = &cached_decls[i].record;
+        }
+    } else
+        free_cached_decls(check);
+    free_dyn_array(&file_indices);
+    fclose(file);
+}
+
+static void find_changed_entries(IncrementalCheck* check) {
+    DynArray changed_entries = new_dyn_array(sizeof(DeclEntry*));
+    for (size_t i = 0; i < check->file_count; ++i) {
+        DeclEntry** entries = check->files[i].entries.elems;
+        for (size_t j = 0; j < check->files[i].entries.size; ++j) {
+            DeclEntry* entry = entries[j];
+            entry->is_changed = !entry->cached_record || entry->cached_record->hash != entry->hash;
+            if (entry->cached_record) {
+                const DeclRef* deps = entry->cached_record->deps.elems;
+                for (size_t k = 0; k < entry->cached_record->deps.size; ++k) {
+                    DeclEntry* dep = find_entry_by_ref(check, &deps[k]);
+                    if (dep)
+                        push_on_dyn_array(&dep->dependents, &entry);
+                    else
+                        entry->is_changed = true;
+                }
+            }
+            if (entry->is_changed)
+                push_on_dyn_array(&changed_entries, &entry);
+        }
+    }
+
+    // Changes propagate to the declarations that depend on changed declarations
+    while (changed_entries.size > 0) {
+        DeclEntry* entry = ((DeclEntry**)changed_entries.elems)[--changed_entries.size];
+        DeclEntry** dependents = entry->dependents.elems;
+        for (size_t i = 0; i < entry->dependents.size; ++i) {
+            if (!dependents[i]->is_changed) {
+                dependents[i]->is_changed = true;
+                push_on_dyn_array(&changed_entries, &dependents[i]);
+            }
+        }
+    }
+    free_dyn_array(&changed_entries);
+}
+
+static void add_query_deps(IncrementalCheck* check, DeclEntry* entry, const Query* query) {
+    if (!query)
+        return;
+    const Query** deps = query->deps.elems;
+    for (size_t i = 0; i < query->deps.size; ++i) {
+        if (deps[i]->kind != QUERY_DECL_TYPE)
+            continue;
+        const DeclEntry* dep = find_entry_by_decl(check, deps[i]->key);
+        if (dep == entry)
+            continue;
+        if (!dep || !dep->ref.name) {
+            // Dependencies that cannot be found by name cannot be saved
+            entry->record.is_clean = false;
+            continue;
+        }
+        const DeclRef* refs = entry->record.deps.elems;
+        bool is_known = false;
+        for (size_t j = 0; j < entry->record.deps.size && !is_known; ++j)
+            is_known = refs[j].file_index == dep->ref.file_index && refs[j].name == dep->ref.name;
+        if (!is_known)
+            push_on_dyn_array(&entry->record.deps, &dep->ref);
+    }
+}
+
+static void check_mod_members(IncrementalCheck* check, DeclEntry* entry, AstNode* mod_decl) {
+    // Function bodies are not checked when inferring the type of a module
+    for (AstNode* decl = mod_decl->mod_decl.members; decl; decl = decl->next) {
+        if (decl->tag == AST_FUN_DECL) {
+            query_body_check(check->engine, decl);
+            add_query_deps(check, entry, find_query(check->engine, QUERY_BODY_CHECK, decl));
+        } else if (decl->tag == AST_MOD_DECL)
+            check_mod_members(check, entry, decl);
+    }
+}
+
+static void check_entry(IncrementalCheck* check, DeclEntry* entry) {
+    Trace* trace = check->session->trace;
+    if (trace)
+        begin_span(trace, "decl", entry->ref.name ? entry->ref.name : "<unnamed>");
+    size_t error_count = check->session->log->error_count;
+    query_decl_type(check->engine, entry->decl);
+    add_query_deps(check, entry, find_query(check->engine, QUERY_DECL_TYPE, entry->decl));
+    if (entry->decl->tag == AST_FUN_DECL) {
+        query_body_check(check->engine, entry->decl);
+        add_query_deps(check, entry, find_query(check->engine, QUERY_BODY_CHECK, entry->decl));
+    } else if (entry->decl->tag == AST_MOD_DECL)
+        check_mod_members(check, entry, entry->decl);
+    entry->record.is_clean &= check->session->log->error_count == error_count;
+    if (trace)
+        end_span(trace);
+}
+
+static bool save_cache(IncrementalCheck* check, const char* cache_file) {
+    FILE* file = fopen(cache_file, "wb");
+    if (!file) {
+        log_error(check->session->log, NULL, "cannot write cache file '{s}'", (FormatArg[]) { { .s = cache_file } });
+        return false;
+    }
+    fprintf(file, "%s\n", CACHE_HEADER);
+    for (size_t i = 0; i < check->file_count; ++i) {
+        DeclEntry** entries = check->files[i].entries.elems;
+        size_t decl_count = 0;
+        for (size_t j = 0; j < check->files[i].entries.size; ++j)
+            decl_count += entries[j]->ref.name != NULL;
+        fprintf(file, "file %08"PRIx32" %zu %s\n", check->files[i].scope_hash, decl_count, check->file_names[i]);
+        for (size_t j = 0; j < check->files[i].entries.size; ++j) {
+            if (!entries[j]->ref.name)
+                continue;
+            const DeclRecord* record = entries[j]->is_changed ? &entries[j]->record : entries[j]->cached_record;
+            const DeclRef* deps = record->deps.elems;
+            fprintf(file, "%s %08"PRIx32" %d %zu", entries[j]->ref.name, record->hash, record->is_clean, record->deps.size);
+            for (size_t k = 0; k < record->deps.size; ++k)
+                fprintf(file, " %zu %s", deps[k].file_index, deps[k].name);
+            fprintf(file, "\n");
+        }
+    }
+    fclose(file);
+    return true;
+}
+
+bool check_files_incrementally(
+    Session* session,
+    const char* const* file_names,
+    size_t file_count,
+    const char* cache_file)
+{
+    IncrementalCheck check = {
+        .session = session,
+        .engine = new_query_engine(session),
+        .mem_pool = new_mem_pool(),
+        .file_names = file_names,
+        .file_count = file_count,
+        .files = malloc_or_die(sizeof(FileEntry) * file_count),
+        .entries_by_ref = new_hash_table(sizeof(DeclEntry*)),
+        .entries_by_decl = new_hash_table(sizeof(DeclEntry*)),
+        .cached_decls = new_dyn_array(sizeof(CachedDecl))
+    };
+    check.str_pool = new_str_pool(&session->mem_pool);
+    for (size_t i = 0; i < file_count; ++i)
+        check.files[i].entries = new_dyn_array(sizeof(DeclEntry*));
+
+    bool status = true;
+    for (size_t i = 0; i < file_count && status; ++i) {
+        const ParsedProgram* parsed_program = query_parse(check.engine, file_names[i]);
+        status = parsed_program != NULL;
+        if (!status)
+            break;
+        const HashCode* decl_hashes = parsed_program->decl_hashes.elems;
+        size_t decl_index = 0;
+        for (AstNode* decl = parsed_program->program->mod_decl.members; decl; decl = decl->next, decl_index++)
+            add_entry(&check, i, decl, decl_hashes[decl_index]);
+    }
+
+    if (status) {
+        compute_scope_hashes(&check);
+        load_cache(&check, cache_file);
+        find_changed_entries(&check);
+
+        if (session->trace)
+            begin_span(session->trace, "pass", "check");
+        for (size_t i = 0; i < file_count; ++i) {
+            DeclEntry** entries = check.files[i].entries.elems;
+            for (size_t j = 0; j < check.files[i].entries.size; ++j) {
+                // Declarations that had errors are checked again to report them
+                if (entries[j]->is_changed || !entries[j]->cached_record->is_clean) {
+                    entries[j]->is_changed = true;
+                    check_entry(&check, entries[j]);
+                }
+            }
+        }
+        if (session->trace)
+            end_span(session->trace);
+
+        status = session->log->error_count == 0;
+        status &= save_cache(&check, cache_file);
+    }
+
+    for (size_t i = 0; i < file_count; ++i) {
+        DeclEntry** entries = check.files[i].entries.elems;
+        for (size_t j = 0; j < check.files[i].entries.size; ++j) {
+            free_dyn_array(&entries[j]->record.deps);
+            free_dyn_array(&entries[j]->dependents);
+        }
+        free_dyn_array(&check.files[i].entries);
+    }
+    free_cached_decls(&check);
+    free_dyn_array(&check.cached_decls);
+    free_hash_table(&check.entries_by_ref);
+    free_hash_table(&check.entries_by_decl);
+    free_str_pool(&check.str_pool);
+    free_mem_pool(&check.mem_pool);
+    free(check.files);
+    free_query_engine(check.engine);
+    return status;
+}
@@ -0,0 +1,28 @@
+#ifndef FU_DRIVER_INCREMENTAL_H
+#define FU_DRIVER_INCREMENTAL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Incremental checking keeps, in a cache file, the hash of the tokens of every top-level declaration,
+ * along with the top-level declarations that were read when checking it. On the next compilation,
+ * a declaration is checked again only if it had errors, or if its hash or the hash of one of the
+ * declarations that it depends on (transitively) has changed. The other declarations are skipped,
+ * and their type is only inferred if a declaration that is checked again needs it.
+ * Declarations are identified by their file and name. Since name resolution depends on the set of
+ * top-level names that are visible in a file, the cache of a file is discarded when that set changes.
+ * Files are always parsed and bound entirely.
+ */
+
+typedef struct Session Session;
+
+/// Checks the given files, using and then updating the given cache file. Returns `false` if
+/// errors were reported.
+bool check_files_incrementally(
+    Session*,
+    const char* const* file_names,
+    size_t file_count,
+    const char* cache_file);
+
+#endif
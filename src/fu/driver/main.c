@@ -1,5 +1,7 @@
 #include "fu/driver/options.h"
 #include "fu/driver/driver.h"
+#include "fu/driver/incremental.h"
+#include "fu/driver/session.h"
 #include "fu/core/log.h"
 #include "fu/core/utils.h"
 
@@ -17,8 +19,18 @@ int main(int argc, char** argv) {
         goto exit;
     }
 
-    for (int i = 1; i < argc && status; ++i)
-        status &= compile_file(argv[i], &options, &log);
+    Session* session = new_session(&options, &log);
+    const char* const* file_names = (const char* const*)argv + 1;
+    if (options.query_decl)
+        status = print_decl_type(session, file_names, argc - 1, options.query_decl);
+    else if (options.cache_file)
+        status = check_files_incrementally(session, file_names, argc - 1, options.cache_file);
+    else
+        status = compile_files(session, file_names, argc - 1);
+    status &= report_session_trace(session);
+    if (options.print_stats)
+        print_session_stats(session, stdout);
+    free_session(session);
 
 exit:
     write_format_state(&state, stderr);
@@ -14,7 +14,13 @@ static void usage() {
         "        --print-ast      Prints the AST on the standard output\n"
         "        --no-type-check  Disables type checking\n"
         "        --no-color       Disables colored output\n"
-        "        --max-errors     Sets the maximum number of errors\n",
+        "        --max-errors     Sets the maximum number of errors\n"
+        "  -j    --jobs           Sets the number of threads used to parse and check files\n"
+        "        --time-passes    Prints the time and memory spent in each pass\n"
+        "        --trace-json     Writes a trace of the compilation in the Chrome trace-event format\n"
+        "        --stats          Prints statistics about the compilation on the standard output\n"
+        "        --query-type     Only prints the type of the given top-level declaration\n"
+        "        --incremental    Uses the given cache file to only check the declarations that changed\n",
         FU_VERSION);
 }
 
@@ -43,10 +49,38 @@ bool parse_options(int* argc, char** argv, Options* options, Log* log) {
             options->no_type_check = true;
         else if (!strcmp(argv[i], "--print-ast"))
             options->print_ast = true;
+        else if (!strcmp(argv[i], "--time-passes"))
+            options->time_passes = true;
+        else if (!strcmp(argv[i], "--stats"))
+            options->print_stats = true;
+        else if (!strcmp(argv[i], "--trace-json")) {
+            if (!check_option_arg(i, n, argv, log))
+                goto error;
+            options->trace_file = argv[++i];
+        } else if (!strcmp(argv[i], "--query-type")) {
+            if (!check_option_arg(i, n, argv, log))
+                goto error;
+            options->query_decl = argv[++i];
+        } else if (!strcmp(argv[i], "--incremental")) {
+            if (!check_option_arg(i, n, argv, log))
+                goto error;
+            options->cache_file = argv[++i];
+        }
         else if (!strcmp(argv[i], "--max-errors")) {
             if (!check_option_arg(i, n, argv, log))
                 goto error;
             log->max_errors = strtoull(argv[++i], NULL, 10);
+        } else if (!strcmp(argv[i], "-j") || !strcmp(argv[i], "--jobs")) {
+            if (!check_option_arg(i, n, argv, log))
+                goto error;
+            char* end = NULL;
+            unsigned long long job_count = strtoull(argv[++i], &end, 10);
+            if (*end || argv[i][0] == '-' || job_count == 0 || job_count > MAX_JOB_COUNT) {
+                log_error(log, NULL, "invalid number of jobs '{s}', expected a number between 1 and {u}",
+                    (FormatArg[]) { { .s = argv[i] }, { .u = MAX_JOB_COUNT } });
+                goto error;
+            }
+            options->job_count = job_count;
         } else {
             log_error(log, NULL, "invalid option '{s}'", (FormatArg[]) { { .s = argv[i] } });
             goto error;
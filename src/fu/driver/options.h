@@ -7,14 +7,29 @@
 
 typedef struct Log Log;
 
+// Maximum number of threads that can be requested with `--jobs`
+#define MAX_JOB_COUNT 256
+
 typedef struct Options {
     bool print_ast;
     bool no_type_check;
+    bool time_passes;
+    bool print_stats;
+    size_t job_count;
+    const char* trace_file;
+    const char* query_decl; // Name of the declaration to print the type of, if any
+    const char* cache_file; // Cache file used for incremental checking, if any
 } Options;
 
 static const Options default_options = {
     .print_ast     = false,
-    .no_type_check = false
+    .no_type_check = false,
+    .time_passes   = false,
+    .print_stats   = false,
+    .job_count     = 1,
+    .trace_file    = NULL,
+    .query_decl    = NULL,
+    .cache_file    = NULL
 };
 
 /// Parse command-line options, and remove those parsed options from the
@@ -0,0 +1,237 @@
+#include "fu/driver/query.h"
+#include "fu/driver/driver.h"
+#include "fu/driver/session.h"
+#include "fu/lang/ast.h"
+#include "fu/lang/check.h"
+#include "fu/lang/types.h"
+#include "fu/core/hash_table.h"
+#include "fu/core/str_pool.h"
+#include "fu/core/alloc.h"
+
+#include <string.h>
+#include <assert.h>
+
+typedef struct {
+    Query* query;
+    size_t error_count; // Number of errors when the query started
+} ActiveQuery;
+
+struct QueryEngine {
+    DeclObserver observer; // Must be the first member, see `get_query_engine()`
+    Session* session;
+    StrPool str_pool;        // File names used as keys
+    HashTable queries;       // Memoized queries, indexed by kind and key
+    DynArray query_list;     // Memoized queries, in creation order
+    DynArray active_queries; // Queries that are being computed, innermost last
+    DynArray programs;       // Programs that have been parsed, as `ParsedProgram*`
+};
+
+static bool compare_queries(const void* left, const void* right) {
+    const Query* left_query = *(const Query**)left;
+    const Query* right_query = *(const Query**)right;
+    if (left_query->kind != right_query->kind)
+        return false;
+    return left_query->kind == QUERY_PARSE
+        ? !strcmp(left_query->key, right_query->key)
+        : left_query->key == right_query->key;
+}
+
+static HashCode hash_query(QueryKind kind, const void* key) {
+    HashCode hash = hash_uint32(hash_init(), kind);
+    return kind == QUERY_PARSE ? hash_str(hash, key) : hash_ptr(hash, key);
+}
+
+static Query* find_query_in_table(const HashTable* queries, QueryKind kind, const void* key) {
+    Query* query = &(Query) { .kind = kind, .key = key };
+    Query** found = find_in_hash_table(queries, &query, hash_query(kind, key), sizeof(Query*), compare_queries);
+    return found ? *found : NULL;
+}
+
+static Query* find_or_insert_query(QueryEngine* engine, QueryKind kind, const void* key) {
+    Query* query = find_query_in_table(&engine->queries, kind, key);
+    if (query)
+        return query;
+    query = malloc_or_die(sizeof(Query));
+    *query = (Query) { .kind = kind, .key = key, .deps = new_dyn_array(sizeof(Query*)) };
+    if (kind == QUERY_PARSE)
+        query->key = make_str(&engine->str_pool, key);
+    insert_in_hash_table(&engine->queries, &query, hash_query(kind, key), sizeof(Query*), compare_queries);
+    push_on_dyn_array(&engine->query_list, &query);
+    return query;
+}
+
+static void add_query_dep(QueryEngine* engine, Query* dep) {
+    if (engine->active_queries.size == 0)
+        return;
+    Query* query = ((ActiveQuery*)engine->active_queries.elems)[engine->active_queries.size - 1].query;
+    Query** deps = query->deps.elems;
+    for (size_t i = 0; i < query->deps.size; ++i) {
+        if (deps[i] == dep)
+            return;
+    }
+    push_on_dyn_array(&query->deps, &dep);
+}
+
+static void begin_query(QueryEngine* engine, Query* query) {
+    add_query_dep(engine, query);
+    ActiveQuery active_query = { .query = query, .error_count = engine->session->log->error_count };
+    push_on_dyn_array(&engine->active_queries, &active_query);
+}
+
+static void end_query(QueryEngine* engine, Query* query) {
+    assert(engine->active_queries.size > 0);
+    ActiveQuery* active_query = &((ActiveQuery*)engine->active_queries.elems)[--engine->active_queries.size];
+    assert(active_query->query == query);
+    query->is_done = true;
+    query->status = engine->session->log->error_count == active_query->error_count;
+}
+
+static inline QueryEngine* get_query_engine(DeclObserver* observer) {
+    return (QueryEngine*)observer;
+}
+
+static void read_decl(DeclObserver* observer, AstNode* decl) {
+    QueryEngine* engine = get_query_engine(observer);
+    add_query_dep(engine, find_or_insert_query(engine, QUERY_DECL_TYPE, decl));
+}
+
+static void begin_decl(DeclObserver* observer, AstNode* decl) {
+    QueryEngine* engine = get_query_engine(observer);
+    begin_query(engine, find_or_insert_query(engine, QUERY_DECL_TYPE, decl));
+}
+
+static void end_decl(DeclObserver* observer, AstNode* decl) {
+    QueryEngine* engine = get_query_engine(observer);
+    end_query(engine, find_query_in_table(&engine->queries, QUERY_DECL_TYPE, decl));
+}
+
+QueryEngine* new_query_engine(Session* session) {
+    QueryEngine* engine = malloc_or_die(sizeof(QueryEngine));
+    engine->observer = (DeclObserver) {
+        .read_decl = read_decl,
+        .begin_decl = begin_decl,
+        .end_decl = end_decl
+    };
+    engine->session = session;
+    engine->str_pool = new_str_pool(&session->mem_pool);
+    engine->queries = new_hash_table(sizeof(Query*));
+    engine->query_list = new_dyn_array(sizeof(Query*));
+    engine->active_queries = new_dyn_array(sizeof(ActiveQuery));
+    engine->programs = new_dyn_array(sizeof(ParsedProgram*));
+    session->typing_context.decl_observer = &engine->observer;
+    session->typing_context.skip_fun_bodies = true;
+    return engine;
+}
+
+void free_query_engine(QueryEngine* engine) {
+    TypingContext* context = &engine->session->typing_context;
+    ParsedProgram** programs = engine->programs.elems;
+    for (size_t i = 0; i < engine->programs.size; ++i) {
+        leave_program(context, programs[i]->program);
+        free_dyn_array(&programs[i]->decl_hashes);
+        free(programs[i]);
+    }
+    context->decl_observer = NULL;
+    context->skip_fun_bodies = false;
+
+    Query** queries = engine->query_list.elems;
+    for (size_t i = 0; i < engine->query_list.size; ++i) {
+        free_dyn_array(&queries[i]->deps);
+        free(queries[i]);
+    }
+    free_str_pool(&engine->str_pool);
+    free_hash_table(&engine->queries);
+    free_dyn_array(&engine->query_list);
+    free_dyn_array(&engine->active_queries);
+    free_dyn_array(&engine->programs);
+    free(engine);
+}
+
+const ParsedProgram* query_parse(QueryEngine* engine, const char* file_name) {
+    Query* query = find_or_insert_query(engine, QUERY_PARSE, file_name);
+    if (query->is_done)
+        return query->result;
+    begin_query(engine, query);
+    DynArray decl_hashes = new_dyn_array(sizeof(HashCode));
+    AstNode* program = parse_and_bind_file(engine->session, file_name, &decl_hashes);
+    if (program) {
+        enter_program(&engine->session->typing_context, program);
+        ParsedProgram* parsed_program = malloc_or_die(sizeof(ParsedProgram));
+        parsed_program->program = program;
+        parsed_program->decl_hashes = decl_hashes;
+        push_on_dyn_array(&engine->programs, &parsed_program);
+        query->result = parsed_program;
+    } else
+        free_dyn_array(&decl_hashes);
+    end_query(engine, query);
+    return query->result;
+}
+
+static inline const Type* get_inferred_decl_type(const AstNode* decl) {
+    // Constants and variables are typed through their pattern
+    return decl->tag == AST_CONST_DECL || decl->tag == AST_VAR_DECL
+        ? decl->var_decl.pattern->type : decl->type;
+}
+
+const Type* query_decl_type(QueryEngine* engine, AstNode* decl) {
+    assert(is_module_level_decl(decl));
+
+    // The members of nested modules are inferred along with the top-level module that contains them
+    AstNode* top_level_decl = decl;
+    while (top_level_decl->parent_scope->parent_scope)
+        top_level_decl = top_level_decl->parent_scope;
+
+    if (!get_inferred_decl_type(top_level_decl))
+        infer_decl_site(&engine->session->typing_context, top_level_decl);
+    else
+        read_decl(&engine->observer, top_level_decl);
+    return get_inferred_decl_type(decl);
+}
+
+bool query_body_check(QueryEngine* engine, AstNode* fun_decl) {
+    assert(fun_decl->tag == AST_FUN_DECL);
+    Query* query = find_or_insert_query(engine, QUERY_BODY_CHECK, fun_decl);
+    if (query->is_done) {
+        add_query_dep(engine, query);
+        return query->status;
+    }
+    begin_query(engine, query);
+    if (query_decl_type(engine, fun_decl)->tag == TYPE_FUN)
+        check_fun_body(&engine->session->typing_context, fun_decl);
+    end_query(engine, query);
+    return query->status;
+}
+
+const Query* find_query(const QueryEngine* engine, QueryKind kind, const void* key) {
+    return find_query_in_table(&engine->queries, kind, key);
+}
+
+const char* get_query_kind_name(QueryKind kind) {
+    switch (kind) {
+#define f(name, str) case QUERY_##name: return str;
+        QUERY_KIND_LIST(f)
+#undef f
+        default:
+            assert(false && "invalid query kind");
+            return "";
+    }
+}
+
+static const char* get_top_level_decl_name(const AstNode* decl) {
+    if (decl->tag != AST_CONST_DECL && decl->tag != AST_VAR_DECL)
+        return get_decl_name(decl);
+    // Only constants and variables that declare a single identifier can be found by name
+    const AstNode* pattern = decl->var_decl.pattern;
+    if (pattern->tag == AST_TYPED_PATTERN)
+        pattern = pattern->typed_pattern.left;
+    return pattern->tag == AST_IDENT_PATTERN ? pattern->ident_pattern.name : NULL;
+}
+
+AstNode* find_top_level_decl(AstNode* program, const char* name) {
+    for (AstNode* decl = program->mod_decl.members; decl; decl = decl->next) {
+        const char* decl_name = get_top_level_decl_name(decl);
+        if (decl_name && !strcmp(decl_name, name))
+            return decl;
+    }
+    return NULL;
+}
@@ -0,0 +1,73 @@
+#ifndef FU_DRIVER_QUERY_H
+#define FU_DRIVER_QUERY_H
+
+#include "fu/core/dyn_array.h"
+
+#include <stdbool.h>
+
+/*
+ * The query engine runs the front-end on demand: Instead of checking whole programs, it answers
+ * queries such as "what is the type of this declaration?", doing only the work that is needed to
+ * answer them. Each query is computed at most once, and its result is memoized along with the
+ * queries that it depends on. For instance, the type of a declaration depends on the type of the
+ * top-level declarations that are read while inferring it, and the type of those declarations is
+ * in turn inferred on demand. A tool that only needs the type of one declaration thus only pays for
+ * that declaration and its transitive dependencies.
+ * Names are still bound per file, when the file is parsed, since binding needs the whole file.
+ */
+
+typedef struct Session Session;
+typedef struct AstNode AstNode;
+typedef struct Type Type;
+typedef struct QueryEngine QueryEngine;
+
+#define QUERY_KIND_LIST(f) \
+    f(PARSE, "parse") \
+    f(DECL_TYPE, "decl_type") \
+    f(BODY_CHECK, "body_check")
+
+typedef enum {
+#define f(name, ...) QUERY_##name,
+    QUERY_KIND_LIST(f)
+#undef f
+} QueryKind;
+
+typedef struct Query {
+    QueryKind kind;
+    const void* key;  // File name (interned), or declaration
+    void* result;     // `ParsedProgram` for `QUERY_PARSE`, `NULL` otherwise
+    bool is_done;
+    bool status;      // `false` if errors were reported while computing the query
+    DynArray deps;    // Queries that this query depends on
+} Query;
+
+typedef struct {
+    AstNode* program;
+    DynArray decl_hashes; // Hash of the tokens of each top-level declaration, in order
+} ParsedProgram;
+
+/// Creates a query engine on top of the given session. While the engine is alive, the typing
+/// context of the session infers declarations on demand.
+QueryEngine* new_query_engine(Session*);
+void free_query_engine(QueryEngine*);
+
+/// Parses a file, binds its names, and makes its public declarations visible to the files that are
+/// parsed afterwards. Returns `NULL` if the file could not be parsed or bound.
+const ParsedProgram* query_parse(QueryEngine*, const char* file_name);
+
+/// Returns the type of a module-level declaration, without checking the bodies of the functions
+/// that have a return type annotation.
+const Type* query_decl_type(QueryEngine*, AstNode* decl);
+
+/// Checks the body of a module-level function, and returns `true` if no error was reported.
+bool query_body_check(QueryEngine*, AstNode* fun_decl);
+
+/// Returns the memoized query with the given kind and key, or `NULL` if it was never computed.
+const Query* find_query(const QueryEngine*, QueryKind, const void* key);
+
+const char* get_query_kind_name(QueryKind);
+
+/// Returns the top-level declaration with the given name in a program, or `NULL` if there is none.
+AstNode* find_top_level_decl(AstNode* program, const char* name);
+
+#endif
@@ -0,0 +1,112 @@
+#include "fu/driver/session.h"
+#include "fu/driver/options.h"
+#include "fu/lang/type_table.h"
+#include "fu/core/thread_pool.h"
+#include "fu/core/alloc.h"
+
+#include <stdio.h>
+
+#define TYPE_SHARDS_PER_JOB 4
+
+Session* new_session(const Options* options, Log* log) {
+    Session* session = malloc_or_die(sizeof(Session));
+    session->options = options;
+    session->log = log;
+    session->mem_pool = new_mem_pool();
+    session->type_interner = new_type_interner(
+        options->job_count > 1 ? options->job_count * TYPE_SHARDS_PER_JOB : 1);
+    session->type_table = new_shared_type_table(session->type_interner, &session->mem_pool);
+    session->typing_context = new_typing_context(session->type_table, &session->mem_pool, log);
+    session->env = new_env(log);
+    session->trace = NULL;
+    session->thread_pool = options->job_count > 1 ? new_thread_pool(options->job_count) : NULL;
+    session->parse_stats = (ParseStats) { 0 };
+    atomic_init(&session->ast_node_id_count, 0);
+    if (options->time_passes || options->trace_file) {
+        session->trace = malloc_or_die(sizeof(Trace));
+        *session->trace = new_trace(&session->mem_pool);
+        session->typing_context.trace = session->trace;
+    }
+    return session;
+}
+
+void free_session(Session* session) {
+    if (session->trace) {
+        free_trace(session->trace);
+        free(session->trace);
+    }
+    if (session->thread_pool)
+        free_thread_pool(session->thread_pool);
+    free_env(&session->env);
+    free_typing_context(&session->typing_context);
+    free_type_table(session->type_table);
+    free_type_interner(session->type_interner);
+    free_mem_pool(&session->mem_pool);
+    free(session);
+}
+
+bool report_session_trace(Session* session) {
+    if (session->options->time_passes)
+        print_trace_summary(session->trace, "pass", session->log->state);
+    if (session->options->trace_file) {
+        FILE* file = fopen(session->options->trace_file, "wb");
+        if (!file) {
+            log_error(session->log, NULL, "cannot open trace file '{s}'",
+                (FormatArg[]) { { .s = session->options->trace_file } });
+            return false;
+        }
+        write_trace_json(session->trace, file);
+        fclose(file);
+    }
+    return true;
+}
+
+void add_parse_stats(Session* session, const ParseStats* parse_stats) {
+    session->parse_stats.token_count += parse_stats->token_count;
+    for (size_t i = 0; i < AST_NODE_TAG_COUNT; ++i)
+        session->parse_stats.ast_node_counts[i] += parse_stats->ast_node_counts[i];
+}
+
+static void print_hash_table_stats(FILE* file, const char* name, const HashTableStats* stats) {
+    fprintf(file, "hash_tables.%s.size %zu\n", name, stats->size);
+    fprintf(file, "hash_tables.%s.capacity %zu\n", name, stats->capacity);
+    fprintf(file, "hash_tables.%s.load_factor %.3f\n", name, stats->load_factor);
+    fprintf(file, "hash_tables.%s.avg_probe_length %.3f\n", name, stats->avg_probe_length);
+    fprintf(file, "hash_tables.%s.max_probe_length %zu\n", name, stats->max_probe_length);
+}
+
+void print_session_stats(Session* session, FILE* file) {
+    const ParseStats* parse_stats = &session->parse_stats;
+    fprintf(file, "tokens %zu\n", parse_stats->token_count);
+    size_t ast_node_count = 0;
+    for (size_t i = 0; i < AST_NODE_TAG_COUNT; ++i)
+        ast_node_count += parse_stats->ast_node_counts[i];
+    fprintf(file, "ast_nodes %zu\n", ast_node_count);
+    fprintf(file, "ast_node_ids %zu\n", atomic_load(&session->ast_node_id_count));
+    for (size_t i = 0; i < AST_NODE_TAG_COUNT; ++i) {
+        if (parse_stats->ast_node_counts[i] > 0)
+            fprintf(file, "ast_nodes.%s %zu\n", get_ast_node_tag_name(i), parse_stats->ast_node_counts[i]);
+    }
+
+    TypeTableStats type_table_stats = get_type_table_stats(session->type_table);
+    fprintf(file, "strings %zu\n", type_table_stats.str_count);
+    fprintf(file, "types %zu\n", type_table_stats.type_count);
+    fprintf(file, "kinds %zu\n", type_table_stats.kind_count);
+    print_hash_table_stats(file, "types", &type_table_stats.types);
+    print_hash_table_stats(file, "strings", &type_table_stats.strs);
+    print_hash_table_stats(file, "shallow_types", &type_table_stats.shallow_types);
+    print_hash_table_stats(file, "sub_types", &type_table_stats.sub_types);
+    fprintf(file, "sub_type_cache.hits %zu\n", type_table_stats.sub_type_cache_hits);
+    fprintf(file, "sub_type_cache.misses %zu\n", type_table_stats.sub_type_cache_misses);
+    fprintf(file, "substitutions %zu\n", type_table_stats.substitution_count);
+    fprintf(file, "replace_cache.hits %zu\n", type_table_stats.replace_cache_hits);
+    fprintf(file, "replace_cache.misses %zu\n", type_table_stats.replace_cache_misses);
+    fprintf(file, "instances %zu\n", type_table_stats.instance_count);
+    fprintf(file, "instance_cache.hits %zu\n", type_table_stats.instance_cache_hits);
+    fprintf(file, "instance_cache.misses %zu\n", type_table_stats.instance_cache_misses);
+
+    fprintf(file, "mem_pool.alloc_size %zu\n", session->mem_pool.alloc_size);
+    fprintf(file, "mem_pool.peak_alloc_size %zu\n", session->mem_pool.peak_alloc_size);
+    fprintf(file, "diagnostics.errors %zu\n", session->log->error_count);
+    fprintf(file, "diagnostics.warnings %zu\n", session->log->warning_count);
+}
@@ -0,0 +1,59 @@
+#ifndef FU_DRIVER_SESSION_H
+#define FU_DRIVER_SESSION_H
+
+#include "fu/lang/bind.h"
+#include "fu/lang/check.h"
+#include "fu/core/mem_pool.h"
+#include "fu/core/trace.h"
+
+#include <stdio.h>
+#include <stdatomic.h>
+
+/*
+ * A compilation session holds the state that is shared by all the files compiled in one invocation
+ * of the compiler: The memory pool that holds the AST and the types, the type table (which also
+ * interns strings), and the environment in which the public declarations of the files compiled so
+ * far are visible. Builtin and structural types are thus created only once for the whole session.
+ * When several jobs are requested, the session also holds the thread pool that parses files and
+ * checks function bodies, and the interner of the type table is sharded, so that other type
+ * tables can be created on top of it for those threads.
+ * When requested, the session also records a trace of the time spent in each pass.
+ */
+
+typedef struct Options Options;
+typedef struct TypeInterner TypeInterner;
+typedef struct ThreadPool ThreadPool;
+
+typedef struct {
+    size_t token_count;
+    size_t ast_node_counts[AST_NODE_TAG_COUNT];
+} ParseStats;
+
+typedef struct Session {
+    const Options* options;
+    Log* log;
+    MemPool mem_pool;
+    TypeInterner* type_interner;
+    TypeTable* type_table;
+    TypingContext typing_context;
+    Env env;
+    Trace* trace;
+    ThreadPool* thread_pool; // `NULL` when only one job is requested
+    ParseStats parse_stats;
+    atomic_size_t ast_node_id_count;
+} Session;
+
+Session* new_session(const Options*, Log*);
+void free_session(Session*);
+
+/// Prints the time spent in each pass and writes the trace file, if those were requested.
+bool report_session_trace(Session*);
+
+/// Adds the number of tokens and AST nodes of a file to the totals of the session.
+void add_parse_stats(Session*, const ParseStats*);
+
+/// Prints statistics about the session, one `name value` pair per line, in a format
+/// that can easily be processed by other tools (e.g. to track regressions over time).
+void print_session_stats(Session*, FILE*);
+
+#endif
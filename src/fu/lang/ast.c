@@ -639,6 +639,84 @@ AstNodeTag assign_expr_to_binary_expr(AstNodeTag tag) {
     }
 }
 
+const char* get_ast_node_tag_name(AstNodeTag tag) {
+    switch (tag) {
+#define f(name) case AST_##name: return #name;
+        f(ERROR)
+        f(TYPE_PARAM)
+        f(ATTR)
+        f(IMPLICIT_CAST)
+        f(PATH_ELEM)
+        f(PATH)
+        f(KIND_STAR)
+        f(KIND_ARROW)
+        f(TUPLE_TYPE)
+        f(ARRAY_TYPE)
+        f(PTR_TYPE)
+        f(FUN_TYPE)
+        f(NORET_TYPE)
+        f(WHERE_TYPE)
+        f(WHERE_CLAUSE)
+        f(BOOL_LITERAL)
+        f(INT_LITERAL)
+        f(FLOAT_LITERAL)
+        f(CHAR_LITERAL)
+        f(STR_LITERAL)
+        f(FUN_DECL)
+        f(CONST_DECL)
+        f(VAR_DECL)
+        f(VAL_DECL)
+        f(TYPE_DECL)
+        f(FIELD_DECL)
+        f(OPTION_DECL)
+        f(STRUCT_DECL)
+        f(ENUM_DECL)
+        f(MOD_DECL)
+        f(SIG_DECL)
+        f(USING_DECL)
+        f(ASSIGN_EXPR)
+        f(BLOCK_EXPR)
+        f(FUN_EXPR)
+        f(IF_EXPR)
+        f(FIELD_EXPR)
+        f(STRUCT_EXPR)
+        f(UPDATE_EXPR)
+        f(TUPLE_EXPR)
+        f(CALL_EXPR)
+        f(TYPED_EXPR)
+        f(MATCH_CASE)
+        f(MATCH_EXPR)
+        f(ARRAY_EXPR)
+        f(MEMBER_EXPR)
+        f(BREAK_EXPR)
+        f(CONTINUE_EXPR)
+        f(RETURN_EXPR)
+        f(WHILE_LOOP)
+        f(FOR_LOOP)
+        f(IDENT_PATTERN)
+        f(FIELD_PATTERN)
+        f(STRUCT_PATTERN)
+        f(CTOR_PATTERN)
+        f(TUPLE_PATTERN)
+        f(TYPED_PATTERN)
+        f(ARRAY_PATTERN)
+#undef f
+#define f(name, ...) case AST_TYPE_##name: return "TYPE_" #name;
+        PRIM_TYPE_LIST(f)
+#undef f
+#define f(name, ...) case AST_##name##_EXPR: return #name "_EXPR";
+        AST_BINARY_EXPR_LIST(f)
+        AST_UNARY_EXPR_LIST(f)
+#undef f
+#define f(name, ...) case AST_##name##_ASSIGN_EXPR: return #name "_ASSIGN_EXPR";
+        AST_ASSIGN_EXPR_LIST(f)
+#undef f
+        default:
+            assert(false && "invalid AST node tag");
+            return "";
+    }
+}
+
 const char* get_prim_type_name(AstNodeTag tag) {
     switch (tag) {
 #define f(name, str) case AST_TYPE_##name: return str;
@@ -141,11 +141,14 @@ typedef enum {
     AST_ARRAY_PATTERN
 } AstNodeTag;
 
+#define AST_NODE_TAG_COUNT (AST_ARRAY_PATTERN + 1)
+
 typedef struct AstNode AstNode;
 typedef struct SignatureVars SignatureVars;// Internal, used during type-checking
 
 struct AstNode {
     AstNodeTag tag;
+    size_t id; // Dense identifier, which can be used to index arrays of per-node data
     FileLoc file_loc;
     const Type* type;
     AstNode* parent_scope;
@@ -355,6 +358,7 @@ struct AstNode {
         struct {
             const char* name;
             bool is_const;
+            AstNode* var_decl; // Constant or variable declaration that binds the identifier, if any
         } ident_pattern;
         struct {
             AstNode* cond;
@@ -389,6 +393,7 @@ const AstNode* get_parent_scope_with_tag(const AstNode*, AstNodeTag);
 const AstNode* get_parent_mod_decl(const AstNode*);
 
 AstNodeTag assign_expr_to_binary_expr(AstNodeTag);
+const char* get_ast_node_tag_name(AstNodeTag);
 const char* get_prim_type_name(AstNodeTag);
 const char* get_unary_expr_op(AstNodeTag);
 const char* get_binary_expr_op(AstNodeTag);
@@ -4,124 +4,257 @@
 #include "fu/core/hash.h"
 #include "fu/core/alloc.h"
 #include "fu/core/log.h"
+#include "fu/core/utils.h"
 
 #include <string.h>
 #include <stdlib.h>
 #include <assert.h>
 
+#define NO_DECL SIZE_MAX
+#define MAX_SUGGESTION_DISTANCE 1
+
+// Maps a name to the innermost declaration with that name, if any.
 typedef struct {
     const char* name;
-    AstNode* decl_site;
+    size_t decl_index;
 } Symbol;
 
-struct Scope {
-    HashTable symbols;
+// Declarations are stored on a stack, and refer to the declaration that they shadow.
+typedef struct {
+    const char* name;
+    HashCode hash;
+    AstNode* decl_site;
+    size_t scope_depth;
+    size_t shadowed_index;
+} Decl;
+
+typedef struct {
     AstNode* ast_node;
-    struct Scope* prev, *next;
+    size_t first_decl;
+} Scope;
+
+/*
+ * Names are indexed by the strings obtained by deleting at most one of their characters (their
+ * deletion keys): Two names at an edit distance of one always have a deletion key in common, which
+ * means that the candidates for a suggestion are found with one lookup per character of the
+ * unknown identifier. Names are only added to the index when a suggestion is needed.
+ */
+
+typedef struct {
+    const char* name;
+    size_t len;
+    HashCode hash;
+} Name;
+
+typedef struct {
+    const char* str;
+    size_t len;
+    size_t deleted_index; // Equal to `len` when no character is deleted
+    size_t first_posting;
+} DeletionKey;
+
+typedef struct {
+    size_t name_index;
+    size_t next_posting;
+} Posting;
+
+struct NameIndex {
+    DynArray names;
+    HashTable keys;
+    DynArray postings;
+    size_t indexed_name_count;
 };
 
 static bool compare_symbols(const void* left, const void* right) {
     return !strcmp(((Symbol*)left)->name, ((Symbol*)right)->name);
 }
 
-static Scope* new_scope(Scope* prev) {
-    Scope* scope = malloc_or_die(sizeof(Scope));
-    scope->prev = prev;
-    scope->next = NULL;
-    scope->symbols = new_hash_table(sizeof(Symbol));
-    if (prev)
-        prev->next = scope;
-    return scope;
+static inline Scope* get_cur_scope(const Env* env) {
+    assert(env->scopes.size > 0);
+    return &((Scope*)env->scopes.elems)[env->scopes.size - 1];
+}
+
+static inline size_t get_scope_depth(const Env* env) {
+    return env->scopes.size - 1;
+}
+
+static inline Decl* get_decl(const Env* env, size_t index) {
+    assert(index < env->decls.size);
+    return &((Decl*)env->decls.elems)[index];
+}
+
+static inline AstNode* get_cur_scope_node(const Env* env) {
+    return get_cur_scope(env)->ast_node;
 }
 
 Env new_env(Log* log) {
-    return (Env) { .log = log, .first_scope = new_scope(NULL) };
+    Env env = {
+        .log = log,
+        .symbols = new_hash_table(sizeof(Symbol)),
+        .decls = new_dyn_array(sizeof(Decl)),
+        .scopes = new_dyn_array(sizeof(Scope)),
+        .name_index = malloc_or_die(sizeof(NameIndex))
+    };
+    *env.name_index = (NameIndex) {
+        .names = new_dyn_array(sizeof(Name)),
+        .keys = new_hash_table(sizeof(DeletionKey)),
+        .postings = new_dyn_array(sizeof(Posting))
+    };
+    // The first scope is the global scope, which contains the declarations exported by programs.
+    push_on_dyn_array(&env.scopes, &(Scope) { .ast_node = NULL, .first_decl = 0 });
+    return env;
 }
 
 void free_env(Env* env) {
-    Scope* scope = env->first_scope;
-    while (scope) {
-        Scope* next = scope->next;
-        free_hash_table(&scope->symbols);
-        free(scope);
-        scope = next;
-    }
+    free_hash_table(&env->symbols);
+    free_dyn_array(&env->decls);
+    free_dyn_array(&env->scopes);
+    free_dyn_array(&env->name_index->names);
+    free_hash_table(&env->name_index->keys);
+    free_dyn_array(&env->name_index->postings);
+    free(env->name_index);
+}
+
+static inline Symbol* find_or_insert_symbol(Env* env, const char* name, HashCode hash) {
+    Symbol* symbol = find_in_hash_table(&env->symbols,
+        &(Symbol) { .name = name }, hash, sizeof(Symbol), compare_symbols);
+    if (symbol)
+        return symbol;
+    insert_in_hash_table(&env->symbols,
+        &(Symbol) { .name = name, .decl_index = NO_DECL }, hash, sizeof(Symbol), compare_symbols);
+    push_on_dyn_array(&env->name_index->names, &(Name) { .name = name, .len = strlen(name), .hash = hash });
+    // The insertion may have moved the elements of the table
+    return find_in_hash_table(&env->symbols,
+        &(Symbol) { .name = name }, hash, sizeof(Symbol), compare_symbols);
 }
 
 static void insert_symbol(Env* env, const char* name, AstNode* decl_site) {
-    assert(env->cur_scope);
     // Variables or patterns that begin with '_' are anonymous and cannot be referred to.
     if (name[0] == '_')
         return;
-    Symbol symbol = { .name = name, .decl_site = decl_site };
-    uint32_t hash = hash_str(hash_init(), name);
-    bool was_inserted = insert_in_hash_table(&env->cur_scope->symbols,
-        &symbol, hash, sizeof(Symbol), compare_symbols);
-    if (!was_inserted) {
-        log_error(env->log, &decl_site->file_loc, "redefinition of symbol '{s}'",
-            (FormatArg[]) { { .s = name } });
-        const Symbol* prev_symbol = find_in_hash_table(&env->cur_scope->symbols,
-            &symbol, hash, sizeof(Symbol), compare_symbols);
-        assert(prev_symbol);
-        log_note(env->log, &prev_symbol->decl_site->file_loc, "previously declared here", NULL);
+    HashCode hash = hash_str(hash_init(), name);
+    Symbol* symbol = find_or_insert_symbol(env, name, hash);
+    size_t scope_depth = get_scope_depth(env);
+    if (symbol->decl_index != NO_DECL) {
+        const Decl* prev_decl = get_decl(env, symbol->decl_index);
+        if (prev_decl->scope_depth == scope_depth) {
+            log_error(env->log, &decl_site->file_loc, "redefinition of symbol '{s}'",
+                (FormatArg[]) { { .s = name } });
+            log_note(env->log, &prev_decl->decl_site->file_loc, "previously declared here", NULL);
+            return;
+        }
     }
+    push_on_dyn_array(&env->decls, &(Decl) {
+        .name = name,
+        .hash = hash,
+        .decl_site = decl_site,
+        .scope_depth = scope_depth,
+        .shadowed_index = symbol->decl_index
+    });
+    symbol->decl_index = env->decls.size - 1;
 }
 
-static size_t levenshtein_distance(const char* left, const char* right, size_t min_dist) {
-    if (!*left)  return strlen(right);
-    if (!*right) return strlen(left);
+static inline size_t get_deletion_key_len(const DeletionKey* key) {
+    return key->deleted_index < key->len ? key->len - 1 : key->len;
+}
 
-    if (left[0] == right[0])
-        return levenshtein_distance(left + 1, right + 1, min_dist);
+static inline char get_deletion_key_char(const DeletionKey* key, size_t i) {
+    return key->str[i < key->deleted_index ? i : i + 1];
+}
 
-    if (min_dist == 0)
-        return 1;
+static bool compare_deletion_keys(const void* left, const void* right) {
+    const DeletionKey* left_key = left, *right_key = right;
+    size_t len = get_deletion_key_len(left_key);
+    if (len != get_deletion_key_len(right_key))
+        return false;
+    for (size_t i = 0; i < len; ++i) {
+        if (get_deletion_key_char(left_key, i) != get_deletion_key_char(right_key, i))
+            return false;
+    }
+    return true;
+}
+
+static HashCode hash_deletion_key(const DeletionKey* key) {
+    HashCode hash = hash_raw_bytes(hash_init(), key->str, key->deleted_index);
+    if (key->deleted_index < key->len)
+        hash = hash_raw_bytes(hash, key->str + key->deleted_index + 1, key->len - key->deleted_index - 1);
+    return hash;
+}
 
-    size_t a = levenshtein_distance(left + 1, right, min_dist - 1);
-    size_t b = levenshtein_distance(left, right + 1, min_dist - 1);
-    size_t c = levenshtein_distance(left + 1, right + 1, min_dist - 1);
-    size_t min = a;
-    min = min < b ? min : b;
-    min = min < c ? min : c;
-    return 1 + min;
+static inline const DeletionKey* find_deletion_key(const NameIndex* name_index, const DeletionKey* key) {
+    return find_in_hash_table(&name_index->keys,
+        key, hash_deletion_key(key), sizeof(DeletionKey), compare_deletion_keys);
+}
+
+static void index_name(NameIndex* name_index, size_t name_index_in_names) {
+    const Name* name = &((const Name*)name_index->names.elems)[name_index_in_names];
+    for (size_t i = 0; i <= name->len; ++i) {
+        DeletionKey key = { .str = name->name, .len = name->len, .deleted_index = i, .first_posting = NO_DECL };
+        DeletionKey* existing_key = (DeletionKey*)find_deletion_key(name_index, &key);
+        if (!existing_key) {
+            insert_in_hash_table(&name_index->keys,
+                &key, hash_deletion_key(&key), sizeof(DeletionKey), compare_deletion_keys);
+            existing_key = (DeletionKey*)find_deletion_key(name_index, &key);
+        }
+        push_on_dyn_array(&name_index->postings, &(Posting) {
+            .name_index = name_index_in_names,
+            .next_posting = existing_key->first_posting
+        });
+        existing_key->first_posting = name_index->postings.size - 1;
+    }
 }
 
 static void suggest_similar_symbol(Env* env, const char* name) {
-    size_t min_dist = 2;
+    size_t max_dist = MAX_SUGGESTION_DISTANCE;
+    size_t name_len = strlen(name);
 
     // Do not suggest similar symbols for identifiers that are too short
-    if (strlen(name) <= min_dist)
+    if (name_len <= max_dist + 1)
         return;
 
-    const char* similar_name = NULL;
-
-    for (Scope* scope = env->cur_scope; scope; scope = scope->prev) {
-        Symbol* symbols = scope->symbols.elems;
-        for (size_t i = 0; i < scope->symbols.capacity; i++) {
-            if (!is_bucket_occupied(&scope->symbols, i))
+    NameIndex* name_index = env->name_index;
+    for (; name_index->indexed_name_count < name_index->names.size; name_index->indexed_name_count++)
+        index_name(name_index, name_index->indexed_name_count);
+
+    // Among the closest names, the one that was declared first is suggested
+    size_t similar_decl_index = NO_DECL;
+    const Name* names = name_index->names.elems;
+    const Posting* postings = name_index->postings.elems;
+    for (size_t i = 0; i <= name_len; ++i) {
+        const DeletionKey* key = find_deletion_key(name_index,
+            &(DeletionKey) { .str = name, .len = name_len, .deleted_index = i });
+        if (!key)
+            continue;
+        for (size_t j = key->first_posting; j != NO_DECL; j = postings[j].next_posting) {
+            const Name* candidate = &names[postings[j].name_index];
+            size_t dist = bounded_edit_distance(name, name_len, candidate->name, candidate->len, max_dist);
+            if (dist > max_dist)
                 continue;
-            size_t dist = levenshtein_distance(name, symbols[i].name, min_dist);
-            if (dist < min_dist) {
-                min_dist = dist;
-                similar_name = symbols[i].name;
-            }
+            const Symbol* symbol = find_in_hash_table(&env->symbols,
+                &(Symbol) { .name = candidate->name }, candidate->hash, sizeof(Symbol), compare_symbols);
+            if (symbol->decl_index == NO_DECL)
+                continue;
+            if (similar_decl_index != NO_DECL && dist == max_dist && symbol->decl_index > similar_decl_index)
+                continue;
+            similar_decl_index = symbol->decl_index;
+            max_dist = dist;
         }
     }
 
-    if (similar_name)
-        log_note(env->log, NULL, "did you mean '{s}'?", (FormatArg[]) { { .s = similar_name } });
+    if (similar_decl_index != NO_DECL) {
+        log_note(env->log, NULL, "did you mean '{s}'?",
+            (FormatArg[]) { { .s = get_decl(env, similar_decl_index)->name } });
+    }
 }
 
 static AstNode* find_symbol(Env* env, const char* name, const FileLoc* file_loc) {
-    uint32_t hash = hash_str(hash_init(), name);
-    for (Scope* scope = env->cur_scope; scope; scope = scope->prev) {
-        Symbol* symbol = find_in_hash_table(&scope->symbols,
-            &(Symbol) { .name = name },
-            hash, sizeof(Symbol),
-            compare_symbols);
-        if (symbol)
-            return symbol->decl_site;
-    }
+    HashCode hash = hash_str(hash_init(), name);
+    Symbol* symbol = find_in_hash_table(&env->symbols,
+        &(Symbol) { .name = name },
+        hash, sizeof(Symbol),
+        compare_symbols);
+    if (symbol && symbol->decl_index != NO_DECL)
+        return get_decl(env, symbol->decl_index)->decl_site;
     log_error(env->log, file_loc, "unknown identifier '{s}'", (FormatArg[]) { { .s = name } });
     suggest_similar_symbol(env, name);
     return NULL;
@@ -135,9 +268,10 @@ static inline AstNode* find_enclosing_scope(
     AstNodeTag snd_tag,
     const FileLoc* file_loc)
 {
-    for (Scope* scope = env->cur_scope; scope; scope = scope->prev) {
-        if (scope->ast_node->tag == fst_tag || scope->ast_node->tag == snd_tag)
-            return scope->ast_node;
+    const Scope* scopes = env->scopes.elems;
+    for (size_t i = env->scopes.size; i-- > 0 && scopes[i].ast_node;) {
+        if (scopes[i].ast_node->tag == fst_tag || scopes[i].ast_node->tag == snd_tag)
+            return scopes[i].ast_node;
     }
     log_error(env->log, file_loc, "use of '{$}{s}{$}' outside of a {s}", (FormatArg[]) {
         { .style = keyword_style },
@@ -157,19 +291,22 @@ static inline AstNode* find_enclosing_fun(Env* env, const FileLoc* file_loc) {
 }
 
 static inline void push_scope(Env* env, AstNode* ast_node) {
-    if (!env->cur_scope)
-        env->cur_scope = env->first_scope;
-    else if (env->cur_scope->next)
-        env->cur_scope = env->cur_scope->next;
-    else
-        env->cur_scope = new_scope(env->cur_scope);
-    env->cur_scope->ast_node = ast_node;
-    clear_hash_table(&env->cur_scope->symbols);
+    push_on_dyn_array(&env->scopes, &(Scope) { .ast_node = ast_node, .first_decl = env->decls.size });
 }
 
 static inline void pop_scope(Env* env) {
-    assert(env->cur_scope);
-    env->cur_scope = env->cur_scope->prev;
+    assert(env->scopes.size > 1);
+    // Restore the declarations shadowed by the ones of this scope
+    size_t first_decl = get_cur_scope(env)->first_decl;
+    for (size_t i = env->decls.size; i-- > first_decl;) {
+        const Decl* decl = get_decl(env, i);
+        Symbol* symbol = find_in_hash_table(&env->symbols,
+            &(Symbol) { .name = decl->name }, decl->hash, sizeof(Symbol), compare_symbols);
+        assert(symbol && symbol->decl_index == i);
+        symbol->decl_index = decl->shadowed_index;
+    }
+    resize_dyn_array(&env->decls, first_decl);
+    resize_dyn_array(&env->scopes, env->scopes.size - 1);
 }
 
 static inline void bind_many(Env* env, AstNode* elems, void (*bind_one)(Env*, AstNode*)) {
@@ -204,7 +341,7 @@ static void bind_for_loop(Env* env, AstNode* for_loop) {
 }
 
 void bind_stmt(Env* env, AstNode* stmt) {
-    stmt->parent_scope = env->cur_scope->ast_node;
+    stmt->parent_scope = get_cur_scope_node(env);
     switch (stmt->tag) {
         case AST_FUN_DECL:
         case AST_VAR_DECL:
@@ -241,7 +378,7 @@ static void bind_path(Env* env, AstNode* path) {
 
 static void bind_pattern(Env* env, AstNode* pattern, bool is_const) {
     void (*bind_sub_pattern)(Env*, AstNode*) = is_const ? bind_const_pattern : bind_non_const_pattern;
-    pattern->parent_scope = env->cur_scope->ast_node;
+    pattern->parent_scope = get_cur_scope_node(env);
     switch (pattern->tag) {
         case AST_PATH:
             bind_path(env, pattern);
@@ -282,6 +419,39 @@ static void bind_pattern(Env* env, AstNode* pattern, bool is_const) {
     }
 }
 
+// Records the declaration that binds the identifiers of a pattern, so that the declaration of a
+// module-level constant or variable can be found from any of its identifiers.
+static void set_var_decl_of_pattern(AstNode* pattern, AstNode* var_decl) {
+    switch (pattern->tag) {
+        case AST_IDENT_PATTERN:
+            pattern->ident_pattern.var_decl = var_decl;
+            break;
+        case AST_FIELD_PATTERN:
+            set_var_decl_of_pattern(pattern->field_pattern.val, var_decl);
+            break;
+        case AST_STRUCT_PATTERN:
+            for (AstNode* field = pattern->struct_pattern.fields; field; field = field->next)
+                set_var_decl_of_pattern(field, var_decl);
+            break;
+        case AST_CTOR_PATTERN:
+            set_var_decl_of_pattern(pattern->ctor_pattern.arg, var_decl);
+            break;
+        case AST_TUPLE_PATTERN:
+            for (AstNode* arg = pattern->tuple_pattern.args; arg; arg = arg->next)
+                set_var_decl_of_pattern(arg, var_decl);
+            break;
+        case AST_TYPED_PATTERN:
+            set_var_decl_of_pattern(pattern->typed_pattern.left, var_decl);
+            break;
+        case AST_ARRAY_PATTERN:
+            for (AstNode* elem = pattern->array_pattern.elems; elem; elem = elem->next)
+                set_var_decl_of_pattern(elem, var_decl);
+            break;
+        default:
+            break;
+    }
+}
+
 void bind_const_pattern(Env* env, AstNode* pattern) {
     bind_pattern(env, pattern, true);
 }
@@ -311,8 +481,8 @@ static void bind_members(Env* env, AstNode* decl, AstNode* type_params, AstNode*
 }
 
 void bind_decl(Env* env, AstNode* decl) {
-    // Note: The current scope might be NULL upon entering the top-level module.
-    decl->parent_scope = env->cur_scope ? env->cur_scope->ast_node : NULL;
+    // Note: The parent scope is NULL for the top-level module.
+    decl->parent_scope = get_cur_scope_node(env);
     switch (decl->tag) {
         case AST_FIELD_DECL:
             bind_type(env, decl->field_decl.type);
@@ -377,6 +547,7 @@ void bind_decl(Env* env, AstNode* decl) {
             if (decl->var_decl.init)
                 bind_expr(env, decl->var_decl.init);
             bind_pattern(env, decl->var_decl.pattern, decl->tag == AST_CONST_DECL);
+            set_var_decl_of_pattern(decl->var_decl.pattern, decl);
             break;
         case AST_USING_DECL:
             push_scope(env, decl);
@@ -401,7 +572,7 @@ static void bind_match_case(Env* env, AstNode* match_case) {
 }
 
 void bind_expr(Env* env, AstNode* expr) {
-    expr->parent_scope = env->cur_scope->ast_node;
+    expr->parent_scope = get_cur_scope_node(env);
     switch (expr->tag) {
         case AST_PATH:
             bind_path(env, expr);
@@ -492,7 +663,7 @@ void bind_expr(Env* env, AstNode* expr) {
 }
 
 void bind_kind(Env* env, AstNode* kind) {
-    kind->parent_scope = env->cur_scope->ast_node;
+    kind->parent_scope = get_cur_scope_node(env);
     switch (kind->tag) {
         case AST_KIND_STAR:
             break;
@@ -511,7 +682,7 @@ static void bind_where_clause(Env* env, AstNode* where_clause) {
 }
 
 void bind_type(Env* env, AstNode* type) {
-    type->parent_scope = env->cur_scope->ast_node;
+    type->parent_scope = get_cur_scope_node(env);
     switch (type->tag) {
         case AST_NORET_TYPE:
 #define f(name, ...) case AST_TYPE_##name:
@@ -551,5 +722,46 @@ void bind_type(Env* env, AstNode* type) {
 }
 
 void bind_program(Env* env, AstNode* program) {
+    assert(env->scopes.size == 1);
     bind_decl(env, program);
 }
+
+static void export_pattern(Env* env, AstNode* pattern) {
+    switch (pattern->tag) {
+        case AST_IDENT_PATTERN:
+            insert_symbol(env, pattern->ident_pattern.name, pattern);
+            break;
+        case AST_FIELD_PATTERN:
+            export_pattern(env, pattern->field_pattern.val);
+            break;
+        case AST_STRUCT_PATTERN:
+            bind_many(env, pattern->struct_pattern.fields, export_pattern);
+            break;
+        case AST_CTOR_PATTERN:
+            export_pattern(env, pattern->ctor_pattern.arg);
+            break;
+        case AST_TUPLE_PATTERN:
+            bind_many(env, pattern->tuple_pattern.args, export_pattern);
+            break;
+        case AST_TYPED_PATTERN:
+            export_pattern(env, pattern->typed_pattern.left);
+            break;
+        case AST_ARRAY_PATTERN:
+            bind_many(env, pattern->array_pattern.elems, export_pattern);
+            break;
+        default:
+            break;
+    }
+}
+
+void export_program(Env* env, AstNode* program) {
+    assert(env->scopes.size == 1);
+    for (AstNode* decl = program->mod_decl.members; decl; decl = decl->next) {
+        if (!is_public_decl(decl))
+            continue;
+        if (decl->tag == AST_CONST_DECL || decl->tag == AST_VAR_DECL)
+            export_pattern(env, decl->var_decl.pattern);
+        else
+            insert_decl_in_env(env, decl);
+    }
+}
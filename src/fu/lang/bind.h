@@ -1,21 +1,32 @@
 #ifndef FU_LANG_BIND_H
 #define FU_LANG_BIND_H
 
+#include "fu/core/hash_table.h"
+#include "fu/core/dyn_array.h"
+
 /*
  * The name binding algorithm requires an environment to be able to register symbols and find
  * out the declaration sites of identifiers.
- * The environment is just a linked list of scopes, each containing a hash table that maps all
- * of the symbols declared in the scope to their actual AST node.
+ * The environment contains a single hash table that maps every visible name to its innermost
+ * declaration, which is found with one lookup regardless of the nesting depth. Declarations are
+ * recorded on a stack, along with the declaration that they shadow, so that leaving a scope just
+ * unwinds that stack down to the position it had when the scope was entered. The first scope is
+ * the global scope, which contains the public declarations of the programs that have been
+ * exported, and which is visible from the programs that are bound afterwards.
+ * Declared names are also recorded in an index, so that the names that are similar to an unknown
+ * identifier can be found without looking at every name.
  */
 
 typedef struct AstNode AstNode;
-typedef struct Scope Scope;
 typedef struct Log Log;
+typedef struct NameIndex NameIndex;
 
 typedef struct {
     Log* log;
-    Scope* first_scope;
-    Scope* cur_scope;
+    HashTable symbols;
+    DynArray decls;
+    DynArray scopes;
+    NameIndex* name_index;
 } Env;
 
 Env new_env(Log*);
@@ -29,5 +40,6 @@ void bind_expr(Env*, AstNode*);
 void bind_kind(Env*, AstNode*);
 void bind_type(Env*, AstNode*);
 void bind_program(Env*, AstNode*);
+void export_program(Env*, AstNode*);
 
 #endif
@@ -1,10 +1,11 @@
 #include "fu/lang/check.h"
 #include "fu/lang/type_table.h"
 #include "fu/core/alloc.h"
-#include "fu/core/hash.h"
 #include "fu/core/mem_pool.h"
 #include "fu/core/dyn_array.h"
 #include "fu/core/utils.h"
+#include "fu/core/trace.h"
+#include "fu/core/thread_pool.h"
 
 #include <assert.h>
 #include <stdlib.h>
@@ -15,35 +16,41 @@
 
 struct SignatureVars { DynArray vars; };
 
+// A function body whose checking is deferred to the second phase. The messages of the second
+// phase for this body go to the first log, and the messages of the first phase that come after
+// the point where the body was deferred go to the second one.
+typedef struct {
+    AstNode* fun_decl;
+    FormatState state, next_state;
+    Log log, next_log;
+} DeferredBody;
+
 TypingContext new_typing_context(TypeTable* type_table, MemPool* mem_pool, Log* log) {
     return (TypingContext) {
         .log = log,
         .type_table = type_table,
         .mem_pool = mem_pool,
-        .visited_decls = new_hash_table(sizeof(AstNode*))
+        .visited_decls = new_bit_set(),
+        .type_maps = new_type_map_pool(),
+        .scratch_pool = new_mem_pool()
     };
 }
 
 void free_typing_context(TypingContext* context) {
-    free_hash_table(&context->visited_decls);
-}
-
-static bool compare_decls(const void* left, const void* right) {
-    return !memcmp(left, right, sizeof(AstNode*));
+    free_bit_set(&context->visited_decls);
+    free_type_map_pool(&context->type_maps);
+    free_mem_pool(&context->scratch_pool);
 }
 
 static bool push_decl(TypingContext* context, AstNode* decl) {
     // Push a declaration in the context, so that recursion can
     // be stopped when we encounter it again.
-    return insert_in_hash_table(&context->visited_decls,
-        &decl, hash_ptr(hash_init(), decl), sizeof(AstNode*), compare_decls);
+    return insert_in_bit_set(&context->visited_decls, decl->id);
 }
 
 static void pop_decl(TypingContext* context, AstNode* decl) {
-    const AstNode** ptr = find_in_hash_table(&context->visited_decls,
-        &decl, hash_ptr(hash_init(), decl), sizeof(AstNode*), compare_decls);
-    assert(ptr && "trying to pop an unvisited declaration");
-    remove_from_hash_table(&context->visited_decls, ptr, sizeof(AstNode*));
+    assert(is_in_bit_set(&context->visited_decls, decl->id) && "trying to pop an unvisited declaration");
+    remove_from_bit_set(&context->visited_decls, decl->id);
 }
 
 static bool should_add_to_parent_sig_or_mod(const AstNode* ast_node) {
@@ -244,16 +251,45 @@ static const Type* report_redeclared_inherited_member(
     return make_error_type(context->type_table);
 }
 
-static const Type* infer_decl_site(TypingContext* context, AstNode* decl_site) {
+bool is_module_level_decl(const AstNode* decl) {
+    for (const AstNode* scope = decl->parent_scope; scope; scope = scope->parent_scope) {
+        if (scope->tag != AST_MOD_DECL)
+            return false;
+    }
+    return decl->parent_scope;
+}
+
+static inline bool is_top_level_decl(const AstNode* decl) {
+    return decl->parent_scope && !decl->parent_scope->parent_scope;
+}
+
+static AstNode* get_decl_of_site(AstNode* decl_site) {
+    // Module-level constants and variables are bound to the identifiers of their pattern
+    if (decl_site->tag == AST_IDENT_PATTERN && decl_site->ident_pattern.var_decl && is_module_level_decl(decl_site))
+        return decl_site->ident_pattern.var_decl;
+    return decl_site;
+}
+
+const Type* infer_decl_site(TypingContext* context, AstNode* decl_site) {
+    // Only top-level declarations are reported: The members of a module are part of it
+    DeclObserver* observer = context->decl_observer && is_top_level_decl(decl_site)
+        ? context->decl_observer : NULL;
+    AstNode* decl = observer || !decl_site->type ? get_decl_of_site(decl_site) : decl_site;
+    if (observer)
+        observer->read_decl(observer, decl);
     if (!decl_site->type) {
-        if (!push_decl(context, decl_site)) {
-            log_error(context->log, &decl_site->file_loc, "cannot infer type for recursive declaration", NULL);
-            if (decl_site->tag == AST_FUN_DECL)
+        if (!push_decl(context, decl)) {
+            log_error(context->log, &decl->file_loc, "cannot infer type for recursive declaration", NULL);
+            if (decl->tag == AST_FUN_DECL)
                 log_note(context->log, NULL, "adding a return type annotation may fix the problem", NULL);
             return decl_site->type = make_error_type(context->type_table);
         }
-        infer_decl(context, decl_site);
-        pop_decl(context, decl_site);
+        if (observer)
+            observer->begin_decl(observer, decl);
+        infer_decl(context, decl);
+        if (observer)
+            observer->end_decl(observer, decl);
+        pop_decl(context, decl);
     }
     return decl_site->type;
 }
@@ -314,7 +350,7 @@ static const Type* infer_type_args(
     }
 
     // Replace type parameters with unknown types and infer the argument to the function call.
-    TypeMap type_map = new_type_map();
+    TypeMap type_map = acquire_type_map(&context->type_maps);
     for (size_t i = 0; i < fun_type->fun.type_param_count; ++i)
         insert_in_type_map(&type_map, fun_type->fun.type_params[i], (void*)type_args[i]);
     const Type* arg_type = check_expr(context, call_arg,
@@ -322,7 +358,9 @@ static const Type* infer_type_args(
     clear_type_map(&type_map);
 
     // Get the type bounds for each type parameter of the function type
-    TypeBounds* type_bounds = malloc_or_die(sizeof(TypeBounds) * fun_type->fun.type_param_count);
+    MemPoolState scratch_state = save_mem_pool(&context->scratch_pool);
+    TypeBounds* type_bounds = alloc_from_mem_pool(&context->scratch_pool,
+        sizeof(TypeBounds) * fun_type->fun.type_param_count);
     for (size_t i = 0; i < fun_type->fun.type_param_count; ++i) {
         bool is_known = type_args[i]->tag != TYPE_UNKNOWN;
         type_bounds[i] = (TypeBounds) {
@@ -342,8 +380,8 @@ static const Type* infer_type_args(
             replace_types_with_map(context->type_table, fun_type->fun.codom, &type_map));
     }
 
-    free_type_map(&type_map);
-    free(type_bounds);
+    release_type_map(&context->type_maps, &type_map);
+    restore_mem_pool(&context->scratch_pool, scratch_state);
     return result_type;
 }
 
@@ -394,20 +432,20 @@ static const Type* check_type_args(
     // Create type arguments for the call by inferring them and padding whatever remains with
     // unknown types, so that the type inference algorithm can infer partially-specified polymorphic
     // function applications.
-    DynArray args = new_dyn_array(sizeof(Type*));
-    for (AstNode* type_arg = type_args; type_arg; type_arg = type_arg->next) {
-        const Type* arg = infer_type(context, type_arg);
-        expect_type(context, arg->kind, type_params[args.size]->kind, true, &type_arg->file_loc);
-        push_on_dyn_array(&args, &arg);
+    MemPoolState scratch_state = save_mem_pool(&context->scratch_pool);
+    const Type** args = alloc_from_mem_pool(&context->scratch_pool, sizeof(Type*) * type_param_count);
+    size_t arg_count = 0;
+    for (AstNode* type_arg = type_args; type_arg; type_arg = type_arg->next, arg_count++) {
+        args[arg_count] = infer_type(context, type_arg);
+        expect_type(context, args[arg_count]->kind, type_params[arg_count]->kind, true, &type_arg->file_loc);
     }
-    const Type* unknown_type = make_unknown_type(context->type_table);
-    for (size_t i = args.size; i < type_param_count; ++i)
-        push_on_dyn_array(&args, &unknown_type);
+    for (; arg_count < type_param_count; ++arg_count)
+        args[arg_count] = make_unknown_type(context->type_table);
 
     const Type* applied_type = type->tag == TYPE_FUN
-        ? infer_type_args(context, type, args.elems, call_arg, file_loc)
-        : make_app_type(context->type_table, type, args.elems, type_param_count);
-    free_dyn_array(&args);
+        ? infer_type_args(context, type, args, call_arg, file_loc)
+        : make_app_type(context->type_table, type, args, type_param_count);
+    restore_mem_pool(&context->scratch_pool, scratch_state);
     return applied_type;
 }
 
@@ -422,7 +460,7 @@ static const Type* infer_next_path_elem(TypingContext* context, AstNode* prev_el
     AstNode* next_elem = prev_elem->next;
     const Type* applied_type = get_applied_type(prev_elem->type);
     if (applied_type->tag == TYPE_STRUCT) {
-        const StructField* field = find_struct_field(applied_type, next_elem->path_elem.name);
+        const StructField* field = lookup_struct_field(context->type_table, applied_type, next_elem->path_elem.name);
         if (!field)
             goto missing_member;
 
@@ -431,7 +469,7 @@ static const Type* infer_next_path_elem(TypingContext* context, AstNode* prev_el
         next_elem->type = get_struct_field_type(
             context->type_table, prev_elem->type, next_elem->path_elem.index);
     } else if (applied_type->tag == TYPE_ENUM) {
-        const EnumOption* option = find_enum_option(applied_type, next_elem->path_elem.name);
+        const EnumOption* option = lookup_enum_option(context->type_table, applied_type, next_elem->path_elem.name);
         if (!option)
             goto missing_member;
 
@@ -445,7 +483,7 @@ static const Type* infer_next_path_elem(TypingContext* context, AstNode* prev_el
         is_type_expected = true;
     } else if (prev_elem->type->kind->tag == TYPE_SIGNATURE) {
         const Type* signature = prev_elem->type->kind;
-        const Type** var = find_signature_var(signature, next_elem->path_elem.name);
+        const Type** var = lookup_signature_var(context->type_table, signature, next_elem->path_elem.name);
         if (!var)
             goto missing_member;
 
@@ -481,18 +519,21 @@ missing_member:
         context, next_elem->path_elem.name, prev_elem->type, &next_elem->file_loc);
 }
 
-static const Type* make_tuple_like_struct_ctor(TypeTable* type_table, const Type* type) {
+static const Type* make_tuple_like_struct_ctor(TypingContext* context, const Type* type) {
+    TypeTable* type_table = context->type_table;
     const Type* struct_type = get_applied_type(type);
     assert(is_tuple_like_struct_type(struct_type));
 
     // Using the tuple-like name as a value results produces a constructor that
     // types as a function (only for tuple-like structures with parameters).
     if (struct_type->struct_.field_count > 0) {
-        const Type** arg_types = malloc_or_die(sizeof(Type*) * struct_type->struct_.field_count);
+        MemPoolState scratch_state = save_mem_pool(&context->scratch_pool);
+        const Type** arg_types = alloc_from_mem_pool(&context->scratch_pool,
+            sizeof(Type*) * struct_type->struct_.field_count);
         for (size_t i = 0, n = struct_type->struct_.field_count; i < n; ++i)
             arg_types[i] = get_struct_field_type(type_table, type, i);
         const Type* param_type = make_tuple_type(type_table, arg_types, struct_type->struct_.field_count);
-        free(arg_types);
+        restore_mem_pool(&context->scratch_pool, scratch_state);
         return make_fun_type(type_table, param_type, type);
     }
     return type;
@@ -509,7 +550,7 @@ static const Type* infer_path_elems(TypingContext* context, AstNode* path_elem,
     if (!is_type_expected && path_elem->path_elem.is_type &&
         is_tuple_like_struct_type(get_applied_type(path_elem->type)))
     {
-        path_elem->type = make_tuple_like_struct_ctor(context->type_table, path_elem->type);
+        path_elem->type = make_tuple_like_struct_ctor(context, path_elem->type);
         path_elem->path_elem.is_type = false;
     }
 
@@ -557,11 +598,12 @@ static const Type* infer_tuple(
     const Type* (*infer_arg)(TypingContext*, AstNode*))
 {
     size_t i = 0, arg_count = count_ast_nodes(tuple->tuple_expr.args);
-    const Type** arg_types = malloc_or_die(sizeof(Type*) * arg_count);
+    MemPoolState scratch_state = save_mem_pool(&context->scratch_pool);
+    const Type** arg_types = alloc_from_mem_pool(&context->scratch_pool, sizeof(Type*) * arg_count);
     for (AstNode* arg = tuple->tuple_expr.args; arg; arg = arg->next, i++)
         arg_types[i] = infer_arg(context, arg);
     tuple->type = make_tuple_type(context->type_table, arg_types, arg_count);
-    free(arg_types);
+    restore_mem_pool(&context->scratch_pool, scratch_state);
     return tuple->type;
 }
 
@@ -581,11 +623,12 @@ static const Type* check_tuple(
         return make_error_type(context->type_table);
     }
 
-    const Type** arg_types = malloc_or_die(sizeof(Type*) * arg_count);
+    MemPoolState scratch_state = save_mem_pool(&context->scratch_pool);
+    const Type** arg_types = alloc_from_mem_pool(&context->scratch_pool, sizeof(Type*) * arg_count);
     for (AstNode* arg = tuple->tuple_expr.args; arg; arg = arg->next, i++)
         arg_types[i] = check_arg(context, arg, expected_type->tuple.args[i]);
     tuple->type = make_tuple_type(context->type_table, arg_types, arg_count);
-    free(arg_types);
+    restore_mem_pool(&context->scratch_pool, scratch_state);
     return tuple->type;
 }
 
@@ -595,12 +638,13 @@ const Type* infer_kind(TypingContext* context, AstNode* kind) {
             return make_star_kind(context->type_table);
         case AST_KIND_ARROW: {
             size_t i = 0, kind_param_count = count_ast_nodes(kind->arrow_kind.dom_kinds);
-            const Type** kind_params = malloc_or_die(sizeof(Type*) * kind_param_count);
+            MemPoolState scratch_state = save_mem_pool(&context->scratch_pool);
+            const Type** kind_params = alloc_from_mem_pool(&context->scratch_pool, sizeof(Type*) * kind_param_count);
             for (AstNode* dom_kind = kind->arrow_kind.dom_kinds; dom_kind; dom_kind = dom_kind->next, i++)
                 kind_params[i] = infer_kind(context, dom_kind);
             const Type* body = infer_kind(context, kind->arrow_kind.codom_kind);
             const Type* arrow = make_arrow_kind(context->type_table, kind_params, kind_param_count, body);
-            free(kind_params);
+            restore_mem_pool(&context->scratch_pool, scratch_state);
             return arrow;
         }
         default:
@@ -609,7 +653,7 @@ const Type* infer_kind(TypingContext* context, AstNode* kind) {
 }
 
 static const Type* check_where_clause(TypingContext* context, AstNode* where_clause, const Type* signature) {
-    const Type** var_ptr = find_signature_var(signature, where_clause->where_clause.name);
+    const Type** var_ptr = lookup_signature_var(context->type_table, signature, where_clause->where_clause.name);
     if (!var_ptr) {
         report_missing_member(context,
             where_clause->where_clause.name, signature, &where_clause->file_loc);
@@ -646,19 +690,23 @@ static const Type* infer_type_param(TypingContext* context, AstNode* type_param)
         context->type_table, type_param->type_param.name, kind);
 }
 
+static const Type** alloc_type_params(TypingContext* context, AstNode* type_params, size_t* type_param_count) {
+    *type_param_count = count_ast_nodes(type_params);
+    return alloc_from_mem_pool(&context->scratch_pool, sizeof(Type*) * *type_param_count);
+}
+
 static const Kind* infer_type_params(
     TypingContext* context,
     AstNode* type_params,
-    DynArray* type_vars,
+    const Type** type_vars,
     const Kind* body)
 {
-    for (; type_params; type_params = type_params->next) {
-        infer_type_param(context, type_params);
-        push_on_dyn_array(type_vars, &type_params->type);
-    }
+    size_t type_var_count = 0;
+    for (; type_params; type_params = type_params->next)
+        type_vars[type_var_count++] = infer_type_param(context, type_params);
     if (!body)
         return NULL;
-    return make_type_ctor_kind(context->type_table, type_vars->elems, type_vars->size, body);
+    return make_type_ctor_kind(context->type_table, type_vars, type_var_count, body);
 }
 
 static const Type* infer_type_with_noret(TypingContext* context, AstNode* type, bool accept_noret) {
@@ -675,14 +723,16 @@ static const Type* infer_type_with_noret(TypingContext* context, AstNode* type,
         case AST_TUPLE_TYPE:
             return infer_tuple(context, type, infer_type);
         case AST_FUN_TYPE: {
-            DynArray type_params = new_dyn_array(sizeof(Type*));
-            infer_type_params(context, type->fun_type.type_params, &type_params, NULL);
+            size_t type_param_count;
+            MemPoolState scratch_state = save_mem_pool(&context->scratch_pool);
+            const Type** type_params = alloc_type_params(context, type->fun_type.type_params, &type_param_count);
+            infer_type_params(context, type->fun_type.type_params, type_params, NULL);
             type->type = make_poly_fun_type(context->type_table,
-                type_params.elems,
-                type_params.size,
+                type_params,
+                type_param_count,
                 infer_type(context, type->fun_type.dom_type),
                 infer_type_with_noret(context, type->fun_type.codom_type, true));
-            free_dyn_array(&type_params);
+            restore_mem_pool(&context->scratch_pool, scratch_state);
             return type->type;
         }
         case AST_ARRAY_TYPE:
@@ -812,9 +862,11 @@ static const Type* check_struct_expr(TypingContext* context, AstNode* struct_exp
     if (!expect_type_with_tag(context, struct_type, TYPE_STRUCT, "structure", &struct_expr->file_loc))
         return struct_expr->type = make_error_type(context->type_table);
 
-    bool* seen = calloc_or_die(struct_type->struct_.field_count, sizeof(bool));
+    MemPoolState scratch_state = save_mem_pool(&context->scratch_pool);
+    bool* seen = alloc_from_mem_pool(&context->scratch_pool, sizeof(bool) * struct_type->struct_.field_count);
+    memset(seen, 0, sizeof(bool) * struct_type->struct_.field_count);
     for (AstNode* field_expr = struct_expr->struct_expr.fields; field_expr; field_expr = field_expr->next) {
-        const StructField* field = find_struct_field(struct_type, field_expr->field_expr.name);
+        const StructField* field = lookup_struct_field(context->type_table, struct_type, field_expr->field_expr.name);
         if (!field) {
             report_missing_member(context, field_expr->field_expr.name, struct_type, &field_expr->file_loc);
             goto fail;
@@ -864,7 +916,7 @@ static const Type* check_struct_expr(TypingContext* context, AstNode* struct_exp
 fail:
     struct_expr->type = make_error_type(context->type_table);
 cleanup:
-    free(seen);
+    restore_mem_pool(&context->scratch_pool, scratch_state);
     return struct_expr->type;
 }
 
@@ -1069,7 +1121,8 @@ static const Type* check_pattern_and_expr(
         {
             AstNode* expr_arg = expr->tuple_expr.args;
             AstNode* pattern_arg = pattern->tuple_pattern.args;
-            const Type** arg_types = malloc_or_die(sizeof(Type*) * arg_count);
+            MemPoolState scratch_state = save_mem_pool(&context->scratch_pool);
+            const Type** arg_types = alloc_from_mem_pool(&context->scratch_pool, sizeof(Type*) * arg_count);
             for (size_t i = 0; i < arg_count;
                 ++i, expr_arg = expr_arg->next, pattern_arg = pattern_arg->next)
             {
@@ -1079,7 +1132,7 @@ static const Type* check_pattern_and_expr(
                 arg_types[i] = check_pattern_and_expr(context, pattern_arg, expr_arg, arg_type);
             }
             const Type* result = make_tuple_type(context->type_table, arg_types, arg_count);
-            free(arg_types);
+            restore_mem_pool(&context->scratch_pool, scratch_state);
             return result;
         }
     } else if (pattern->tag == AST_TYPED_PATTERN)
@@ -1111,19 +1164,19 @@ static StructField infer_field_decl(TypingContext* context, AstNode* field_decl)
 
 static const Type* infer_struct_decl(TypingContext* context, AstNode* struct_decl) {
     Type* struct_type = make_struct_type(context->type_table, struct_decl->struct_decl.name);
-    DynArray type_params = new_dyn_array(sizeof(Type*));
-    DynArray struct_fields = new_dyn_array(sizeof(StructField));
+    MemPoolState scratch_state = save_mem_pool(&context->scratch_pool);
 
     struct_type->struct_.is_tuple_like = struct_decl->struct_decl.is_tuple_like;
 
+    struct_type->struct_.type_params = alloc_type_params(context,
+        struct_decl->struct_decl.type_params, &struct_type->struct_.type_param_count);
     struct_type->kind = infer_type_params(context,
-        struct_decl->struct_decl.type_params, &type_params, make_star_kind(context->type_table));
-
-    struct_type->struct_.type_params = type_params.elems;
-    struct_type->struct_.type_param_count = type_params.size;
+        struct_decl->struct_decl.type_params, struct_type->struct_.type_params, make_star_kind(context->type_table));
 
     // Add inherited fields to the structure
     const Type* super_struct = NULL;
+    StructField* struct_fields = NULL;
+    size_t field_count = 0;
     if (struct_decl->struct_decl.super_type) {
         const Type* super_type = infer_type(context, struct_decl->struct_decl.super_type);
         super_struct = get_applied_type(super_type);
@@ -1131,16 +1184,22 @@ static const Type* infer_struct_decl(TypingContext* context, AstNode* struct_dec
             context, super_struct, TYPE_STRUCT, "structure", &struct_decl->struct_decl.super_type->file_loc))
         {
             struct_type->struct_.super_type = super_type;
+            struct_fields = alloc_from_mem_pool(&context->scratch_pool, sizeof(StructField) *
+                (super_struct->struct_.field_count + count_ast_nodes(struct_decl->struct_decl.fields)));
             for (size_t i = 0; i < super_struct->struct_.field_count; ++i) {
-                StructField field = super_struct->struct_.fields[i];
-                field.type = get_struct_field_type(context->type_table, super_type, i);
-                field.is_inherited = true;
-                push_on_dyn_array(&struct_fields, &field);
+                StructField* field = &struct_fields[field_count++];
+                *field = super_struct->struct_.fields[i];
+                field->type = get_struct_field_type(context->type_table, super_type, i);
+                field->is_inherited = true;
             }
         }
         else
             super_struct = NULL;
     }
+    if (!super_struct) {
+        struct_fields = alloc_from_mem_pool(&context->scratch_pool,
+            sizeof(StructField) * count_ast_nodes(struct_decl->struct_decl.fields));
+    }
 
     struct_decl->type = should_add_to_parent_sig_or_mod(struct_decl)
         ? add_decl_to_parent_sig_or_mod(context->type_table, struct_decl, struct_type)
@@ -1148,26 +1207,23 @@ static const Type* infer_struct_decl(TypingContext* context, AstNode* struct_dec
 
     for (AstNode* field_decl = struct_decl->struct_decl.fields; field_decl; field_decl = field_decl->next) {
         if (struct_decl->struct_decl.is_tuple_like) {
-            push_on_dyn_array(&struct_fields, &(StructField) {
+            struct_fields[field_count++] = (StructField) {
                 .name = "",
                 .type = infer_type(context, field_decl)
-            });
-        } else if (super_struct && find_struct_field(super_struct, field_decl->field_decl.name)) {
+            };
+        } else if (super_struct && lookup_struct_field(context->type_table, super_struct, field_decl->field_decl.name)) {
             report_redeclared_inherited_member(context,
                 field_decl->field_decl.name,
                 struct_type->struct_.super_type,
                 &field_decl->file_loc);
-        } else {
-            StructField field = infer_field_decl(context, field_decl);
-            push_on_dyn_array(&struct_fields, &field);
-        }
+        } else
+            struct_fields[field_count++] = infer_field_decl(context, field_decl);
     }
 
-    struct_type->struct_.fields = struct_fields.elems;
-    struct_type->struct_.field_count = struct_fields.size;
+    struct_type->struct_.fields = struct_fields;
+    struct_type->struct_.field_count = field_count;
     seal_struct_type(context->type_table, struct_type);
-    free_dyn_array(&struct_fields);
-    free_dyn_array(&type_params);
+    restore_mem_pool(&context->scratch_pool, scratch_state);
     return struct_decl->type;
 }
 
@@ -1189,17 +1245,18 @@ static const Type* infer_option_decl(
         enum_type->enum_.type_param_count,
         make_star_kind(context->type_table));
 
-    DynArray struct_fields = new_dyn_array(sizeof(StructField));
-    for (AstNode* field_decl = option_decl->option_decl.param_type; field_decl; field_decl = field_decl->next) {
-        StructField field = infer_field_decl(context, field_decl);
-        push_on_dyn_array(&struct_fields, &field);
-    }
+    MemPoolState scratch_state = save_mem_pool(&context->scratch_pool);
+    size_t field_count = 0;
+    StructField* struct_fields = alloc_from_mem_pool(&context->scratch_pool,
+        sizeof(StructField) * count_ast_nodes(option_decl->option_decl.param_type));
+    for (AstNode* field_decl = option_decl->option_decl.param_type; field_decl; field_decl = field_decl->next)
+        struct_fields[field_count++] = infer_field_decl(context, field_decl);
     struct_type->struct_.type_params = enum_type->enum_.type_params;
     struct_type->struct_.type_param_count = enum_type->enum_.type_param_count;
-    struct_type->struct_.fields = struct_fields.elems;
-    struct_type->struct_.field_count = struct_fields.size;
+    struct_type->struct_.fields = struct_fields;
+    struct_type->struct_.field_count = field_count;
     const Type* option_type = seal_struct_type(context->type_table, struct_type);
-    free_dyn_array(&struct_fields);
+    restore_mem_pool(&context->scratch_pool, scratch_state);
 
     // We may need to wrap the structure type into a type application if the enumeration is polymorphic
     option_type = make_app_type(context->type_table, option_type,
@@ -1210,17 +1267,17 @@ static const Type* infer_option_decl(
 
 static const Type* infer_enum_decl(TypingContext* context, AstNode* enum_decl) {
     Type* enum_type = make_enum_type(context->type_table, enum_decl->enum_decl.name);
-    DynArray type_params = new_dyn_array(sizeof(Type*));
-    DynArray enum_options = new_dyn_array(sizeof(EnumOption));
+    MemPoolState scratch_state = save_mem_pool(&context->scratch_pool);
 
+    enum_type->enum_.type_params = alloc_type_params(context,
+        enum_decl->enum_decl.type_params, &enum_type->enum_.type_param_count);
     enum_type->kind = infer_type_params(context,
-        enum_decl->enum_decl.type_params, &type_params, make_star_kind(context->type_table));
-
-    enum_type->enum_.type_params = type_params.elems;
-    enum_type->enum_.type_param_count = type_params.size;
+        enum_decl->enum_decl.type_params, enum_type->enum_.type_params, make_star_kind(context->type_table));
 
     // Add inherited options to the enumeration
     const Type* sub_enum = NULL;
+    EnumOption* enum_options = NULL;
+    size_t option_count = 0;
     if (enum_decl->enum_decl.sub_type) {
         const Type* sub_type = infer_type(context, enum_decl->enum_decl.sub_type);
         sub_enum = get_applied_type(sub_type);
@@ -1228,47 +1285,54 @@ static const Type* infer_enum_decl(TypingContext* context, AstNode* enum_decl) {
             context, sub_enum, TYPE_ENUM, "enumeration", &enum_decl->enum_decl.sub_type->file_loc))
         {
             enum_type->enum_.sub_type = sub_type;
+            enum_options = alloc_from_mem_pool(&context->scratch_pool, sizeof(EnumOption) *
+                (sub_enum->enum_.option_count + count_ast_nodes(enum_decl->enum_decl.options)));
             for (size_t i = 0; i < sub_enum->enum_.option_count; ++i) {
-                EnumOption option = sub_enum->enum_.options[i];
-                option.param_type = get_enum_option_param_type(context->type_table, sub_type, i);
-                option.is_inherited = true;
-                push_on_dyn_array(&enum_options, &option);
+                EnumOption* option = &enum_options[option_count++];
+                *option = sub_enum->enum_.options[i];
+                option->param_type = get_enum_option_param_type(context->type_table, sub_type, i);
+                option->is_inherited = true;
             }
         }
         else
             sub_enum = NULL;
     }
+    if (!sub_enum) {
+        enum_options = alloc_from_mem_pool(&context->scratch_pool,
+            sizeof(EnumOption) * count_ast_nodes(enum_decl->enum_decl.options));
+    }
 
     enum_decl->type = should_add_to_parent_sig_or_mod(enum_decl)
         ? add_decl_to_parent_sig_or_mod(context->type_table, enum_decl, enum_type)
         : enum_type;
 
     for (AstNode* option_decl = enum_decl->enum_decl.options; option_decl; option_decl = option_decl->next) {
-        if (sub_enum && find_enum_option(sub_enum, option_decl->option_decl.name)) {
+        if (sub_enum && lookup_enum_option(context->type_table, sub_enum, option_decl->option_decl.name)) {
             report_redeclared_inherited_member(context,
                 option_decl->option_decl.name,
                 enum_type->enum_.sub_type,
                 &option_decl->file_loc);
         } else {
-            push_on_dyn_array(&enum_options, &(EnumOption) {
+            enum_options[option_count++] = (EnumOption) {
                 .name = option_decl->option_decl.name,
                 .param_type = infer_option_decl(context, option_decl, enum_type)
-            });
+            };
         }
     }
 
-    enum_type->enum_.options = enum_options.elems;
-    enum_type->enum_.option_count = enum_options.size;
+    enum_type->enum_.options = enum_options;
+    enum_type->enum_.option_count = option_count;
     seal_enum_type(context->type_table, enum_type);
-    free_dyn_array(&enum_options);
-    free_dyn_array(&type_params);
+    restore_mem_pool(&context->scratch_pool, scratch_state);
     return enum_decl->type;
 }
 
 static const Type* infer_type_decl(TypingContext* context, AstNode* type_decl) {
-    DynArray type_params = new_dyn_array(sizeof(Type*));
+    size_t type_param_count;
+    MemPoolState scratch_state = save_mem_pool(&context->scratch_pool);
+    const Type** type_params = alloc_type_params(context, type_decl->type_decl.type_params, &type_param_count);
     const Kind* type_kind = infer_type_params(context,
-        type_decl->type_decl.type_params, &type_params, make_star_kind(context->type_table));
+        type_decl->type_decl.type_params, type_params, make_star_kind(context->type_table));
 
     if (!type_decl->type_decl.aliased_type) {
         // Types without an actual binding should not exist outside of signatures.
@@ -1280,47 +1344,65 @@ static const Type* infer_type_decl(TypingContext* context, AstNode* type_decl) {
         const Type* alias_type = make_alias_type(
             context->type_table,
             type_decl->type_decl.name,
-            type_params.elems,
-            type_params.size,
+            type_params,
+            type_param_count,
             aliased_type);
 
         type_decl->type = should_add_to_parent_sig_or_mod(type_decl)
             ? add_decl_to_parent_sig_or_mod(context->type_table, type_decl, alias_type)
             : alias_type;
     }
-    free_dyn_array(&type_params);
+    restore_mem_pool(&context->scratch_pool, scratch_state);
     return type_decl->type;
 }
 
+static void init_buffered_log(Log* log, FormatState* state, const Log* parent_log) {
+    *state = new_format_state(parent_log->state->tab, parent_log->state->ignore_style);
+    *log = new_buffered_log(state, parent_log);
+}
+
+static void defer_fun_body(TypingContext* context, AstNode* fun_decl) {
+    DeferredBody* body = malloc_or_die(sizeof(DeferredBody));
+    body->fun_decl = fun_decl;
+    init_buffered_log(&body->log, &body->state, context->log);
+    init_buffered_log(&body->next_log, &body->next_state, context->log);
+    push_on_dyn_array(context->deferred_bodies, &body);
+    context->log = &body->next_log;
+}
+
 static const Type* infer_fun_decl(TypingContext* context, AstNode* fun_decl) {
-    DynArray type_params = new_dyn_array(sizeof(Type*));
-    infer_type_params(context, fun_decl->fun_decl.type_params, &type_params, NULL);
+    size_t type_param_count;
+    MemPoolState scratch_state = save_mem_pool(&context->scratch_pool);
+    const Type** type_params = alloc_type_params(context, fun_decl->fun_decl.type_params, &type_param_count);
+    infer_type_params(context, fun_decl->fun_decl.type_params, type_params, NULL);
     const Type* dom_type = infer_pattern(context, fun_decl->fun_decl.param);
     if (fun_decl->fun_decl.ret_type) {
         const Type* codom_type = infer_type(context, fun_decl->fun_decl.ret_type);
         // Set the function type before checking the body in case
         // the function is recursive (or uses `return`).
         fun_decl->type = make_poly_fun_type(context->type_table,
-            type_params.elems, type_params.size, dom_type, codom_type);
-        if (fun_decl->fun_decl.body)
-            check_expr(context, fun_decl->fun_decl.body, codom_type);
+            type_params, type_param_count, dom_type, codom_type);
+        if (fun_decl->fun_decl.body) {
+            bool is_module_level = is_module_level_decl(fun_decl);
+            if (context->deferred_bodies && is_module_level)
+                defer_fun_body(context, fun_decl);
+            else if (!context->skip_fun_bodies || !is_module_level)
+                check_expr(context, fun_decl->fun_decl.body, codom_type);
+        }
     } else if (fun_decl->fun_decl.body) {
         const Type* codom_type = infer_expr(context, fun_decl->fun_decl.body);
         fun_decl->type = make_poly_fun_type(context->type_table,
-            type_params.elems, type_params.size, dom_type, codom_type);
+            type_params, type_param_count, dom_type, codom_type);
     } else
-        report_cannot_infer(context, "function declaration", &fun_decl->file_loc);
+        fun_decl->type = report_cannot_infer(context, "function declaration", &fun_decl->file_loc);
 
     // Infer the variance of type parameters automatically
-    TypeMap type_map = new_type_map();
-    for (size_t i = 0; i < type_params.size; ++i) {
-        insert_in_type_map(&type_map,
-            ((Type**)type_params.elems)[i],
-            &((Type**)type_params.elems)[i]->var.variance);
-    }
+    TypeMap type_map = acquire_type_map(&context->type_maps);
+    for (size_t i = 0; i < type_param_count; ++i)
+        insert_in_type_map(&type_map, type_params[i], &((Type*)type_params[i])->var.variance);
     get_type_vars_variance(fun_decl->type, TYPE_COVARIANT, &type_map);
-    free_type_map(&type_map);
-    free_dyn_array(&type_params);
+    release_type_map(&context->type_maps, &type_map);
+    restore_mem_pool(&context->scratch_pool, scratch_state);
 
     if (should_add_to_parent_sig_or_mod(fun_decl))
         add_decl_to_parent_sig_or_mod(context->type_table, fun_decl, fun_decl->type);
@@ -1334,20 +1416,47 @@ static const Type* infer_val_decl(TypingContext* context, AstNode* val_decl) {
     return val_decl->type;
 }
 
+static bool has_public_opaque_decls(const AstNode* mod_decl) {
+    for (AstNode* decl = mod_decl->mod_decl.members; decl; decl = decl->next) {
+        if (is_public_decl(decl) && is_opaque_decl(decl))
+            return true;
+    }
+    return false;
+}
+
 static const Type* infer_mod_decl(TypingContext* context, AstNode* mod_decl) {
     Type* signature = make_signature_type(context->type_table);
-    DynArray type_params = new_dyn_array(sizeof(Type*));
+    MemPoolState scratch_state = save_mem_pool(&context->scratch_pool);
 
+    signature->signature.type_params = alloc_type_params(context,
+        mod_decl->mod_decl.type_params, &signature->signature.type_param_count);
     signature->kind = infer_type_params(context,
-        mod_decl->mod_decl.type_params, &type_params, make_star_kind(context->type_table));
-
-    signature->signature.type_params = type_params.elems;
-    signature->signature.type_param_count = type_params.size;
+        mod_decl->mod_decl.type_params, signature->signature.type_params, make_star_kind(context->type_table));
+
+    // The value of opaque types is hidden once the module is inferred, so the bodies that
+    // are allowed to see it must be checked before that.
+    DynArray* deferred_bodies = context->deferred_bodies;
+    bool skip_fun_bodies = context->skip_fun_bodies;
+    if (has_public_opaque_decls(mod_decl)) {
+        context->deferred_bodies = NULL;
+        context->skip_fun_bodies = false;
+    }
 
     SignatureVars vars = { .vars = new_dyn_array(sizeof(Type*)) };
     mod_decl->mod_decl.vars = &vars;
-    for (AstNode* decl = mod_decl->mod_decl.members; decl; decl = decl->next)
+    bool is_traced = context->trace && !mod_decl->parent_scope;
+    for (AstNode* decl = mod_decl->mod_decl.members; decl; decl = decl->next) {
+        // Record a span for every top-level declaration when tracing is enabled
+        if (is_traced) {
+            const char* name = get_decl_name(decl);
+            begin_span(context->trace, "decl", name ? name : "<unnamed>");
+        }
         infer_decl(context, decl);
+        if (is_traced)
+            end_span(context->trace);
+    }
+    context->deferred_bodies = deferred_bodies;
+    context->skip_fun_bodies = skip_fun_bodies;
 
     // Hide the value (i.e. the actual type) of opaque types
     for (AstNode* decl = mod_decl->mod_decl.members; decl; decl = decl->next) {
@@ -1360,7 +1469,7 @@ static const Type* infer_mod_decl(TypingContext* context, AstNode* mod_decl) {
     signature->signature.vars = vars.vars.elems;
     signature->signature.var_count = vars.vars.size;
     seal_signature_type(context->type_table, signature);
-    free_dyn_array(&type_params);
+    restore_mem_pool(&context->scratch_pool, scratch_state);
     free_dyn_array(&vars.vars);
 
     if (mod_decl->mod_decl.signature) {
@@ -1384,13 +1493,12 @@ static const Type* infer_mod_decl(TypingContext* context, AstNode* mod_decl) {
 
 const Type* infer_sig_decl(TypingContext* context, AstNode* sig_decl) {
     Type* signature = make_signature_type(context->type_table);
-    DynArray type_params = new_dyn_array(sizeof(Type*));
+    MemPoolState scratch_state = save_mem_pool(&context->scratch_pool);
 
+    signature->signature.type_params = alloc_type_params(context,
+        sig_decl->sig_decl.type_params, &signature->signature.type_param_count);
     signature->kind = infer_type_params(context,
-        sig_decl->sig_decl.type_params, &type_params, make_star_kind(context->type_table));
-
-    signature->signature.type_params = type_params.elems;
-    signature->signature.type_param_count = type_params.size;
+        sig_decl->sig_decl.type_params, signature->signature.type_params, make_star_kind(context->type_table));
 
     SignatureVars vars = { .vars = new_dyn_array(sizeof(Type*)) };
     sig_decl->sig_decl.vars = &vars;
@@ -1400,7 +1508,7 @@ const Type* infer_sig_decl(TypingContext* context, AstNode* sig_decl) {
     signature->signature.vars = vars.vars.elems;
     signature->signature.var_count = vars.vars.size;
     seal_signature_type(context->type_table, signature);
-    free_dyn_array(&type_params);
+    restore_mem_pool(&context->scratch_pool, scratch_state);
     free_dyn_array(&vars.vars);
 
     sig_decl->sig_decl.vars = NULL;
@@ -1437,3 +1545,92 @@ const Type* infer_decl(TypingContext* context, AstNode* decl) {
 void infer_program(TypingContext* context, AstNode* program) {
     infer_mod_decl(context, program);
 }
+
+void enter_program(TypingContext* context, AstNode* program) {
+    // Public declarations are added to the signature of the program as they are inferred
+    assert(!program->parent_scope && !program->mod_decl.vars);
+    SignatureVars* vars = malloc_or_die(sizeof(SignatureVars));
+    vars->vars = new_dyn_array(sizeof(Type*));
+    program->mod_decl.vars = vars;
+    (void)context;
+}
+
+void leave_program(TypingContext* context, AstNode* program) {
+    for (AstNode* decl = program->mod_decl.members; decl; decl = decl->next) {
+        if (decl->type && is_public_decl(decl) && is_opaque_decl(decl)) {
+            assert(decl->type->tag == TYPE_VAR);
+            ((Type*)decl->type)->var.value = NULL;
+        }
+    }
+    free_dyn_array(&program->mod_decl.vars->vars);
+    free(program->mod_decl.vars);
+    program->mod_decl.vars = NULL;
+    (void)context;
+}
+
+void check_fun_body(TypingContext* context, AstNode* fun_decl) {
+    assert(fun_decl->type && fun_decl->type->tag == TYPE_FUN);
+    if (fun_decl->fun_decl.body && !fun_decl->fun_decl.body->type)
+        check_expr(context, fun_decl->fun_decl.body, fun_decl->type->fun.codom);
+}
+
+typedef struct {
+    DeferredBody** bodies;
+    TypingContext* contexts;
+} BodyTasks;
+
+static void check_body_task(void* data, size_t body_index, size_t thread_index) {
+    BodyTasks* tasks = data;
+    DeferredBody* body = tasks->bodies[body_index];
+    TypingContext* context = &tasks->contexts[thread_index];
+    context->log = &body->log;
+    check_fun_body(context, body->fun_decl);
+}
+
+void infer_program_in_parallel(TypingContext* context, AstNode* program, ThreadPool* thread_pool) {
+    Log* log = context->log;
+    DynArray deferred_bodies = new_dyn_array(sizeof(DeferredBody*));
+    context->deferred_bodies = &deferred_bodies;
+    infer_mod_decl(context, program);
+    context->deferred_bodies = NULL;
+    context->log = log;
+
+    // The first thread uses the given context, and the other threads get their own type table and
+    // memory pool. The types they create are shared, and thus must live as long as the context.
+    size_t thread_count = get_thread_count(thread_pool);
+    TypingContext* contexts = malloc_or_die(sizeof(TypingContext) * thread_count);
+    MemPool* mem_pools = malloc_or_die(sizeof(MemPool) * thread_count);
+    contexts[0] = *context;
+    contexts[0].trace = NULL;
+    for (size_t i = 1; i < thread_count; ++i) {
+        mem_pools[i] = new_mem_pool();
+        TypeTable* type_table = new_shared_type_table(get_type_interner(context->type_table), &mem_pools[i]);
+        contexts[i] = new_typing_context(type_table, &mem_pools[i], NULL);
+    }
+
+    DeferredBody** bodies = deferred_bodies.elems;
+    run_tasks(thread_pool, deferred_bodies.size, check_body_task, &(BodyTasks) { bodies, contexts });
+
+    for (size_t i = 1; i < thread_count; ++i) {
+        free_type_table(contexts[i].type_table);
+        free_typing_context(&contexts[i]);
+        merge_mem_pool(context->mem_pool, &mem_pools[i]);
+    }
+    contexts[0].trace = context->trace;
+    contexts[0].log = log;
+    *context = contexts[0];
+    free(mem_pools);
+    free(contexts);
+
+    // Replay the messages in the order in which checking the program in one phase reports them
+    for (size_t i = 0; i < deferred_bodies.size; ++i) {
+        merge_log(log, &bodies[i]->log);
+        merge_log(log, &bodies[i]->next_log);
+        free_log(&bodies[i]->log);
+        free_log(&bodies[i]->next_log);
+        free_format_state(&bodies[i]->state);
+        free_format_state(&bodies[i]->next_state);
+        free(bodies[i]);
+    }
+    free_dyn_array(&deferred_bodies);
+}
@@ -3,20 +3,45 @@
 
 #include "fu/lang/ast.h"
 #include "fu/lang/types.h"
-#include "fu/core/hash_table.h"
+#include "fu/core/bit_set.h"
+#include "fu/core/mem_pool.h"
 
-typedef struct MemPool MemPool;
+typedef struct Trace Trace;
+typedef struct ThreadPool ThreadPool;
+typedef struct DynArray DynArray;
 
 /*
  * The type-checker is an implementation of a bidirectional type-checking algorithm.
  * It is therefore local in nature, only looking at "neighboring" nodes to make typing judgments.
+ *
+ * Programs can also be checked in two phases: The first phase infers the type of every declaration,
+ * but defers the bodies of module-level functions that have a return type annotation. Since the
+ * type of those functions does not depend on their body, the second phase can check the deferred
+ * bodies independently, in parallel. Messages are buffered and replayed in the order in which they
+ * would have been reported by checking the program in one phase.
+ *
+ * Finally, declarations can be inferred one at a time, on demand (see `fu/driver/query.h`). In that
+ * case, the type-checker reports the module-level declarations that it reads and infers to an
+ * observer, which can then record the dependencies between declarations.
  */
 
+typedef struct DeclObserver {
+    void (*read_decl)(struct DeclObserver*, AstNode*);  // The type of the declaration is needed
+    void (*begin_decl)(struct DeclObserver*, AstNode*); // The declaration is about to be inferred
+    void (*end_decl)(struct DeclObserver*, AstNode*);   // The declaration has been inferred
+} DeclObserver;
+
 typedef struct TypingContext {
     Log* log;
     TypeTable* type_table;
     MemPool* mem_pool;
-    HashTable visited_decls;
+    BitSet visited_decls;
+    TypeMapPool type_maps;
+    MemPool scratch_pool; // Temporary buffers, allocated and freed in stack order
+    Trace* trace;
+    DynArray* deferred_bodies; // Function bodies left to the second phase, if not `NULL`
+    bool skip_fun_bodies;      // Leaves module-level function bodies to `check_fun_body()`
+    DeclObserver* decl_observer;
 } TypingContext;
 
 TypingContext new_typing_context(TypeTable*, MemPool* mem_pool, Log*);
@@ -33,4 +58,23 @@ const Type* check_stmt(TypingContext*, AstNode*, const Type*);
 const Type* infer_decl(TypingContext*, AstNode*);
 void infer_program(TypingContext*, AstNode*);
 
+/// Allows the declarations of a program to be inferred one at a time with `infer_decl_site()`,
+/// until `leave_program()` is called.
+void enter_program(TypingContext*, AstNode*);
+void leave_program(TypingContext*, AstNode*);
+
+/// Returns `true` if the declaration is a member of the program, or of a module nested in it.
+bool is_module_level_decl(const AstNode*);
+
+/// Returns the type of a declaration, inferring it first if needed.
+const Type* infer_decl_site(TypingContext*, AstNode*);
+
+/// Checks the body of a function that has a return type annotation, unless that body has
+/// already been checked along with the function.
+void check_fun_body(TypingContext*, AstNode*);
+
+/// Checks the program in two phases, using the given thread pool for the second phase. The type
+/// table of the context must have been created with an interner that has more than one shard.
+void infer_program_in_parallel(TypingContext*, AstNode*, ThreadPool*);
+
 #endif
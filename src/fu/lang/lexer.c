@@ -7,7 +7,6 @@
 #include <ctype.h>
 #include <string.h>
 #include <stdlib.h>
-#include <inttypes.h>
 
 typedef struct {
     const char* name;
@@ -34,6 +33,7 @@ static void register_keywords(HashTable* keywords) {
 }
 
 Lexer new_lexer(const char* file_name, const char* file_data, size_t file_size, Log* log) {
+    assert(file_size <= MAX_LEXER_FILE_SIZE);
     enum {
 #define f(name, str) KEYWORD_##name,
         KEYWORD_LIST(f)
@@ -46,7 +46,7 @@ Lexer new_lexer(const char* file_name, const char* file_data, size_t file_size,
         .file_data = file_data,
         .file_size = file_size,
         .file_pos = { .row = 1, .col = 1 },
-        .keywords = new_hash_table_with_capacity(KEYWORD_COUNT, sizeof(Keyword))
+        .keywords = new_hash_table_with_capacity(sizeof(Keyword), KEYWORD_COUNT)
     };
     register_keywords(&lexer.keywords);
     return lexer;
@@ -107,32 +107,23 @@ static void skip_multi_line_comment(Lexer* lexer) {
     }
 }
 
+static inline TokenPos file_pos_to_token_pos(const FilePos* pos) {
+    return (TokenPos) { .row = pos->row, .col = pos->col, .byte_offset = pos->byte_offset };
+}
+
 static Token make_token(Lexer* lexer, const FilePos* begin, TokenTag tag) {
+    lexer->token_count++;
     return (Token) {
         .tag = tag,
-        .file_loc = {
-            .file_name = lexer->file_name,
-            .begin = *begin,
-            .end = lexer->file_pos
-        },
+        .begin = file_pos_to_token_pos(begin),
+        .end = file_pos_to_token_pos(&lexer->file_pos)
     };
 }
 
-static Token make_int_literal(Lexer* lexer, const FilePos* begin, uintmax_t int_val) {
-    Token token = make_token(lexer, begin, TOKEN_INT_LITERAL);
-    token.int_val = int_val;
-    return token;
-}
-
-static Token make_float_literal(Lexer* lexer, const FilePos* begin, double float_val) {
-    Token token = make_token(lexer, begin, TOKEN_FLOAT_LITERAL);
-    token.float_val = float_val;
-    return token;
-}
-
 static Token make_invalid_token(Lexer* lexer, const FilePos* begin, const char* err_msg) {
     Token token = make_token(lexer, begin, TOKEN_ERROR);
-    log_error(lexer->log, &token.file_loc, err_msg, NULL);
+    FileLoc file_loc = get_token_file_loc(&token, lexer->file_name);
+    log_error(lexer->log, &file_loc, err_msg, NULL);
     return token;
 }
 
@@ -277,11 +268,15 @@ Token advance_lexer(Lexer* lexer) {
             size_t char_count = 0;
             for (; get_cur_char(lexer) != '\'' && get_cur_char(lexer) != '\n'; char_count++)
                 skip_char(lexer);
-            Token token = make_token(lexer, &begin, TOKEN_CHAR_LITERAL);
-            if (!accept_char(lexer, '\'') ||
-                convert_escape_seq(ptr, get_cur_ptr(lexer) - ptr, &token.char_val) != char_count)
+            char char_val;
+            if (get_cur_char(lexer) != '\'' ||
+                convert_escape_seq(ptr, get_cur_ptr(lexer) - ptr, &char_val) != char_count)
+            {
+                accept_char(lexer, '\'');
                 return make_invalid_token(lexer, &begin, "invalid character literal");
-            return token;
+            }
+            skip_char(lexer);
+            return make_token(lexer, &begin, TOKEN_CHAR_LITERAL);
         }
 
         if (get_cur_char(lexer) == '_' || isalpha(get_cur_char(lexer))) {
@@ -303,28 +298,25 @@ Token advance_lexer(Lexer* lexer) {
 
         if (isdigit(get_cur_char(lexer))) {
             bool was_zero = get_cur_char(lexer) == '0';
-            const char* ptr = get_cur_ptr(lexer);
 
+            // The value of literals is decoded by the parser (see `parse_int_literal()`)
             skip_char(lexer);
             if (was_zero) {
                 if (accept_char(lexer, 'b')) {
                     // Binary literal
-                    ptr = get_cur_ptr(lexer);
                     while (get_cur_char(lexer) == '0' || get_cur_char(lexer) == '1')
                         skip_char(lexer);
-                    return make_int_literal(lexer, &begin, strtoumax(ptr, NULL, 2));
+                    return make_token(lexer, &begin, TOKEN_INT_LITERAL);
                 } else if (accept_char(lexer, 'x')) {
                     // Hexadecimal literal
-                    ptr = get_cur_ptr(lexer);
                     while (isxdigit(get_cur_char(lexer)))
                         skip_char(lexer);
-                    return make_int_literal(lexer, &begin, strtoumax(ptr, NULL, 16));
+                    return make_token(lexer, &begin, TOKEN_INT_LITERAL);
                 } else if (accept_char(lexer, 'o')) {
                     // Octal literal
-                    ptr = get_cur_ptr(lexer);
                     while (get_cur_char(lexer) >= '0' && get_cur_char(lexer) <= '7')
                         skip_char(lexer);
-                    return make_int_literal(lexer, &begin, strtoumax(ptr, NULL, 8));
+                    return make_token(lexer, &begin, TOKEN_INT_LITERAL);
                 }
             }
 
@@ -348,9 +340,7 @@ Token advance_lexer(Lexer* lexer) {
                 }
             }
 
-            return has_dot
-                ? make_float_literal(lexer, &begin, strtod(ptr, NULL))
-                : make_int_literal(lexer, &begin, strtoumax(ptr, NULL, 10));
+            return make_token(lexer, &begin, has_dot ? TOKEN_FLOAT_LITERAL : TOKEN_INT_LITERAL);
         }
 
         skip_char(lexer);
@@ -10,6 +10,9 @@
  * and produces tokens one at a time. The file data must be terminated by a null character.
  */
 
+// Tokens store 32-bit offsets, which limits the size of the files that can be lexed
+#define MAX_LEXER_FILE_SIZE UINT32_MAX
+
 typedef struct Lexer {
     const char* file_name;
     const char* file_data;
@@ -17,6 +20,7 @@ typedef struct Lexer {
     FilePos file_pos;
     Log* log;
     HashTable keywords;
+    size_t token_count;
 } Lexer;
 
 Lexer new_lexer(const char* file_name, const char* file_data, size_t file_size, Log*);
@@ -2,11 +2,14 @@
 #include "fu/lang/ast.h"
 #include "fu/lang/lexer.h"
 #include "fu/core/mem_pool.h"
+#include "fu/core/dyn_array.h"
 #include "fu/core/alloc.h"
+#include "fu/core/utils.h"
 
 #include <string.h>
 #include <stdlib.h>
 #include <assert.h>
+#include <inttypes.h>
 
 typedef struct {
     AstNode* first;
@@ -30,10 +33,11 @@ static inline void add_ast_node_to_list(AstNodeList* list, AstNode* node) {
     list->last = node;
 }
 
-Parser make_parser(Lexer* lexer, MemPool* mem_pool) {
+Parser make_parser(Lexer* lexer, MemPool* mem_pool, atomic_size_t* node_id_count) {
     Parser parser = {
         .lexer = lexer,
         .mem_pool = mem_pool,
+        .node_id_count = node_id_count,
         .prev_end = { .row = 1, .col = 1 }
     };
     for (size_t i = 0; i < LOOK_AHEAD; ++i)
@@ -41,12 +45,41 @@ Parser make_parser(Lexer* lexer, MemPool* mem_pool) {
     return parser;
 }
 
+static inline const Token* peek_token(const Parser* parser, size_t i) {
+    assert(i < LOOK_AHEAD);
+    return &parser->ahead[(parser->ahead_index + i) % LOOK_AHEAD];
+}
+
+static inline FilePos get_cur_pos(const Parser* parser) {
+    return token_pos_to_file_pos(peek_token(parser, 0)->begin);
+}
+
+static inline FileLoc get_cur_file_loc(const Parser* parser) {
+    return get_token_file_loc(peek_token(parser, 0), parser->lexer->file_name);
+}
+
+static inline const char* get_cur_token_data(const Parser* parser) {
+    return parser->lexer->file_data + peek_token(parser, 0)->begin.byte_offset;
+}
+
+static inline size_t get_cur_token_size(const Parser* parser) {
+    return peek_token(parser, 0)->end.byte_offset - peek_token(parser, 0)->begin.byte_offset;
+}
+
 static inline AstNode* make_ast_node(Parser* parser, const FilePos* begin, const AstNode* node) {
     AstNode* copy = alloc_from_mem_pool(parser->mem_pool, sizeof(AstNode));
     memcpy(copy, node, sizeof(AstNode));
+    if (parser->next_node_id == parser->end_node_id) {
+        parser->next_node_id = atomic_fetch_add_explicit(
+            parser->node_id_count, AST_NODE_ID_BLOCK_SIZE, memory_order_relaxed);
+        parser->end_node_id = parser->next_node_id + AST_NODE_ID_BLOCK_SIZE;
+    }
+    copy->id = parser->next_node_id++;
     copy->file_loc.file_name = parser->lexer->file_name;
     copy->file_loc.begin = *begin;
     copy->file_loc.end = parser->prev_end;
+    if (parser->ast_node_counts)
+        parser->ast_node_counts[node->tag]++;
     return copy;
 }
 
@@ -59,20 +92,27 @@ static inline const char* copy_file_data(Parser* parser, size_t begin, size_t en
 }
 
 static inline void skip_token(Parser* parser) {
-    parser->prev_end = parser->ahead->file_loc.end;
-    for (size_t i = 0; i < LOOK_AHEAD - 1; ++i)
-        parser->ahead[i] = parser->ahead[i + 1];
-    parser->ahead[LOOK_AHEAD - 1] = advance_lexer(parser->lexer);
+    // The look-ahead is a ring buffer: The slot of the token that is skipped is
+    // refilled with the next token, and the current position moves to the next slot.
+    Token* token = &parser->ahead[parser->ahead_index];
+    parser->prev_end = token_pos_to_file_pos(token->end);
+    if (parser->decl_hashes) {
+        parser->token_hash = hash_raw_bytes(hash_uint32(parser->token_hash, token->tag),
+            parser->lexer->file_data + token->begin.byte_offset,
+            token->end.byte_offset - token->begin.byte_offset);
+    }
+    *token = advance_lexer(parser->lexer);
+    parser->ahead_index = (parser->ahead_index + 1) % LOOK_AHEAD;
 }
 
 static inline void eat_token(Parser* parser, TokenTag tag) {
-    assert(parser->ahead->tag == tag);
+    assert(peek_token(parser, 0)->tag == tag);
     skip_token(parser);
     (void)tag;
 }
 
 static inline bool accept_token(Parser* parser, TokenTag tag) {
-    if (parser->ahead->tag == tag) {
+    if (peek_token(parser, 0)->tag == tag) {
         skip_token(parser);
         return true;
     }
@@ -97,7 +137,8 @@ static void report_empty(Parser* parser, const char* msg, const FileLoc* file_lo
 
 static inline bool expect_token(Parser* parser, TokenTag tag) {
     if (!accept_token(parser, tag)) {
-        report_invalid_token(parser, token_tag_to_str(tag), token_tag_to_str(parser->ahead->tag), &parser->ahead->file_loc);
+        FileLoc file_loc = get_cur_file_loc(parser);
+        report_invalid_token(parser, token_tag_to_str(tag), token_tag_to_str(peek_token(parser, 0)->tag), &file_loc);
         return false;
     }
     return true;
@@ -105,8 +146,8 @@ static inline bool expect_token(Parser* parser, TokenTag tag) {
 
 static AstNode* parse_many(Parser* parser, TokenTag end, TokenTag sep, AstNode* (*parse_one)(Parser*)) {
     AstNodeList list = { NULL, NULL };
-    while (parser->ahead->tag != TOKEN_EOF) {
-        if (end != TOKEN_ERROR && parser->ahead->tag == end)
+    while (peek_token(parser, 0)->tag != TOKEN_EOF) {
+        if (end != TOKEN_ERROR && peek_token(parser, 0)->tag == end)
             break;
         add_ast_node_to_list(&list, parse_one(parser));
         if (sep != TOKEN_ERROR && !accept_token(parser, sep))
@@ -122,28 +163,31 @@ static AstNode* parse_many_at_least_one(
     AstNode* (*parse_one)(Parser*))
 {
     AstNode* ast_nodes = parse_many(parser, end, sep, parse_one);
-    if (!ast_nodes)
-        report_empty(parser, msg, &parser->ahead->file_loc);
+    if (!ast_nodes) {
+        FileLoc file_loc = get_cur_file_loc(parser);
+        report_empty(parser, msg, &file_loc);
+    }
     return ast_nodes;
 }
 
 static inline const char* parse_ident(Parser* parser) {
     const char* name = copy_file_data(parser,
-        parser->ahead->file_loc.begin.byte_offset,
-        parser->ahead->file_loc.end.byte_offset);
+        peek_token(parser, 0)->begin.byte_offset,
+        peek_token(parser, 0)->end.byte_offset);
     expect_token(parser, TOKEN_IDENT);
     return name;
 }
 
 static inline AstNode* parse_error(Parser* parser, const char* msg) {
-    FilePos begin = parser->ahead->file_loc.begin;
-    report_invalid_token(parser, msg, token_tag_to_str(parser->ahead->tag), &parser->ahead->file_loc);
+    FileLoc file_loc = get_cur_file_loc(parser);
+    FilePos begin = file_loc.begin;
+    report_invalid_token(parser, msg, token_tag_to_str(peek_token(parser, 0)->tag), &file_loc);
     skip_token(parser);
     return make_ast_node(parser, &begin, &(AstNode) { .tag = AST_ERROR });
 }
 
 static inline AstNode* parse_tuple(Parser* parser, AstNodeTag tag, AstNode* (*parse_arg)(Parser*)) {
-    FilePos begin = parser->ahead->file_loc.begin;
+    FilePos begin = get_cur_pos(parser);
     eat_token(parser, TOKEN_L_PAREN);
     AstNode* args = parse_many(parser, TOKEN_R_PAREN, TOKEN_COMMA, parse_arg);
     expect_token(parser, TOKEN_R_PAREN);
@@ -153,7 +197,7 @@ static inline AstNode* parse_tuple(Parser* parser, AstNodeTag tag, AstNode* (*pa
 }
 
 static inline AstNode* parse_tuple_or_error(Parser* parser, const char* msg, AstNode* (*parse_tuple)(Parser*)) {
-    return parser->ahead->tag == TOKEN_L_PAREN ? parse_tuple(parser) : parse_error(parser, msg);
+    return peek_token(parser, 0)->tag == TOKEN_L_PAREN ? parse_tuple(parser) : parse_error(parser, msg);
 }
 
 static inline AstNode* parse_tuple_type(Parser* parser) {
@@ -169,7 +213,7 @@ static inline AstNode* parse_tuple_expr(Parser* parser) {
 }
 
 static AstNode* parse_array(Parser* parser, AstNodeTag tag, AstNode* (*parse_elem)(Parser*)) {
-    FilePos begin = parser->ahead->file_loc.begin;
+    FilePos begin = get_cur_pos(parser);
     eat_token(parser, TOKEN_L_BRACKET);
     AstNode* elems = parse_many(parser, TOKEN_R_BRACKET, TOKEN_COMMA, parse_elem);
     expect_token(parser, TOKEN_R_BRACKET);
@@ -185,7 +229,7 @@ static inline AstNode* parse_array_pattern(Parser* parser) {
 }
 
 static inline AstNode* parse_array_type(Parser* parser) {
-    FilePos begin = parser->ahead->file_loc.begin;
+    FilePos begin = get_cur_pos(parser);
     eat_token(parser, TOKEN_L_BRACKET);
     AstNode* elem_type = parse_type(parser);
     expect_token(parser, TOKEN_R_BRACKET);
@@ -196,7 +240,7 @@ static inline AstNode* parse_array_type(Parser* parser) {
 }
 
 static inline AstNode* parse_path_elem(Parser* parser) {
-    FilePos begin = parser->ahead->file_loc.begin;
+    FilePos begin = get_cur_pos(parser);
     const char* name = parse_ident(parser);
     AstNode* type_args = NULL;
     if (accept_token(parser, TOKEN_L_BRACKET)) {
@@ -215,7 +259,7 @@ static inline AstNode* parse_path_elems(Parser* parser) {
         add_ast_node_to_list(&elem_list, parse_path_elem(parser));
         // Note that `x.0` is not a path, and thus should not be parsed as a path,
         // but as a member expression.
-        if (parser->ahead[0].tag != TOKEN_DOT || parser->ahead[1].tag != TOKEN_IDENT)
+        if (peek_token(parser, 0)->tag != TOKEN_DOT || peek_token(parser, 1)->tag != TOKEN_IDENT)
             break;
         eat_token(parser, TOKEN_DOT);
     } while (true);
@@ -223,7 +267,7 @@ static inline AstNode* parse_path_elems(Parser* parser) {
 }
 
 static inline AstNode* parse_path(Parser* parser) {
-    FilePos begin = parser->ahead->file_loc.begin;
+    FilePos begin = get_cur_pos(parser);
     AstNode* elems = parse_path_elems(parser);
     return make_ast_node(parser, &begin, &(AstNode) { .tag = AST_PATH, .path.elems = elems });
 }
@@ -243,45 +287,52 @@ static inline AstNode* make_single_elem_path(Parser* parser, const char* name, c
 }
 
 static inline AstNode* parse_bool_literal(Parser* parser, bool val) {
-    FilePos begin = parser->ahead->file_loc.begin;
+    FilePos begin = get_cur_pos(parser);
     skip_token(parser);
     return make_ast_node(parser, &begin, &(AstNode) { .tag = AST_BOOL_LITERAL, .bool_literal.val = val });
 }
 
 static inline AstNode* parse_str_literal(Parser* parser) {
-    FilePos begin = parser->ahead->file_loc.begin;
+    FilePos begin = get_cur_pos(parser);
     // Skip enclosing `"`
     const char* val = copy_file_data(parser,
-        parser->ahead->file_loc.begin.byte_offset + 1,
-        parser->ahead->file_loc.end.byte_offset - 1);
+        peek_token(parser, 0)->begin.byte_offset + 1,
+        peek_token(parser, 0)->end.byte_offset - 1);
     eat_token(parser, TOKEN_STR_LITERAL);
     return make_ast_node(parser, &begin, &(AstNode) { .tag = AST_STR_LITERAL, .str_literal.val = val });
 }
 
 static inline AstNode* parse_char_literal(Parser* parser) {
-    FilePos begin = parser->ahead->file_loc.begin;
-    // Skip enclosing `'`
-    char val = parser->lexer->file_data[parser->ahead->file_loc.begin.byte_offset + 1];
+    FilePos begin = get_cur_pos(parser);
+    // Skip enclosing `'`. The lexer has already checked that the escape sequence is valid.
+    char val = 0;
+    convert_escape_seq(get_cur_token_data(parser) + 1, get_cur_token_size(parser) - 2, &val);
     eat_token(parser, TOKEN_CHAR_LITERAL);
     return make_ast_node(parser, &begin, &(AstNode) { .tag = AST_CHAR_LITERAL, .char_literal.val = val });
 }
 
 static inline AstNode* parse_int_literal(Parser* parser) {
-    FilePos begin = parser->ahead->file_loc.begin;
-    uintmax_t val = parser->ahead->int_val;
+    FilePos begin = get_cur_pos(parser);
+    const char* data = get_cur_token_data(parser);
+    int base = 10;
+    if (data[0] == '0' && (data[1] == 'b' || data[1] == 'x' || data[1] == 'o')) {
+        base = data[1] == 'b' ? 2 : data[1] == 'x' ? 16 : 8;
+        data += 2;
+    }
+    uintmax_t val = strtoumax(data, NULL, base);
     eat_token(parser, TOKEN_INT_LITERAL);
     return make_ast_node(parser, &begin, &(AstNode) { .tag = AST_INT_LITERAL, .int_literal.val = val });
 }
 
 static inline AstNode* parse_float_literal(Parser* parser) {
-    FilePos begin = parser->ahead->file_loc.begin;
-    double val = parser->ahead->float_val;
+    FilePos begin = get_cur_pos(parser);
+    double val = strtod(get_cur_token_data(parser), NULL);
     eat_token(parser, TOKEN_FLOAT_LITERAL);
     return make_ast_node(parser, &begin, &(AstNode) { .tag = AST_FLOAT_LITERAL, .float_literal.val = val });
 }
 
 static inline AstNode* parse_attr(Parser* parser) {
-    FilePos begin = parser->ahead->file_loc.begin;
+    FilePos begin = get_cur_pos(parser);
     const char* name = parse_ident(parser);
     if (accept_token(parser, TOKEN_L_PAREN)) {
         AstNode* attrs = parse_many(parser, TOKEN_R_PAREN, TOKEN_COMMA, parse_attr);
@@ -293,7 +344,7 @@ static inline AstNode* parse_attr(Parser* parser) {
     }
     AstNode* val = NULL;
     if (accept_token(parser, TOKEN_EQUAL)) {
-        switch (parser->ahead->tag) {
+        switch (peek_token(parser, 0)->tag) {
             case TOKEN_TRUE:          val = parse_bool_literal(parser, true); break;
             case TOKEN_FALSE:         val = parse_bool_literal(parser, false); break;
             case TOKEN_INT_LITERAL:   val = parse_int_literal(parser);   break;
@@ -320,11 +371,11 @@ static inline AstNode* parse_attr_list(Parser* parser) {
 }
 
 static inline AstNode* parse_block_expr(Parser* parser) {
-    FilePos begin = parser->ahead->file_loc.begin;
+    FilePos begin = get_cur_pos(parser);
     eat_token(parser, TOKEN_L_BRACE);
     AstNodeList stmt_list = { NULL, NULL };
     bool ends_with_semicolon = false;
-    while (parser->ahead->tag != TOKEN_R_BRACE) {
+    while (peek_token(parser, 0)->tag != TOKEN_R_BRACE) {
         AstNode* stmt = parse_stmt(parser);
         add_ast_node_to_list(&stmt_list, stmt);
         ends_with_semicolon = accept_token(parser, TOKEN_SEMICOLON);
@@ -339,14 +390,14 @@ static inline AstNode* parse_block_expr(Parser* parser) {
 }
 
 static AstNode* parse_primary_kind(Parser* parser) {
-    FilePos begin = parser->ahead->file_loc.begin;
+    FilePos begin = get_cur_pos(parser);
     if (accept_token(parser, TOKEN_STAR))
         return make_ast_node(parser, &begin, &(AstNode) { .tag = AST_KIND_STAR });
     return parse_type(parser);
 }
 
 static AstNode* parse_kind(Parser* parser) {
-    FilePos begin = parser->ahead->file_loc.begin;
+    FilePos begin = get_cur_pos(parser);
     if (accept_token(parser, TOKEN_L_PAREN)) {
         AstNode* dom_kinds = parse_many_at_least_one(
             parser, "domain kinds", TOKEN_R_PAREN, TOKEN_COMMA, parse_primary_kind);
@@ -368,7 +419,7 @@ static AstNode* parse_kind(Parser* parser) {
 }
 
 static AstNode* parse_type_param(Parser* parser) {
-    FilePos begin = parser->ahead->file_loc.begin;
+    FilePos begin = get_cur_pos(parser);
     const char* name = parse_ident(parser);
     AstNode* kind = NULL;
     if (accept_token(parser, TOKEN_COLON))
@@ -390,13 +441,13 @@ static inline AstNode* parse_type_params(Parser* parser) {
 }
 
 static inline AstNode* parse_basic_type(Parser* parser, AstNodeTag tag) {
-    FilePos begin = parser->ahead->file_loc.begin;
+    FilePos begin = get_cur_pos(parser);
     skip_token(parser);
     return make_ast_node(parser, &begin, &(AstNode) { .tag = tag });
 }
 
 static inline AstNode* parse_fun_type(Parser* parser) {
-    FilePos begin = parser->ahead->file_loc.begin;
+    FilePos begin = get_cur_pos(parser);
     eat_token(parser, TOKEN_FUN);
     AstNode* type_params = parse_type_params(parser);
     AstNode* dom_type = parse_tuple_or_error(parser, "function type domain", parse_tuple_type);
@@ -413,7 +464,7 @@ static inline AstNode* parse_fun_type(Parser* parser) {
 }
 
 static inline AstNode* parse_ptr_type(Parser* parser) {
-    FilePos begin = parser->ahead->file_loc.begin;
+    FilePos begin = get_cur_pos(parser);
     eat_token(parser, TOKEN_AMP);
     bool is_const = accept_token(parser, TOKEN_CONST);
     AstNode* pointed_type = parse_type(parser);
@@ -424,7 +475,7 @@ static inline AstNode* parse_ptr_type(Parser* parser) {
 }
 
 static inline AstNode* parse_where_clause(Parser* parser) {
-    FilePos begin = parser->ahead->file_loc.begin;
+    FilePos begin = get_cur_pos(parser);
     const char* name = parse_ident(parser);
     expect_token(parser, TOKEN_EQUAL);
     AstNode* type = parse_type(parser);
@@ -449,7 +500,7 @@ static inline AstNode* parse_where_type(Parser* parser, AstNode* signature) {
 }
 
 static AstNode* parse_prefix_type(Parser* parser) {
-    switch (parser->ahead->tag) {
+    switch (peek_token(parser, 0)->tag) {
 #define f(name, ...) case TOKEN_##name: return parse_basic_type(parser, AST_TYPE_##name);
         PRIM_TYPE_LIST(f)
 #undef f
@@ -467,7 +518,7 @@ static AstNode* parse_prefix_type(Parser* parser) {
 
 AstNode* parse_type(Parser* parser) {
     AstNode* type = parse_prefix_type(parser);
-    if (parser->ahead->tag == TOKEN_WHERE)
+    if (peek_token(parser, 0)->tag == TOKEN_WHERE)
         return parse_where_type(parser, type);
     return type;
 }
@@ -488,7 +539,7 @@ static AstNode* parse_struct(
 }
 
 static AstNode* parse_field(Parser* parser, AstNodeTag tag, AstNode* (*parse_val)(Parser*)) {
-    FilePos begin = parser->ahead->file_loc.begin;
+    FilePos begin = get_cur_pos(parser);
     const char* name = parse_ident(parser);
     expect_token(parser, TOKEN_EQUAL);
     AstNode* val = parse_val(parser);
@@ -534,7 +585,7 @@ static inline AstNode* parse_call_expr(Parser* parser, AstNode* callee) {
 
 static inline AstNode* parse_member_expr(Parser* parser, AstNode* left) {
     AstNode* elems_or_index = NULL;
-    if (parser->ahead->tag == TOKEN_INT_LITERAL)
+    if (peek_token(parser, 0)->tag == TOKEN_INT_LITERAL)
         elems_or_index = parse_int_literal(parser);
     else
         elems_or_index = parse_path_elems(parser);
@@ -548,12 +599,12 @@ static inline AstNode* parse_postfix_expr(Parser* parser, AstNode* (*parse_prima
     AstNode* operand = parse_primary_expr(parser);
     while (true) {
         AstNodeTag tag = AST_ERROR;
-        switch (parser->ahead->tag) {
+        switch (peek_token(parser, 0)->tag) {
             case TOKEN_DOUBLE_PLUS:  tag = AST_POST_INC_EXPR; break;
             case TOKEN_DOUBLE_MINUS: tag = AST_POST_DEC_EXPR; break;
             case TOKEN_DOT:
                 eat_token(parser, TOKEN_DOT);
-                if (parser->ahead->tag == TOKEN_L_BRACE)
+                if (peek_token(parser, 0)->tag == TOKEN_L_BRACE)
                     operand = parse_struct(parser, AST_UPDATE_EXPR, operand, parse_field_expr);
                 else
                     operand = parse_member_expr(parser, operand);
@@ -564,7 +615,7 @@ static inline AstNode* parse_postfix_expr(Parser* parser, AstNode* (*parse_prima
             default:
                 return operand;
         }
-        FilePos begin = parser->ahead->file_loc.begin;
+        FilePos begin = get_cur_pos(parser);
         skip_token(parser);
         operand = make_ast_node(parser,
             &begin, &(AstNode) { .tag = tag, .unary_expr = { .operand = operand } });
@@ -573,7 +624,7 @@ static inline AstNode* parse_postfix_expr(Parser* parser, AstNode* (*parse_prima
 
 static inline AstNode* parse_prefix_expr(Parser* parser, AstNode* (*parse_primary_expr)(Parser*)) {
     AstNodeTag tag = AST_ERROR;
-    switch (parser->ahead->tag) {
+    switch (peek_token(parser, 0)->tag) {
         case TOKEN_DOUBLE_PLUS:  tag = AST_PRE_INC_EXPR; break;
         case TOKEN_DOUBLE_MINUS: tag = AST_PRE_DEC_EXPR; break;
         case TOKEN_BANG:         tag = AST_NOT_EXPR;     break;
@@ -584,7 +635,7 @@ static inline AstNode* parse_prefix_expr(Parser* parser, AstNode* (*parse_primar
         default:
             return parse_postfix_expr(parser, parse_primary_expr);
     }
-    FilePos begin = parser->ahead->file_loc.begin;
+    FilePos begin = get_cur_pos(parser);
     skip_token(parser);
     AstNode* operand = parse_prefix_expr(parser, parse_primary_expr);
     return make_ast_node(parser, &begin, &(AstNode) { .tag = tag, .unary_expr = { .operand = operand } });
@@ -594,7 +645,7 @@ static inline AstNode* parse_binary_expr(
     Parser* parser, AstNode* left, AstNode* (*parse_primary_expr)(Parser*), int prec)
 {
     while (true) {
-        AstNodeTag tag = token_tag_to_binary_expr_tag(parser->ahead->tag);
+        AstNodeTag tag = token_tag_to_binary_expr_tag(peek_token(parser, 0)->tag);
         if (tag == AST_ERROR)
             break;
         int next_prec = get_binary_expr_precedence(tag);
@@ -627,7 +678,7 @@ static inline AstNodeTag token_tag_to_assign_expr_tag(TokenTag tag) {
 
 static inline AstNode* parse_assign_expr(Parser* parser, AstNode* (*parse_primary_expr)(Parser*)) {
     AstNode* left = parse_prefix_expr(parser, parse_primary_expr);
-    AstNodeTag tag = token_tag_to_assign_expr_tag(parser->ahead->tag);
+    AstNodeTag tag = token_tag_to_assign_expr_tag(peek_token(parser, 0)->tag);
     if (tag != AST_ERROR) {
         skip_token(parser);
         AstNode* right = parse_assign_expr(parser, parse_primary_expr);
@@ -658,18 +709,18 @@ static inline AstNode* parse_expr_without_structs(Parser* parser) {
 }
 
 static inline AstNode* parse_block_expr_or_error(Parser* parser) {
-    return parser->ahead->tag == TOKEN_L_BRACE
+    return peek_token(parser, 0)->tag == TOKEN_L_BRACE
         ? parse_block_expr(parser) : parse_error(parser, "block expression");
 }
 
 static inline AstNode* parse_if_expr(Parser* parser) {
-    FilePos begin = parser->ahead->file_loc.begin;
+    FilePos begin = get_cur_pos(parser);
     eat_token(parser, TOKEN_IF);
     AstNode* cond = parse_expr_without_structs(parser);
     AstNode* then_expr = parse_block_expr_or_error(parser);
     AstNode* else_expr = NULL;
     if (accept_token(parser, TOKEN_ELSE)) {
-        else_expr = parser->ahead->tag == TOKEN_IF
+        else_expr = peek_token(parser, 0)->tag == TOKEN_IF
             ? parse_if_expr(parser) : parse_block_expr_or_error(parser);
     }
     return make_ast_node(parser, &begin, &(AstNode) {
@@ -689,7 +740,7 @@ static AstNode* parse_match_case(Parser* parser) {
 }
 
 static inline AstNode* parse_match_expr(Parser* parser) {
-    FilePos begin = parser->ahead->file_loc.begin;
+    FilePos begin = get_cur_pos(parser);
     eat_token(parser, TOKEN_MATCH);
     AstNode* arg = parse_expr_without_structs(parser);
     expect_token(parser, TOKEN_L_BRACE);
@@ -702,7 +753,7 @@ static inline AstNode* parse_match_expr(Parser* parser) {
 }
 
 static inline AstNode* parse_fun_expr(Parser* parser) {
-    FilePos begin = parser->ahead->file_loc.begin;
+    FilePos begin = get_cur_pos(parser);
     eat_token(parser, TOKEN_FUN);
     AstNode* param = parse_tuple_or_error(parser, "anonymous function parameter", parse_tuple_pattern);
     AstNode* ret_type = NULL;
@@ -717,7 +768,7 @@ static inline AstNode* parse_fun_expr(Parser* parser) {
 }
 
 static inline AstNode* parse_untyped_expr(Parser* parser, bool allow_structs) {
-    switch (parser->ahead->tag) {
+    switch (peek_token(parser, 0)->tag) {
         case TOKEN_TRUE:          return parse_bool_literal(parser, true);
         case TOKEN_FALSE:         return parse_bool_literal(parser, false);
         case TOKEN_STR_LITERAL:   return parse_str_literal(parser);
@@ -732,17 +783,17 @@ static inline AstNode* parse_untyped_expr(Parser* parser, bool allow_structs) {
         case TOKEN_FUN:           return parse_fun_expr(parser);
         case TOKEN_IDENT: {
             AstNode* path = parse_path(parser);
-            if (allow_structs && parser->ahead->tag == TOKEN_L_BRACE)
+            if (allow_structs && peek_token(parser, 0)->tag == TOKEN_L_BRACE)
                 return parse_struct(parser, AST_STRUCT_EXPR, path, parse_field_expr);
             return path;
         }
         case TOKEN_BREAK:
         case TOKEN_CONTINUE:
         case TOKEN_RETURN: {
-            FilePos begin = parser->ahead->file_loc.begin;
+            FilePos begin = get_cur_pos(parser);
             AstNodeTag tag =
-                parser->ahead->tag == TOKEN_BREAK ? AST_BREAK_EXPR :
-                parser->ahead->tag == TOKEN_CONTINUE ? AST_CONTINUE_EXPR :
+                peek_token(parser, 0)->tag == TOKEN_BREAK ? AST_BREAK_EXPR :
+                peek_token(parser, 0)->tag == TOKEN_CONTINUE ? AST_CONTINUE_EXPR :
                 AST_RETURN_EXPR;
             skip_token(parser);
             return make_ast_node(parser, &begin, &(AstNode) { .tag = tag });
@@ -778,7 +829,7 @@ static AstNode* parse_anonymous_pattern(Parser* parser, AstNode* type) {
 }
 
 static AstNode* parse_untyped_pattern(Parser* parser, bool is_fun_param) {
-    switch (parser->ahead->tag) {
+    switch (peek_token(parser, 0)->tag) {
         case TOKEN_TRUE:          return parse_bool_literal(parser, true);
         case TOKEN_FALSE:         return parse_bool_literal(parser, false);
         case TOKEN_STR_LITERAL:   return parse_str_literal(parser);
@@ -790,15 +841,15 @@ static AstNode* parse_untyped_pattern(Parser* parser, bool is_fun_param) {
             // Accept types as patterns for function parameters,
             // so as to allow function prototypes without parameter names.
             if (is_fun_param &&
-                parser->ahead[1].tag != TOKEN_COLON &&
-                parser->ahead[1].tag != TOKEN_DOT &&
-                parser->ahead[1].tag != TOKEN_L_BRACE &&
-                parser->ahead[1].tag != TOKEN_L_BRACKET)
+                peek_token(parser, 1)->tag != TOKEN_COLON &&
+                peek_token(parser, 1)->tag != TOKEN_DOT &&
+                peek_token(parser, 1)->tag != TOKEN_L_BRACE &&
+                peek_token(parser, 1)->tag != TOKEN_L_BRACKET)
                 return parse_anonymous_pattern(parser, parse_type(parser));
             AstNode* path = parse_path(parser);
-            if (parser->ahead->tag == TOKEN_L_BRACE)
+            if (peek_token(parser, 0)->tag == TOKEN_L_BRACE)
                 return parse_struct(parser, AST_STRUCT_PATTERN, path, parse_field_pattern);
-            if (parser->ahead->tag == TOKEN_L_PAREN)
+            if (peek_token(parser, 0)->tag == TOKEN_L_PAREN)
                 return parse_ctor_pattern(parser, path);
             // If the pattern is just an identifier, then this is an identifier pattern, not a path
             if (!path->path.elems->next && !path->path.elems->path_elem.type_args) {
@@ -813,8 +864,8 @@ static AstNode* parse_untyped_pattern(Parser* parser, bool is_fun_param) {
         case TOKEN_MINUS:
         case TOKEN_PLUS:
             // Accept `-` and `+` in front of integer literals
-            if (parser->ahead[1].tag == TOKEN_INT_LITERAL) {
-                bool has_minus = parser->ahead->tag == TOKEN_MINUS;
+            if (peek_token(parser, 1)->tag == TOKEN_INT_LITERAL) {
+                bool has_minus = peek_token(parser, 0)->tag == TOKEN_MINUS;
                 skip_token(parser);
                 AstNode* literal = parse_int_literal(parser);
                 literal->int_literal.has_minus = has_minus;
@@ -851,7 +902,7 @@ AstNode* parse_pattern(Parser* parser) {
 }
 
 static inline AstNode* parse_for_loop(Parser* parser) {
-    FilePos begin = parser->ahead->file_loc.begin;
+    FilePos begin = get_cur_pos(parser);
     eat_token(parser, TOKEN_FOR);
     AstNode* pattern = parse_pattern(parser);
     expect_token(parser, TOKEN_IN);
@@ -864,7 +915,7 @@ static inline AstNode* parse_for_loop(Parser* parser) {
 }
 
 static inline AstNode* parse_while_loop(Parser* parser) {
-    FilePos begin = parser->ahead->file_loc.begin;
+    FilePos begin = get_cur_pos(parser);
     eat_token(parser, TOKEN_WHILE);
     AstNode* cond = parse_expr_without_structs(parser);
     AstNode* body = parse_block_expr_or_error(parser);
@@ -883,7 +934,7 @@ static inline AstNode* parse_fun_params(Parser* parser) {
 }
 
 static inline AstNode* parse_fun_decl(Parser* parser, bool is_public) {
-    FilePos begin = parser->ahead->file_loc.begin;
+    FilePos begin = get_cur_pos(parser);
     eat_token(parser, TOKEN_FUN);
 
     const char* name = parse_ident(parser);
@@ -902,7 +953,7 @@ static inline AstNode* parse_fun_decl(Parser* parser, bool is_public) {
     if (accept_token(parser, TOKEN_EQUAL)) {
         body = parse_expr(parser);
         expect_token(parser, TOKEN_SEMICOLON);
-    } else if (parser->ahead->tag == TOKEN_L_BRACE)
+    } else if (peek_token(parser, 0)->tag == TOKEN_L_BRACE)
         body = parse_block_expr(parser);
     else
         accept_token(parser, TOKEN_SEMICOLON);
@@ -922,7 +973,7 @@ static inline AstNode* parse_fun_decl(Parser* parser, bool is_public) {
 }
 
 static AstNode* parse_field_decl(Parser* parser) {
-    FilePos begin = parser->ahead->file_loc.begin;
+    FilePos begin = get_cur_pos(parser);
     const char* name = parse_ident(parser);
     expect_token(parser, TOKEN_COLON);
     AstNode* type = parse_type(parser);
@@ -936,11 +987,11 @@ static AstNode* parse_field_decl(Parser* parser) {
 }
 
 static AstNode* parse_option_decl(Parser* parser) {
-    FilePos begin = parser->ahead->file_loc.begin;
+    FilePos begin = get_cur_pos(parser);
     const char* name = parse_ident(parser);
     bool is_struct_like = false;
     AstNode* param_type = NULL;
-    if (parser->ahead->tag == TOKEN_L_PAREN) {
+    if (peek_token(parser, 0)->tag == TOKEN_L_PAREN) {
         param_type = parse_tuple_type(parser);
         if (param_type->tag == AST_TUPLE_TYPE && !param_type->tuple_type.args)
             report_empty(parser, "option parameter lists", &param_type->file_loc);
@@ -960,7 +1011,7 @@ static AstNode* parse_option_decl(Parser* parser) {
 }
 
 static inline AstNode* parse_struct_decl(Parser* parser, bool is_public, bool is_opaque) {
-    FilePos begin = parser->ahead->file_loc.begin;
+    FilePos begin = get_cur_pos(parser);
     eat_token(parser, TOKEN_STRUCT);
     const char* name = parse_ident(parser);
     AstNode* type_params = parse_type_params(parser);
@@ -998,7 +1049,7 @@ static inline AstNode* parse_struct_decl(Parser* parser, bool is_public, bool is
 }
 
 static inline AstNode* parse_enum_decl(Parser* parser, bool is_public, bool is_opaque) {
-    FilePos begin = parser->ahead->file_loc.begin;
+    FilePos begin = get_cur_pos(parser);
     eat_token(parser, TOKEN_ENUM);
     const char* name = parse_ident(parser);
     AstNode* type_params = parse_type_params(parser);
@@ -1026,7 +1077,7 @@ static inline AstNode* parse_enum_decl(Parser* parser, bool is_public, bool is_o
 }
 
 static inline AstNode* parse_val_decl(Parser* parser) {
-    FilePos begin = parser->ahead->file_loc.begin;
+    FilePos begin = get_cur_pos(parser);
     eat_token(parser, TOKEN_VAL);
     const char* name = parse_ident(parser);
     expect_token(parser, TOKEN_COLON);
@@ -1042,7 +1093,7 @@ static inline AstNode* parse_val_decl(Parser* parser) {
 }
 
 static AstNode* parse_sig_member(Parser* parser) {
-    switch (parser->ahead->tag) {
+    switch (peek_token(parser, 0)->tag) {
         case TOKEN_MOD:  return parse_mod_decl(parser, false, false);
         case TOKEN_TYPE: return parse_type_decl(parser, false, false, true);
         case TOKEN_VAL:  return parse_val_decl(parser);
@@ -1052,9 +1103,9 @@ static AstNode* parse_sig_member(Parser* parser) {
 }
 
 static inline AstNode* parse_sig_decl(Parser* parser, bool needs_name) {
-    FilePos begin = parser->ahead->file_loc.begin;
+    FilePos begin = get_cur_pos(parser);
     eat_token(parser, TOKEN_SIG);
-    const char* name = needs_name || parser->ahead->tag == TOKEN_IDENT ? parse_ident(parser) : NULL;
+    const char* name = needs_name || peek_token(parser, 0)->tag == TOKEN_IDENT ? parse_ident(parser) : NULL;
     AstNode* type_params = parse_type_params(parser);
     AstNode* members = NULL;
     if (accept_token(parser, TOKEN_L_BRACE)) {
@@ -1073,7 +1124,7 @@ static inline AstNode* parse_sig_decl(Parser* parser, bool needs_name) {
 }
 
 static inline AstNode* parse_mod_decl(Parser* parser, bool is_public, bool has_body) {
-    FilePos begin = parser->ahead->file_loc.begin;
+    FilePos begin = get_cur_pos(parser);
     eat_token(parser, TOKEN_MOD);
     const char* name = parse_ident(parser);
     AstNode* type_params = parse_type_params(parser);
@@ -1113,7 +1164,7 @@ static inline AstNode* parse_type_decl(
     bool is_opaque,
     bool allow_unbound_types)
 {
-    FilePos begin = parser->ahead->file_loc.begin;
+    FilePos begin = get_cur_pos(parser);
     eat_token(parser, TOKEN_TYPE);
     const char* name = parse_ident(parser);
     AstNode* type_params = parse_type_params(parser);
@@ -1141,7 +1192,7 @@ static inline AstNode* parse_const_or_var_decl(
     AstNodeTag ast_node_tag,
     bool is_public)
 {
-    FilePos begin = parser->ahead->file_loc.begin;
+    FilePos begin = get_cur_pos(parser);
     eat_token(parser, token_tag);
     AstNode* pattern = parse_pattern(parser);
     AstNode* init = NULL;
@@ -1169,7 +1220,7 @@ static inline AstNode* parse_var_decl(Parser* parser, bool is_public) {
 }
 
 static inline AstNode* parse_using_decl(Parser* parser) {
-    FilePos begin = parser->ahead->file_loc.begin;
+    FilePos begin = get_cur_pos(parser);
     eat_token(parser, TOKEN_USING);
     AstNode* type_params = parse_type_params(parser);
     AstNode* used_mod = parse_type(parser);
@@ -1181,7 +1232,7 @@ static inline AstNode* parse_using_decl(Parser* parser) {
 }
 
 AstNode* parse_stmt(Parser* parser) {
-    switch (parser->ahead->tag) {
+    switch (peek_token(parser, 0)->tag) {
         case TOKEN_FOR:    return parse_for_loop(parser);
         case TOKEN_WHILE:  return parse_while_loop(parser);
         case TOKEN_TYPE:   return parse_type_decl(parser, false, false, false);
@@ -1194,7 +1245,7 @@ AstNode* parse_stmt(Parser* parser) {
             // This test here prevents an ambiguity with anonymous function expressions.
             // Those also start with `fun`, just like function declarations,
             // but do not have an identifier after that.
-            if (parser->ahead[1].tag == TOKEN_IDENT)
+            if (peek_token(parser, 1)->tag == TOKEN_IDENT)
                 return parse_fun_decl(parser, false);
             // fallthrough
         default:
@@ -1203,7 +1254,7 @@ AstNode* parse_stmt(Parser* parser) {
 }
 
 static inline AstNode* parse_decl_without_attr_list(Parser* parser, bool is_public, bool is_opaque) {
-    switch (parser->ahead->tag) {
+    switch (peek_token(parser, 0)->tag) {
         case TOKEN_STRUCT: return parse_struct_decl(parser, is_public, is_opaque);
         case TOKEN_ENUM:   return parse_enum_decl(parser, is_public, is_opaque);
         case TOKEN_MOD:    return parse_mod_decl(parser, is_public, true);
@@ -1220,10 +1271,10 @@ static inline AstNode* parse_decl_without_attr_list(Parser* parser, bool is_publ
 
 AstNode* parse_decl(Parser* parser) {
     AstNode* attrs = NULL;
-    if (parser->ahead->tag == TOKEN_HASH)
+    if (peek_token(parser, 0)->tag == TOKEN_HASH)
         attrs = parse_attr_list(parser);
     bool is_public = accept_token(parser, TOKEN_PUB);
-    FileLoc opaque_loc = parser->ahead->file_loc;
+    FileLoc opaque_loc = get_cur_file_loc(parser);
     bool is_opaque = is_public && accept_token(parser, TOKEN_OPAQUE);
     AstNode* decl = parse_decl_without_attr_list(parser, is_public, is_opaque);
     if (is_opaque && is_value_decl(decl->tag)) {
@@ -1234,9 +1285,17 @@ AstNode* parse_decl(Parser* parser) {
     return decl;
 }
 
+static AstNode* parse_hashed_decl(Parser* parser) {
+    parser->token_hash = hash_init();
+    AstNode* decl = parse_decl(parser);
+    push_on_dyn_array(parser->decl_hashes, &parser->token_hash);
+    return decl;
+}
+
 AstNode* parse_program(Parser* parser) {
-    FilePos begin = parser->ahead->file_loc.begin;
-    AstNode* members = parse_many(parser, TOKEN_EOF, TOKEN_ERROR, parse_decl);
+    FilePos begin = get_cur_pos(parser);
+    AstNode* members = parse_many(parser, TOKEN_EOF, TOKEN_ERROR,
+        parser->decl_hashes ? parse_hashed_decl : parse_decl);
     return make_ast_node(parser, &begin, &(AstNode) {
         .tag = AST_MOD_DECL,
         .mod_decl = { .members = members }
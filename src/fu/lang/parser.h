@@ -2,28 +2,43 @@
 #define FU_LANG_PARSER_H
 
 #include "fu/lang/token.h"
+#include "fu/lang/ast.h"
 #include "fu/core/log.h"
 
+#include <stdatomic.h>
+
 /*
  * The parser is LL(3), which means that it requires at most three tokens of look-ahead.
  * It is a simple recursive descent parser, implemented by hand, which allocates nodes
- * and strings on a memory pool.
+ * and strings on a memory pool. The look-ahead tokens are stored in a ring buffer, so that skipping
+ * a token does not require moving the others.
+ * Every node gets a dense identifier. Identifiers are reserved in blocks from a counter that
+ * can be shared by several parsers running in parallel, which keeps them unique in a session.
+ * Optionally, the parser also hashes the tokens of each top-level declaration, which allows to
+ * recognize declarations that have not changed between two compilations.
  */
 
 #define LOOK_AHEAD 3
+#define AST_NODE_ID_BLOCK_SIZE 256
 
 typedef struct MemPool MemPool;
 typedef struct Lexer Lexer;
-typedef struct AstNode AstNode;
-
+typedef struct DynArray DynArray;
 typedef struct {
     Lexer* lexer;
     MemPool* mem_pool;
     FilePos prev_end;
+    size_t ahead_index;
     Token ahead[LOOK_AHEAD];
+    atomic_size_t* node_id_count;
+    size_t next_node_id;
+    size_t end_node_id;
+    size_t* ast_node_counts; // Optional: Number of nodes created, indexed by tag
+    DynArray* decl_hashes;   // Optional: Hash of the tokens of each top-level declaration
+    HashCode token_hash;
 } Parser;
 
-Parser make_parser(Lexer*, MemPool*);
+Parser make_parser(Lexer*, MemPool*, atomic_size_t* node_id_count);
 
 AstNode* parse_stmt(Parser*);
 AstNode* parse_decl(Parser*);
@@ -99,16 +99,34 @@ typedef enum {
 #undef f
 } TokenTag;
 
+/*
+ * Tokens are kept small: They only contain a tag and their position in the file, without the file
+ * name, which is known by the lexer. The value of literals is not stored in the token, and is
+ * instead decoded from the file data when the corresponding AST node is created.
+ */
+
+typedef struct {
+    uint32_t row, col;
+    uint32_t byte_offset;
+} TokenPos;
+
 typedef struct {
     TokenTag tag;
-    union {
-        uintmax_t int_val;
-        double float_val;
-        char char_val;
-    };
-    FileLoc file_loc;
+    TokenPos begin, end;
 } Token;
 
+static inline FilePos token_pos_to_file_pos(TokenPos pos) {
+    return (FilePos) { .row = pos.row, .col = pos.col, .byte_offset = pos.byte_offset };
+}
+
+static inline FileLoc get_token_file_loc(const Token* token, const char* file_name) {
+    return (FileLoc) {
+        .file_name = file_name,
+        .begin = token_pos_to_file_pos(token->begin),
+        .end = token_pos_to_file_pos(token->end)
+    };
+}
+
 static inline const char* token_tag_to_str(TokenTag tag) {
     switch (tag) {
 #define f(name, str) case TOKEN_##name: return str;
@@ -9,6 +9,8 @@
 #include <string.h>
 #include <stdlib.h>
 #include <assert.h>
+#include <stdatomic.h>
+#include <pthread.h>
 
 enum {
 #define f(name, ...) PRIM_TYPE_##name,
@@ -17,12 +19,92 @@ enum {
     PRIM_TYPE_COUNT
 };
 
-struct TypeTable {
+typedef struct {
+    uint32_t left_id;
+    uint32_t right_id;
+    bool is_sub_type;
+} SubTypeResult;
+
+// Substitutions are interned, so that the results of `replace_types()` can be remembered using
+// the identifier of the type and the identifier of the substitution.
+typedef struct {
+    const Type** from;
+    const Type** to;
+    size_t type_count;
+    size_t id;
+} Substitution;
+
+typedef struct {
+    uint32_t type_id;
+    uint32_t substitution_id;
+    const Type* replaced_type;
+} ReplacedType;
+
+// The member types of an applied structure or enumeration (i.e. the field types or option parameter
+// types with the type arguments of the application substituted) are computed all at once, the
+// first time one of them is requested. Since member arrays are copied when modified, the array
+// that was used to compute them identifies the version of the applied type.
+typedef struct {
+    uint32_t app_type_id;
+    uint32_t applied_type_id;
+    const void* members;
+    const Type** member_types;
+} Instance;
+
+// Pointers, monomorphic functions, and small tuples are the most frequently built types. Instead of
+// going through the table of structural types, they are interned by their tag and the identifiers
+// of their children, which are stored next to the type, so that lookups never need to hash or
+// compare the type itself. Those types must therefore only be created with the functions below.
+#define MAX_SHALLOW_CHILD_COUNT 3
+
+typedef struct {
+    uint32_t child_ids[MAX_SHALLOW_CHILD_COUNT];
+    uint8_t tag;
+    uint8_t child_count;
+    bool is_const;
+    const Type* type;
+} ShallowType;
+
+// Structural types are distributed over several shards, each protected by its own lock, so that
+// threads interning unrelated types rarely wait for each other. Types are allocated from the
+// memory pool of the type table that creates them, while the interner only owns its strings.
+typedef struct {
+    pthread_mutex_t mutex;
     HashTable types;
-    HashTable kinds;
-    MemPool* mem_pool;
+    HashTable shallow_types;
+} TypeShard;
+
+struct TypeInterner {
+    TypeShard* shards;
+    size_t shard_count;
+    pthread_mutex_t str_mutex;
+    // Protects nominal types that are modified after other threads can reach them: The result of
+    // applying a module, and the inheritance displays that are extended in place.
+    pthread_mutex_t nominal_mutex;
     StrPool str_pool;
-    size_t type_count, kind_count;
+    MemPool mem_pool;
+    atomic_size_t type_count;
+    atomic_size_t kind_count;
+};
+
+struct TypeTable {
+    TypeInterner* interner;
+    bool owns_interner;
+    size_t nominal_lock_depth;
+    HashTable sub_types;
+    size_t sub_type_cache_hits;
+    size_t sub_type_cache_misses;
+    HashTable substitutions;
+    Substitution last_substitution;
+    HashTable replaced_types;
+    size_t replace_cache_hits;
+    size_t replace_cache_misses;
+    HashTable instances;
+    size_t instance_cache_hits;
+    size_t instance_cache_misses;
+    TypeMapPool type_maps;
+    MemPool scratch_pool;
+    MemPool* mem_pool;
     const Type* star_kind;
     const Type* prim_types[PRIM_TYPE_COUNT];
     const Type* top_type;
@@ -33,9 +115,79 @@ struct TypeTable {
     const Type* error_type;
 };
 
+#define TYPE_SIZE(member) (offsetof(Type, member) + sizeof(((Type*)NULL)->member))
+
+static size_t get_type_size(TypeTag tag) {
+    switch (tag) {
+        case KIND_ARROW:     return TYPE_SIZE(arrow);
+        case TYPE_ALIAS:     return TYPE_SIZE(alias);
+        case TYPE_ENUM:      return TYPE_SIZE(enum_);
+        case TYPE_STRUCT:    return TYPE_SIZE(struct_);
+        case TYPE_SIGNATURE: return TYPE_SIZE(signature);
+        case TYPE_TUPLE:     return TYPE_SIZE(tuple);
+        case TYPE_PROJ:      return TYPE_SIZE(proj);
+        case TYPE_APP:       return TYPE_SIZE(app);
+        case TYPE_FUN:       return TYPE_SIZE(fun);
+        case TYPE_ARRAY:     return TYPE_SIZE(array);
+        case TYPE_PTR:       return TYPE_SIZE(ptr);
+        case TYPE_VAR:       return TYPE_SIZE(var);
+        default:             return offsetof(Type, arrow);
+    }
+}
+
+static inline uint32_t make_type_id(TypeTable* type_table) {
+    size_t id = atomic_fetch_add_explicit(&type_table->interner->type_count, 1, memory_order_relaxed);
+    assert(id < UINT32_MAX && "too many types");
+    return id;
+}
+
+static inline bool is_concurrent_interner(const TypeInterner* interner) {
+    return interner->shard_count > 1;
+}
+
+static inline TypeShard* lock_type_shard(TypeInterner* interner, HashCode hash) {
+    // The lower bits of the hash select the bucket within the shard
+    TypeShard* shard = &interner->shards[(hash >> 16) % interner->shard_count];
+    if (is_concurrent_interner(interner))
+        pthread_mutex_lock(&shard->mutex);
+    return shard;
+}
+
+static inline void unlock_type_shard(TypeInterner* interner, TypeShard* shard) {
+    if (is_concurrent_interner(interner))
+        pthread_mutex_unlock(&shard->mutex);
+}
+
+// The thread that holds the lock on nominal types can take it again, since applying a module can
+// apply it again (see `make_app_type()`). Type tables are used by one thread only, so they keep
+// track of how many times their thread took the lock.
+static inline void lock_nominal_types(TypeTable* type_table) {
+    if (is_concurrent_interner(type_table->interner) && type_table->nominal_lock_depth++ == 0)
+        pthread_mutex_lock(&type_table->interner->nominal_mutex);
+}
+
+static inline void unlock_nominal_types(TypeTable* type_table) {
+    if (is_concurrent_interner(type_table->interner) && --type_table->nominal_lock_depth == 0)
+        pthread_mutex_unlock(&type_table->interner->nominal_mutex);
+}
+
+static const char* make_interned_str(TypeTable* type_table, const char* str) {
+    TypeInterner* interner = type_table->interner;
+    if (is_concurrent_interner(interner))
+        pthread_mutex_lock(&interner->str_mutex);
+    const char* interned_str = make_str(&interner->str_pool, str);
+    if (is_concurrent_interner(interner))
+        pthread_mutex_unlock(&interner->str_mutex);
+    return interned_str;
+}
+
+static inline uint64_t get_var_mask(const Type* var) {
+    return UINT64_C(1) << (var->id % 64);
+}
+
 static HashCode hash_types(HashCode hash, const Type** types, size_t count) {
     for (size_t i = 0; i < count; ++i)
-        hash = hash_uint64(hash, types[i]->id);
+        hash = hash_uint32(hash, types[i]->id);
     return hash;
 }
 
@@ -59,39 +211,39 @@ static HashCode hash_type(HashCode hash, const Type* type) {
         case TYPE_ALIAS:
             hash = hash_type_params(hash, type);
             hash = hash_str(hash, type->alias.name);
-            hash = hash_uint64(hash, type->alias.aliased_type->id);
+            hash = hash_uint32(hash, type->alias.aliased_type->id);
             break;
         case TYPE_PROJ:
-            hash = hash_uint64(hash, type->proj.projected_type->id);
+            hash = hash_uint32(hash, type->proj.projected_type->id);
             hash = hash_uint64(hash, (uint64_t)type->proj.index);
             break;
         case TYPE_TUPLE:
             hash = hash_types(hash, type->tuple.args, type->tuple.arg_count);
             break;
         case TYPE_APP:
-            hash = hash_uint64(hash, type->app.applied_type->id);
+            hash = hash_uint32(hash, type->app.applied_type->id);
             hash = hash_types(hash, type->app.args, type->app.arg_count);
             break;
         case KIND_ARROW:
             hash = hash_types(hash, type->arrow.kind_params, type->arrow.kind_param_count);
-            hash = hash_uint64(hash, type->arrow.body->id);
+            hash = hash_uint32(hash, type->arrow.body->id);
             break;
         case TYPE_FUN:
             hash = hash_type_params(hash, type);
-            hash = hash_uint64(hash, type->fun.dom->id);
-            hash = hash_uint64(hash, type->fun.codom->id);
+            hash = hash_uint32(hash, type->fun.dom->id);
+            hash = hash_uint32(hash, type->fun.codom->id);
             break;
         case TYPE_ARRAY:
-            hash = hash_uint64(hash, type->array.elem_type->id);
+            hash = hash_uint32(hash, type->array.elem_type->id);
             if (type->array.size)
-                hash = hash_uint64(hash, type->array.size->id);
+                hash = hash_uint32(hash, type->array.size->id);
             break;
         case TYPE_VAR:
             hash = hash_str(hash, type->var.name);
             break;
         case TYPE_PTR:
             hash = hash_uint8(hash, type->ptr.is_const);
-            hash = hash_uint64(hash, type->ptr.pointed_type->id);
+            hash = hash_uint32(hash, type->ptr.pointed_type->id);
             break;
         default:
             assert(false && "invalid type");
@@ -103,7 +255,7 @@ static HashCode hash_type(HashCode hash, const Type* type) {
 static bool compare_type_params(const Type* left, const Type* right) {
     return
         get_type_param_count(left) == get_type_param_count(right) &&
-        !memcpy(get_type_params(left), get_type_params(right),
+        !memcmp(get_type_params(left), get_type_params(right),
             sizeof(Type*) * get_type_param_count(left));
 }
 
@@ -122,10 +274,11 @@ static bool compare_types(const Type* left, const Type* right) {
         case TYPE_ERROR:
             break;
         case TYPE_TUPLE: {
+            // The unit type has no arguments, and is compared when other type tables are created
             return
                 left->tuple.arg_count == right->tuple.arg_count &&
-                !memcmp(left->tuple.args, right->tuple.args,
-                    sizeof(Type*) * left->tuple.arg_count);
+                (left->tuple.arg_count == 0 ||
+                 !memcmp(left->tuple.args, right->tuple.args, sizeof(Type*) * left->tuple.arg_count));
         }
         case TYPE_ALIAS: {
             return
@@ -149,7 +302,7 @@ static bool compare_types(const Type* left, const Type* right) {
             return
                 left->arrow.body == right->arrow.body &&
                 left->arrow.kind_param_count == right->arrow.kind_param_count &&
-                !memcpy(left->arrow.kind_params, right->arrow.kind_params,
+                !memcmp(left->arrow.kind_params, right->arrow.kind_params,
                     sizeof(Type*) * left->arrow.kind_param_count);
         }
         case TYPE_FUN: {
@@ -176,6 +329,8 @@ static bool compare_types(const Type* left, const Type* right) {
 }
 
 static const Type** copy_types(TypeTable* type_table, const Type** types, size_t count) {
+    if (count == 0)
+        return NULL;
     const Type** types_copy = alloc_from_mem_pool(type_table->mem_pool, sizeof(Type*) * count);
     memcpy(types_copy, types, sizeof(Type*) * count);
     return types_copy;
@@ -185,20 +340,17 @@ static bool compare_types_wrapper(const void* left, const void* right) {
     return compare_types(*(const Type**)left, *(const Type**)right);
 }
 
-static const Type* get_or_insert_type(TypeTable* type_table, const Type* type) {
-    assert(!is_nominal_type(type->tag));
-
-    uint32_t hash = hash_type(hash_init(), type);
-    const Type** type_ptr = find_in_hash_table(&type_table->types, &type, hash, sizeof(Type*), compare_types_wrapper);
-    if (type_ptr)
-        return *type_ptr;
-
-    Type* new_type = alloc_from_mem_pool(type_table->mem_pool, sizeof(Type));
-    memcpy(new_type, type, sizeof(Type));
-    new_type->id = type_table->type_count++;
+static Type* insert_type(TypeTable* type_table, const Type* type) {
+    Type* new_type = alloc_from_mem_pool(type_table->mem_pool, get_type_size(type->tag));
+    memcpy(new_type, type, get_type_size(type->tag));
+    new_type->id = make_type_id(type_table);
+    if (is_kind_level_type(new_type))
+        atomic_fetch_add_explicit(&type_table->interner->kind_count, 1, memory_order_relaxed);
 
     new_type->contains_error = type->tag == TYPE_ERROR;
     new_type->contains_unknown = type->tag == TYPE_UNKNOWN;
+    new_type->contains_var = type->tag == TYPE_PROJ;
+    new_type->var_mask = type->tag == TYPE_PROJ ? type->proj.projected_type->var_mask : 0;
     switch (type->tag) {
         case TYPE_TUPLE:
             new_type->tuple.args =
@@ -206,6 +358,8 @@ static const Type* get_or_insert_type(TypeTable* type_table, const Type* type) {
             for (size_t i = 0; i < type->tuple.arg_count; ++i) {
                 new_type->contains_error   |= type->tuple.args[i]->contains_error;
                 new_type->contains_unknown |= type->tuple.args[i]->contains_unknown;
+                new_type->contains_var     |= type->tuple.args[i]->contains_var;
+                new_type->var_mask         |= type->tuple.args[i]->var_mask;
             }
             break;
         case TYPE_ALIAS:
@@ -213,20 +367,34 @@ static const Type* get_or_insert_type(TypeTable* type_table, const Type* type) {
                 copy_types(type_table, type->alias.type_params, type->alias.type_param_count);
             new_type->contains_error   |= type->alias.aliased_type->contains_error;
             new_type->contains_unknown |= type->alias.aliased_type->contains_unknown;
+            new_type->contains_var     |= type->alias.aliased_type->contains_var;
+            new_type->var_mask         |= type->alias.aliased_type->var_mask;
             break;
         case TYPE_APP:
             new_type->app.args =
                 copy_types(type_table, type->app.args, type->app.arg_count);
             new_type->contains_error |= type->app.applied_type->contains_error;
             new_type->contains_unknown |= type->app.applied_type->contains_unknown;
+            new_type->contains_var |= type->app.applied_type->contains_var;
+            new_type->var_mask |= type->app.applied_type->var_mask;
             for (size_t i = 0; i < type->app.arg_count; ++i) {
                 new_type->contains_error   |= type->app.args[i]->contains_error;
                 new_type->contains_unknown |= type->app.args[i]->contains_unknown;
+                new_type->contains_var     |= type->app.args[i]->contains_var;
+                new_type->var_mask         |= type->app.args[i]->var_mask;
             }
             break;
         case TYPE_ARRAY:
             new_type->contains_error   |= type->array.elem_type->contains_error;
             new_type->contains_unknown |= type->array.elem_type->contains_unknown;
+            new_type->contains_var     |= type->array.elem_type->contains_var;
+            new_type->contains_var     |= type->array.size && type->array.size->contains_var;
+            new_type->var_mask         |= type->array.elem_type->var_mask;
+            new_type->var_mask         |= type->array.size ? type->array.size->var_mask : 0;
+            break;
+        case TYPE_PTR:
+            new_type->contains_var |= type->ptr.pointed_type->contains_var;
+            new_type->var_mask |= type->ptr.pointed_type->var_mask;
             break;
         case TYPE_FUN:
             new_type->fun.type_params =
@@ -235,6 +403,10 @@ static const Type* get_or_insert_type(TypeTable* type_table, const Type* type) {
             new_type->contains_error |= type->fun.codom->contains_error;
             new_type->contains_unknown |= type->fun.dom->contains_unknown;
             new_type->contains_unknown |= type->fun.codom->contains_unknown;
+            new_type->contains_var |= type->fun.dom->contains_var;
+            new_type->contains_var |= type->fun.codom->contains_var;
+            new_type->var_mask |= type->fun.dom->var_mask;
+            new_type->var_mask |= type->fun.codom->var_mask;
             break;
         case KIND_ARROW:
             new_type->arrow.kind_params =
@@ -244,24 +416,126 @@ static const Type* get_or_insert_type(TypeTable* type_table, const Type* type) {
             break;
     }
 
-    if (!insert_in_hash_table(&type_table->types, &new_type, hash, sizeof(Type*), compare_types_wrapper))
-        assert(false && "cannot insert type in type table");
     return new_type;
 }
 
+static const Type* get_or_insert_type(TypeTable* type_table, const Type* type) {
+    assert(!is_nominal_type(type->tag));
+
+    uint32_t hash = hash_type(hash_init(), type);
+    TypeShard* shard = lock_type_shard(type_table->interner, hash);
+    const Type** type_ptr = find_in_hash_table(&shard->types, &type, hash, sizeof(Type*), compare_types_wrapper);
+    const Type* new_type = type_ptr ? *type_ptr : NULL;
+    if (!new_type) {
+        new_type = insert_type(type_table, type);
+        if (!insert_in_hash_table(&shard->types, &new_type, hash, sizeof(Type*), compare_types_wrapper))
+            assert(false && "cannot insert type in type table");
+    }
+    unlock_type_shard(type_table->interner, shard);
+    return new_type;
+}
+
+static bool compare_shallow_types(const void* left, const void* right) {
+    const ShallowType* left_type = left, *right_type = right;
+    return
+        left_type->tag == right_type->tag &&
+        left_type->child_count == right_type->child_count &&
+        left_type->is_const == right_type->is_const &&
+        !memcmp(left_type->child_ids, right_type->child_ids, sizeof(uint32_t) * left_type->child_count);
+}
+
+static inline HashCode hash_shallow_type(const ShallowType* shallow_type) {
+    HashCode hash = hash_uint8(hash_init(), shallow_type->tag);
+    hash = hash_uint8(hash, shallow_type->is_const);
+    for (size_t i = 0; i < shallow_type->child_count; ++i)
+        hash = hash_uint32(hash, shallow_type->child_ids[i]);
+    return hash;
+}
+
+static inline const Type* get_or_insert_shallow_type(
+    TypeTable* type_table,
+    ShallowType* shallow_type,
+    const Type* type)
+{
+    HashCode hash = hash_shallow_type(shallow_type);
+    TypeShard* shard = lock_type_shard(type_table->interner, hash);
+    const ShallowType* found = find_in_hash_table(&shard->shallow_types,
+        shallow_type, hash, sizeof(ShallowType), compare_shallow_types);
+    if (found)
+        shallow_type->type = found->type;
+    else {
+        shallow_type->type = insert_type(type_table, type);
+        if (!insert_in_hash_table(&shard->shallow_types,
+            shallow_type, hash, sizeof(ShallowType), compare_shallow_types))
+            assert(false && "cannot insert shallow type in type table");
+    }
+    unlock_type_shard(type_table->interner, shard);
+    return shallow_type->type;
+}
+
 static TypeTag get_first_prim_type_tag() {
 #define f(name, ...) return TYPE_##name;
     PRIM_TYPE_LIST(f)
 #undef f
 }
 
+TypeInterner* new_type_interner(size_t shard_count) {
+    assert(shard_count > 0);
+    TypeInterner* interner = malloc_or_die(sizeof(TypeInterner));
+    interner->shards = malloc_or_die(sizeof(TypeShard) * shard_count);
+    interner->shard_count = shard_count;
+    for (size_t i = 0; i < shard_count; ++i) {
+        pthread_mutex_init(&interner->shards[i].mutex, NULL);
+        interner->shards[i].types = new_hash_table(sizeof(Type*));
+        interner->shards[i].shallow_types = new_hash_table(sizeof(ShallowType));
+    }
+    pthread_mutex_init(&interner->str_mutex, NULL);
+    pthread_mutex_init(&interner->nominal_mutex, NULL);
+    interner->mem_pool = new_mem_pool();
+    interner->str_pool = new_str_pool(&interner->mem_pool);
+    atomic_init(&interner->type_count, 0);
+    atomic_init(&interner->kind_count, 0);
+    return interner;
+}
+
+void free_type_interner(TypeInterner* interner) {
+    for (size_t i = 0; i < interner->shard_count; ++i) {
+        pthread_mutex_destroy(&interner->shards[i].mutex);
+        free_hash_table(&interner->shards[i].types);
+        free_hash_table(&interner->shards[i].shallow_types);
+    }
+    pthread_mutex_destroy(&interner->str_mutex);
+    pthread_mutex_destroy(&interner->nominal_mutex);
+    free_str_pool(&interner->str_pool);
+    free_mem_pool(&interner->mem_pool);
+    free(interner->shards);
+    free(interner);
+}
+
 TypeTable* new_type_table(MemPool* mem_pool) {
+    TypeTable* type_table = new_shared_type_table(new_type_interner(1), mem_pool);
+    type_table->owns_interner = true;
+    return type_table;
+}
+
+TypeTable* new_shared_type_table(TypeInterner* interner, MemPool* mem_pool) {
     TypeTable* type_table = malloc_or_die(sizeof(TypeTable));
-    type_table->types = new_hash_table(sizeof(Type*));
-    type_table->str_pool = new_str_pool(mem_pool);
+    type_table->interner = interner;
+    type_table->owns_interner = false;
+    type_table->nominal_lock_depth = 0;
+    type_table->sub_types = new_hash_table(sizeof(SubTypeResult));
+    type_table->sub_type_cache_hits = type_table->sub_type_cache_misses = 0;
+    type_table->substitutions = new_hash_table(sizeof(Substitution));
+    type_table->last_substitution = (Substitution) { .id = SIZE_MAX };
+    type_table->replaced_types = new_hash_table(sizeof(ReplacedType));
+    type_table->replace_cache_hits = type_table->replace_cache_misses = 0;
+    type_table->instances = new_hash_table(sizeof(Instance));
+    type_table->instance_cache_hits = type_table->instance_cache_misses = 0;
+    type_table->type_maps = new_type_map_pool();
+    type_table->scratch_pool = new_mem_pool();
     type_table->mem_pool = mem_pool;
-    type_table->type_count = 0;
 
+    // Builtin types are interned like other types, and are thus shared by all the type tables
     const Type* star = type_table->star_kind = get_or_insert_type(type_table, &(Type) { .tag = KIND_STAR });
     for (size_t i = 0; i < PRIM_TYPE_COUNT; ++i)
         type_table->prim_types[i] = get_or_insert_type(type_table, &(Type) { .tag = get_first_prim_type_tag() + i, .kind = star });
@@ -275,11 +549,95 @@ TypeTable* new_type_table(MemPool* mem_pool) {
 }
 
 void free_type_table(TypeTable* type_table) {
-    free_hash_table(&type_table->types);
-    free_str_pool(&type_table->str_pool);
+    if (type_table->owns_interner)
+        free_type_interner(type_table->interner);
+    free_hash_table(&type_table->sub_types);
+    free_hash_table(&type_table->substitutions);
+    free_hash_table(&type_table->replaced_types);
+    free_hash_table(&type_table->instances);
+    free_type_map_pool(&type_table->type_maps);
+    free_mem_pool(&type_table->scratch_pool);
     free(type_table);
 }
 
+static HashTableStats merge_hash_table_stats(HashTableStats left, HashTableStats right) {
+    size_t size = left.size + right.size;
+    return (HashTableStats) {
+        .capacity = left.capacity + right.capacity,
+        .size = size,
+        .load_factor = (double)size / (double)(left.capacity + right.capacity),
+        .avg_probe_length = size > 0
+            ? (left.avg_probe_length * (double)left.size + right.avg_probe_length * (double)right.size) / (double)size
+            : 0,
+        .max_probe_length = left.max_probe_length > right.max_probe_length
+            ? left.max_probe_length : right.max_probe_length
+    };
+}
+
+TypeInterner* get_type_interner(const TypeTable* type_table) {
+    return type_table->interner;
+}
+
+TypeTableStats get_type_table_stats(const TypeTable* type_table) {
+    TypeInterner* interner = type_table->interner;
+    HashTableStats types = get_hash_table_stats(&interner->shards[0].types);
+    HashTableStats shallow_types = get_hash_table_stats(&interner->shards[0].shallow_types);
+    for (size_t i = 1; i < interner->shard_count; ++i) {
+        types = merge_hash_table_stats(types, get_hash_table_stats(&interner->shards[i].types));
+        shallow_types = merge_hash_table_stats(shallow_types, get_hash_table_stats(&interner->shards[i].shallow_types));
+    }
+    size_t type_count = atomic_load_explicit(&interner->type_count, memory_order_relaxed);
+    size_t kind_count = atomic_load_explicit(&interner->kind_count, memory_order_relaxed);
+    return (TypeTableStats) {
+        .type_count = type_count - kind_count,
+        .kind_count = kind_count,
+        .str_count = interner->str_pool.hash_table.size,
+        .types = types,
+        .strs = get_hash_table_stats(&interner->str_pool.hash_table),
+        .shallow_types = shallow_types,
+        .sub_types = get_hash_table_stats(&type_table->sub_types),
+        .sub_type_cache_hits = type_table->sub_type_cache_hits,
+        .sub_type_cache_misses = type_table->sub_type_cache_misses,
+        .substitution_count = type_table->substitutions.size,
+        .replace_cache_hits = type_table->replace_cache_hits,
+        .replace_cache_misses = type_table->replace_cache_misses,
+        .instance_count = type_table->instances.size,
+        .instance_cache_hits = type_table->instance_cache_hits,
+        .instance_cache_misses = type_table->instance_cache_misses
+    };
+}
+
+static bool compare_sub_type_results(const void* left, const void* right) {
+    const SubTypeResult* left_result = left, *right_result = right;
+    return
+        left_result->left_id == right_result->left_id &&
+        left_result->right_id == right_result->right_id;
+}
+
+static inline HashCode hash_sub_type_result(const SubTypeResult* result) {
+    return hash_uint32(hash_uint32(hash_init(), result->left_id), result->right_id);
+}
+
+const bool* find_sub_type_result(TypeTable* type_table, const Type* left, const Type* right) {
+    assert(!left->contains_var && !right->contains_var);
+    SubTypeResult key = { .left_id = left->id, .right_id = right->id };
+    const SubTypeResult* result = find_in_hash_table(&type_table->sub_types,
+        &key, hash_sub_type_result(&key), sizeof(SubTypeResult), compare_sub_type_results);
+    if (!result) {
+        type_table->sub_type_cache_misses++;
+        return NULL;
+    }
+    type_table->sub_type_cache_hits++;
+    return &result->is_sub_type;
+}
+
+void insert_sub_type_result(TypeTable* type_table, const Type* left, const Type* right, bool is_sub_type) {
+    assert(!left->contains_var && !right->contains_var);
+    SubTypeResult result = { .left_id = left->id, .right_id = right->id, .is_sub_type = is_sub_type };
+    insert_in_hash_table(&type_table->sub_types,
+        &result, hash_sub_type_result(&result), sizeof(SubTypeResult), compare_sub_type_results);
+}
+
 const Type* make_star_kind(TypeTable* type_table) {
     return type_table->star_kind;
 }
@@ -308,26 +666,29 @@ const Type* make_type_ctor_kind(
     size_t type_param_count,
     const Kind* body)
 {
-    const Type** kind_params = malloc_or_die(sizeof(Type*) * type_param_count);
+    MemPoolState scratch_state = save_mem_pool(&type_table->scratch_pool);
+    const Type** kind_params = alloc_from_mem_pool(&type_table->scratch_pool, sizeof(Type*) * type_param_count);
     for (size_t i = 0; i < type_param_count; ++i)
         kind_params[i] = type_params[i]->kind;
     const Type* arrow_kind = make_arrow_kind(
         type_table, kind_params, type_param_count, body);
-    free(kind_params);
+    restore_mem_pool(&type_table->scratch_pool, scratch_state);
     return arrow_kind;
 }
 
 static Type* alloc_type_with_tag(TypeTable* type_table, TypeTag tag) {
-    Type* type = alloc_from_mem_pool(type_table->mem_pool, sizeof(Type));
-    memset(type, 0, sizeof(Type));
-    type->id = type_table->type_count++;
+    Type* type = alloc_from_mem_pool(type_table->mem_pool, get_type_size(tag));
+    memset(type, 0, get_type_size(tag));
+    type->id = make_type_id(type_table);
     type->tag = tag;
     return type;
 }
 
 Type* make_var_type(TypeTable* type_table, const char* name) {
     Type* var = alloc_type_with_tag(type_table, TYPE_VAR);
-    var->var.name = make_str(&type_table->str_pool, name);
+    var->contains_var = true;
+    var->var_mask = get_var_mask(var);
+    var->var.name = make_interned_str(type_table, name);
     var->var.variance = TYPE_INVARIANT;
     return var;
 }
@@ -347,13 +708,13 @@ Type* make_var_type_with_value(TypeTable* type_table, const char* name, const Ty
 
 Type* make_struct_type(TypeTable* type_table, const char* name) {
     Type* struct_type = alloc_type_with_tag(type_table, TYPE_STRUCT);
-    struct_type->struct_.name = make_str(&type_table->str_pool, name);
+    struct_type->struct_.name = make_interned_str(type_table, name);
     return struct_type;
 }
 
 Type* make_enum_type(TypeTable* type_table, const char* name) {
     Type* enum_type = alloc_type_with_tag(type_table, TYPE_ENUM);
-    enum_type->enum_.name = make_str(&type_table->str_pool, name);
+    enum_type->enum_.name = make_interned_str(type_table, name);
     return enum_type;
 }
 
@@ -370,7 +731,7 @@ static StructField* copy_and_sort_struct_fields(
     StructField* fields_copy = alloc_from_mem_pool(type_table->mem_pool, sizeof(StructField) * field_count);
     memcpy(fields_copy, fields, sizeof(StructField) * field_count);
     for (size_t i = 0; i < field_count; ++i)
-        fields_copy[i].name = make_str(&type_table->str_pool, fields[i].name);
+        fields_copy[i].name = make_interned_str(type_table, fields[i].name);
     qsort(fields_copy, field_count, sizeof(StructField), compare_struct_fields_by_name);
     return fields_copy;
 }
@@ -385,14 +746,72 @@ static const Type** copy_type_params(
     return type_params_copy;
 }
 
+static inline const Type* get_inheritance_parent(const Type* type) {
+    if (type->tag == TYPE_STRUCT)
+        return type->struct_.super_type;
+    if (type->tag == TYPE_ENUM)
+        return type->enum_.sub_type;
+    return NULL;
+}
+
+static inline size_t get_inheritance_display_capacity(size_t depth) {
+    // Displays are allocated with a power-of-two capacity, so that it can be recomputed from the depth
+    size_t capacity = 1;
+    while (capacity <= depth)
+        capacity *= 2;
+    return capacity;
+}
+
+static const Type** make_inheritance_display(TypeTable* type_table, const Type* type, size_t depth) {
+    // When the parent is not a type application, the display of the parent is a prefix of the display
+    // of the type. It can then be extended in place, provided no other child of the parent did it before.
+    // This keeps the size of the displays linear in the length of long inheritance chains. Children
+    // of the same parent can be created on different threads, so the entry is claimed under a lock.
+    const Type* parent = get_inheritance_parent(type);
+    const Type** parent_ancestors = parent ? get_type_ancestors(parent) : NULL;
+    if (parent_ancestors && depth < get_inheritance_display_capacity(depth - 1)) {
+        lock_nominal_types(type_table);
+        bool is_claimed = !parent_ancestors[depth];
+        if (is_claimed)
+            parent_ancestors[depth] = type;
+        unlock_nominal_types(type_table);
+        if (is_claimed)
+            return parent_ancestors;
+    }
+
+    size_t capacity = get_inheritance_display_capacity(depth);
+    const Type** ancestors = alloc_from_mem_pool(type_table->mem_pool, sizeof(Type*) * capacity);
+    memset(ancestors, 0, sizeof(Type*) * capacity);
+    ancestors[depth] = type;
+
+    // Walk up the inheritance chain until an ancestor that already has a display is found,
+    // expressing every ancestor in terms of the type parameters of the given type.
+    const Type* ancestor = get_inheritance_parent(type);
+    for (size_t i = depth; i-- > 0;) {
+        ancestors[i] = ancestor;
+        const Type* ancestor_type = get_applied_type(ancestor);
+        const Type** ancestor_ancestors = get_type_ancestors(ancestor_type);
+        if (ancestor_ancestors) {
+            for (size_t j = 0; j < i; ++j)
+                ancestors[j] = replace_types_using_type_app(type_table, ancestor_ancestors[j], ancestor);
+            break;
+        }
+        ancestor = replace_types_using_type_app(type_table, get_inheritance_parent(ancestor_type), ancestor);
+    }
+    return ancestors;
+}
+
 const Type* seal_struct_type(TypeTable* type_table, Type* type) {
     assert(type->tag == TYPE_STRUCT);
     assert(!type->struct_.is_sealed);
     assert(type->kind);
     type->struct_.fields =
         copy_and_sort_struct_fields(type_table, type->struct_.fields, type->struct_.field_count);
+    type->struct_.field_index = make_member_index(type_table->mem_pool, type->struct_.field_count);
     type->struct_.type_params =
         copy_type_params(type_table, type->struct_.type_params, type->struct_.type_param_count);
+    type->struct_.inheritance_depth = get_type_inheritance_depth(type);
+    type->struct_.ancestors = make_inheritance_display(type_table, type, type->struct_.inheritance_depth);
 #ifndef NDEBUG
     type->struct_.is_sealed = true;
 #endif
@@ -407,7 +826,7 @@ static EnumOption* copy_and_sort_enum_options(
     EnumOption* options_copy = alloc_from_mem_pool(type_table->mem_pool, sizeof(EnumOption) * option_count);
     memcpy(options_copy, options, sizeof(EnumOption) * option_count);
     for (size_t i = 0; i < option_count; ++i)
-        options_copy[i].name = make_str(&type_table->str_pool, options[i].name);
+        options_copy[i].name = make_interned_str(type_table, options[i].name);
     qsort(options_copy, option_count, sizeof(EnumOption), compare_enum_options_by_name);
     return options_copy;
 }
@@ -418,8 +837,11 @@ const Type* seal_enum_type(TypeTable* type_table, Type* type) {
     assert(type->kind);
     type->enum_.options =
         copy_and_sort_enum_options(type_table, type->enum_.options, type->enum_.option_count);
+    type->enum_.option_index = make_member_index(type_table->mem_pool, type->enum_.option_count);
     type->enum_.type_params =
         copy_type_params(type_table, type->enum_.type_params, type->enum_.type_param_count);
+    type->enum_.inheritance_depth = get_type_inheritance_depth(type);
+    type->enum_.ancestors = make_inheritance_display(type_table, type, type->enum_.inheritance_depth);
 #ifndef NDEBUG
     type->enum_.is_sealed = true;
 #endif
@@ -443,6 +865,7 @@ const Type* seal_signature_type(TypeTable* type_table, Type* type) {
     assert(type->kind);
     type->signature.vars =
         copy_and_sort_signature_vars(type_table, type->signature.vars, type->signature.var_count);
+    type->signature.var_index = make_member_index(type_table->mem_pool, type->signature.var_count);
     type->signature.type_params =
         copy_type_params(type_table, type->signature.type_params, type->signature.type_param_count);
 #ifndef NDEBUG
@@ -458,11 +881,17 @@ static Type* copy_var_type(TypeTable* type_table, const Type* var) {
         : make_var_type_with_kind(type_table, var->var.name, var->kind);
 }
 
+// Copies of nominal types share the member arrays of the original type, along with their index.
+// Member arrays are never modified in place once sealed: Substitutions duplicate them before
+// changing an element (see `replace_nominal_type_contents()`).
+
 Type* copy_signature_type(TypeTable* type_table, const Type* signature) {
     assert(signature->tag == TYPE_SIGNATURE);
+    assert(signature->signature.is_sealed);
     Type* signature_copy = make_signature_type(type_table);
 
-    const Type** vars = malloc_or_die(sizeof(Type*) * signature->signature.var_count);
+    // Variables are copied in the same order, so that the copy stays sorted by name.
+    const Type** vars = alloc_from_mem_pool(type_table->mem_pool, sizeof(Type*) * signature->signature.var_count);
     for (size_t i = 0; i < signature->signature.var_count; ++i)
         vars[i] = copy_var_type(type_table, signature->signature.vars[i]);
 
@@ -470,58 +899,54 @@ Type* copy_signature_type(TypeTable* type_table, const Type* signature) {
     signature_copy->signature.type_params = signature->signature.type_params;
     signature_copy->signature.var_count = signature->signature.var_count;
     signature_copy->signature.vars = vars;
+    signature_copy->signature.var_index = signature->signature.var_index;
     signature_copy->kind = signature->kind;
-    seal_signature_type(type_table, signature_copy);
-    free(vars);
-
+#ifndef NDEBUG
+    signature_copy->signature.is_sealed = true;
+#endif
     return signature_copy;
 }
 
 Type* copy_struct_type(TypeTable* type_table, const Type* struct_type) {
     assert(struct_type->tag == TYPE_STRUCT);
+    assert(struct_type->struct_.is_sealed);
     Type* struct_copy = make_struct_type(type_table, struct_type->struct_.name);
-
-    StructField* fields = malloc_or_die(sizeof(StructField) * struct_type->struct_.field_count);
-    memcpy(fields, struct_type->struct_.fields, sizeof(StructField) * struct_type->struct_.field_count);
-
     struct_copy->struct_.type_params = struct_type->struct_.type_params;
     struct_copy->struct_.type_param_count = struct_type->struct_.type_param_count;
     struct_copy->struct_.field_count = struct_type->struct_.field_count;
-    struct_copy->struct_.fields = fields;
+    struct_copy->struct_.fields = struct_type->struct_.fields;
+    struct_copy->struct_.field_index = struct_type->struct_.field_index;
     struct_copy->kind = struct_type->kind;
-    seal_struct_type(type_table, struct_copy);
-    free(fields);
-
+    struct_copy->struct_.inheritance_depth = get_type_inheritance_depth(struct_copy);
+    struct_copy->struct_.ancestors =
+        make_inheritance_display(type_table, struct_copy, struct_copy->struct_.inheritance_depth);
+#ifndef NDEBUG
+    struct_copy->struct_.is_sealed = true;
+#endif
     return struct_copy;
 }
 
 Type* copy_enum_type(TypeTable* type_table, const Type* enum_type) {
     assert(enum_type->tag == TYPE_ENUM);
+    assert(enum_type->enum_.is_sealed);
     Type* enum_copy = make_enum_type(type_table, enum_type->enum_.name);
-
-    EnumOption* options = malloc_or_die(sizeof(EnumOption) * enum_type->enum_.option_count);
-    memcpy(options, enum_type->enum_.options, sizeof(EnumOption) * enum_type->enum_.option_count);
-
     enum_copy->enum_.type_params = enum_type->enum_.type_params;
     enum_copy->enum_.type_param_count = enum_type->enum_.type_param_count;
     enum_copy->enum_.option_count = enum_type->enum_.option_count;
-    enum_copy->enum_.options = options;
+    enum_copy->enum_.options = enum_type->enum_.options;
+    enum_copy->enum_.option_index = enum_type->enum_.option_index;
     enum_copy->kind = enum_type->kind;
-    seal_enum_type(type_table, enum_copy);
-    free(options);
-
+    enum_copy->enum_.inheritance_depth = get_type_inheritance_depth(enum_copy);
+    enum_copy->enum_.ancestors =
+        make_inheritance_display(type_table, enum_copy, enum_copy->enum_.inheritance_depth);
+#ifndef NDEBUG
+    enum_copy->enum_.is_sealed = true;
+#endif
     return enum_copy;
 }
 
 static Type* deep_copy_signature_type(TypeTable*, const Type*, TypeMap*);
 
-static Type* seal_signature_type_and_free_vars(TypeTable* type_table, Type* signature) {
-    const Type** vars = signature->signature.vars;
-    seal_signature_type(type_table, signature);
-    free(vars);
-    return signature;
-}
-
 static Type* deep_copy_nominal_type(TypeTable* type_table, const Type* nominal_type, TypeMap* type_map) {
     switch (nominal_type->tag) {
         case TYPE_STRUCT:
@@ -529,8 +954,7 @@ static Type* deep_copy_nominal_type(TypeTable* type_table, const Type* nominal_t
         case TYPE_ENUM:
             return copy_enum_type(type_table, nominal_type);
         case TYPE_SIGNATURE:
-            return seal_signature_type_and_free_vars(type_table,
-                deep_copy_signature_type(type_table, nominal_type, type_map));
+            return deep_copy_signature_type(type_table, nominal_type, type_map);
         default:
             assert(false && "invalid nominal type");
             return (Type*)nominal_type;
@@ -538,30 +962,19 @@ static Type* deep_copy_nominal_type(TypeTable* type_table, const Type* nominal_t
 }
 
 static Type* deep_copy_signature_type(TypeTable* type_table, const Type* signature, TypeMap* type_map) {
-    assert(signature->tag == TYPE_SIGNATURE);
-    Type* signature_copy = make_signature_type(type_table);
-
-    Type** vars = malloc_or_die(sizeof(Type*) * signature->signature.var_count);
+    Type* signature_copy = copy_signature_type(type_table, signature);
     for (size_t i = 0; i < signature->signature.var_count; ++i) {
-        vars[i] = copy_var_type(type_table, signature->signature.vars[i]);
-        insert_in_type_map(type_map, signature->signature.vars[i], (void*)vars[i]);
+        Type* var = (Type*)signature_copy->signature.vars[i];
+        insert_in_type_map(type_map, signature->signature.vars[i], var);
 
         // Copy modules signatures
-        if (vars[i]->kind->tag == TYPE_SIGNATURE)
-            vars[i]->kind = deep_copy_nominal_type(type_table, vars[i]->kind, type_map);
+        if (var->kind->tag == TYPE_SIGNATURE)
+            var->kind = deep_copy_nominal_type(type_table, var->kind, type_map);
 
         // Copy type definitions
-        if (vars[i]->var.value && is_nominal_type(vars[i]->var.value->tag))
-            vars[i]->var.value = deep_copy_nominal_type(type_table, vars[i]->var.value, type_map);
+        if (var->var.value && is_nominal_type(var->var.value->tag))
+            var->var.value = deep_copy_nominal_type(type_table, var->var.value, type_map);
     }
-
-    signature_copy->signature.type_param_count = signature->signature.type_param_count;
-    signature_copy->signature.type_params = signature->signature.type_params;
-    signature_copy->signature.var_count = signature->signature.var_count;
-    signature_copy->signature.vars = (const Type**)vars;
-    signature_copy->kind = signature->kind;
-
-    // Note: This returns a signature in unsealed state, variables have to be freed after sealing.
     return signature_copy;
 }
 
@@ -595,11 +1008,17 @@ const Type* make_tuple_type(TypeTable* type_table, const Type** args, size_t arg
         return type_table->unit_type;
     if (arg_count == 1)
         return args[0];
-    return get_or_insert_type(type_table, &(Type) {
+    const Type* type = &(Type) {
         .tag = TYPE_TUPLE,
         .kind = make_star_kind(type_table),
         .tuple = { .args = args, .arg_count = arg_count }
-    });
+    };
+    if (arg_count > MAX_SHALLOW_CHILD_COUNT)
+        return get_or_insert_type(type_table, type);
+    ShallowType shallow_type = { .tag = TYPE_TUPLE, .child_count = arg_count };
+    for (size_t i = 0; i < arg_count; ++i)
+        shallow_type.child_ids[i] = args[i]->id;
+    return get_or_insert_shallow_type(type_table, &shallow_type, type);
 }
 
 const Type* make_unit_type(TypeTable* type_table) {
@@ -608,20 +1027,46 @@ const Type* make_unit_type(TypeTable* type_table) {
 
 static inline void replace_nominal_type_contents(TypeTable*, Type*, TypeMap*);
 
+static inline void* copy_members_on_write(
+    TypeTable* type_table,
+    void* members,
+    const void* shared_members,
+    size_t member_count,
+    size_t member_size)
+{
+    if (members != shared_members)
+        return members;
+    void* members_copy = alloc_from_mem_pool(type_table->mem_pool, member_size * member_count);
+    memcpy(members_copy, shared_members, member_size * member_count);
+    return members_copy;
+}
+
 static inline void replace_struct_fields(TypeTable* type_table, Type* struct_type, TypeMap* type_map) {
     assert(struct_type->tag == TYPE_STRUCT);
+    StructField* fields = struct_type->struct_.fields;
     for (size_t i = 0; i < struct_type->struct_.field_count; ++i) {
-        struct_type->struct_.fields[i].type = replace_types_with_map(
-            type_table, struct_type->struct_.fields[i].type, type_map);
+        const Type* field_type = replace_types_with_map(type_table, fields[i].type, type_map);
+        if (field_type == fields[i].type)
+            continue;
+        fields = copy_members_on_write(type_table,
+            fields, struct_type->struct_.fields, struct_type->struct_.field_count, sizeof(StructField));
+        fields[i].type = field_type;
     }
+    struct_type->struct_.fields = fields;
 }
 
 static inline void replace_enum_options(TypeTable* type_table, Type* enum_type, TypeMap* type_map) {
     assert(enum_type->tag == TYPE_ENUM);
+    EnumOption* options = enum_type->enum_.options;
     for (size_t i = 0; i < enum_type->enum_.option_count; ++i) {
-        enum_type->enum_.options[i].param_type = replace_types_with_map(
-            type_table, enum_type->enum_.options[i].param_type, type_map);
+        const Type* param_type = replace_types_with_map(type_table, options[i].param_type, type_map);
+        if (param_type == options[i].param_type)
+            continue;
+        options = copy_members_on_write(type_table,
+            options, enum_type->enum_.options, enum_type->enum_.option_count, sizeof(EnumOption));
+        options[i].param_type = param_type;
     }
+    enum_type->enum_.options = options;
 }
 
 static inline void replace_signature_var(TypeTable* type_table, Type* var, TypeMap* type_map) {
@@ -680,16 +1125,17 @@ const Type* make_app_type(TypeTable* type_table, const Type* applied_type, const
             .tag = TYPE_APP,
             .app = { .applied_type = applied_type, .args = args, .arg_count = arg_count }
         });
+        // Other threads must wait until the signature is complete, since it is modified after
+        // being attached to the application.
+        lock_nominal_types(type_table);
         if (!app_type->kind) {
             // Lazily compute the result of applying the module to the given type arguments, so that
             // successive calls to `make_app_type()` get the same kind.
-            TypeMap type_map = new_type_map();
+            TypeMap type_map = acquire_type_map(&type_table->type_maps);
             Type* signature = deep_copy_signature_type(type_table, applied_type->kind, &type_map);
-
             signature->kind = make_star_kind(type_table);
             signature->signature.type_param_count = 0;
             signature->signature.type_params = NULL;
-            seal_signature_type_and_free_vars(type_table, signature);
 
             // The signature can appear within its own variables, since some modules hide the
             // implementations of types. For instance the module
@@ -723,8 +1169,9 @@ const Type* make_app_type(TypeTable* type_table, const Type* applied_type, const
             }
 
             replace_signature_vars(type_table, signature, &type_map);
-            free_type_map(&type_map);
+            release_type_map(&type_table->type_maps, &type_map);
         }
+        unlock_nominal_types(type_table);
         return app_type;
     } else {
         assert(false && "invalid type in type application");
@@ -749,7 +1196,12 @@ const Type* make_sized_array_type(TypeTable* type_table, const Type* elem_type,
 }
 
 const Type* make_ptr_type(TypeTable* type_table, bool is_const, const Type* pointed_type) {
-    return get_or_insert_type(type_table, &(Type) {
+    return get_or_insert_shallow_type(type_table, &(ShallowType) {
+        .tag = TYPE_PTR,
+        .is_const = is_const,
+        .child_ids = { pointed_type->id },
+        .child_count = 1
+    }, &(Type) {
         .tag = TYPE_PTR,
         .kind = make_star_kind(type_table),
         .ptr = { .is_const = is_const, .pointed_type = pointed_type }
@@ -794,7 +1246,7 @@ const Type* make_mod_type(TypeTable* type_table, const char* name, Type* signatu
         signature->signature.type_params,
         signature->signature.type_param_count);
 
-    TypeMap type_map = new_type_map();
+    TypeMap type_map = acquire_type_map(&type_table->type_maps);
     // Map variables to their projection
     for (size_t i = 0; i < signature->signature.var_count; ++i) {
         insert_in_type_map(&type_map,
@@ -802,7 +1254,7 @@ const Type* make_mod_type(TypeTable* type_table, const char* name, Type* signatu
             (void*)make_proj_type(type_table, applied_type, i));
     }
     replace_signature_vars(type_table, signature, &type_map);
-    free_type_map(&type_map);
+    release_type_map(&type_table->type_maps, &type_map);
     return mod_type;
 }
 
@@ -817,7 +1269,7 @@ const Type* make_alias_type(
         .tag = TYPE_ALIAS,
         .kind = make_type_ctor_kind(type_table, type_params, type_param_count, aliased_type->kind),
         .alias = {
-            .name = make_str(&type_table->str_pool, name),
+            .name = make_interned_str(type_table, name),
             .type_params = type_params,
             .type_param_count = type_param_count,
             .aliased_type = aliased_type,
@@ -832,7 +1284,7 @@ const Type* make_poly_fun_type(
     const Type* dom,
     const Type* codom)
 {
-    return get_or_insert_type(type_table, &(Type) {
+    const Type* type = &(Type) {
         .tag = TYPE_FUN,
         .kind = make_star_kind(type_table),
         .fun = {
@@ -841,7 +1293,14 @@ const Type* make_poly_fun_type(
             .dom = dom,
             .codom = codom
         }
-    });
+    };
+    if (type_param_count > 0)
+        return get_or_insert_type(type_table, type);
+    return get_or_insert_shallow_type(type_table, &(ShallowType) {
+        .tag = TYPE_FUN,
+        .child_ids = { dom->id, codom->id },
+        .child_count = 2
+    }, type);
 }
 
 const Type* replace_types_with_map(
@@ -849,6 +1308,10 @@ const Type* replace_types_with_map(
     const Type* type,
     TypeMap* type_map)
 {
+    // Types that do not contain any of the variables to replace are left untouched
+    if (!(type->var_mask & type_map->var_mask))
+        return type;
+
     switch (type->tag) {
 #define f(name, ...) case TYPE_##name:
     PRIM_TYPE_LIST(f)
@@ -863,11 +1326,12 @@ const Type* replace_types_with_map(
         case TYPE_ENUM:
             return type;
         case TYPE_TUPLE: {
-            const Type** types = malloc(sizeof(Type*) * type->tuple.arg_count);
+            MemPoolState scratch_state = save_mem_pool(&type_table->scratch_pool);
+            const Type** types = alloc_from_mem_pool(&type_table->scratch_pool, sizeof(Type*) * type->tuple.arg_count);
             for (size_t i = 0, n = type->tuple.arg_count; i < n; ++i)
                 types[i] = replace_types_with_map(type_table, type->tuple.args[i], type_map);
             type = make_tuple_type(type_table, types, type->tuple.arg_count);
-            free(types);
+            restore_mem_pool(&type_table->scratch_pool, scratch_state);
             return type;
         }
         case TYPE_ALIAS:
@@ -881,13 +1345,14 @@ const Type* replace_types_with_map(
                 replace_types_with_map(type_table, type->proj.projected_type, type_map),
                 type->proj.index);
         case TYPE_APP: {
-            const Type** args = malloc(sizeof(Type*) * type->app.arg_count);
+            MemPoolState scratch_state = save_mem_pool(&type_table->scratch_pool);
+            const Type** args = alloc_from_mem_pool(&type_table->scratch_pool, sizeof(Type*) * type->app.arg_count);
             for (size_t i = 0, n = type->app.arg_count; i < n; ++i)
                 args[i] = replace_types_with_map(type_table, type->app.args[i], type_map);
             type = make_app_type(type_table,
                 replace_types_with_map(type_table, type->app.applied_type, type_map),
                 args, type->app.arg_count);
-            free(args);
+            restore_mem_pool(&type_table->scratch_pool, scratch_state);
             return type;
         }
         case TYPE_FUN: {
@@ -920,6 +1385,53 @@ const Type* replace_types_with_map(
     }
 }
 
+static bool compare_substitutions(const void* left, const void* right) {
+    const Substitution* left_substitution = left, *right_substitution = right;
+    return
+        left_substitution->type_count == right_substitution->type_count &&
+        !memcmp(left_substitution->from, right_substitution->from, sizeof(Type*) * left_substitution->type_count) &&
+        !memcmp(left_substitution->to, right_substitution->to, sizeof(Type*) * left_substitution->type_count);
+}
+
+static size_t get_or_insert_substitution(
+    TypeTable* type_table,
+    const Type** from,
+    const Type** to,
+    size_t type_count)
+{
+    // Consecutive calls often use the same substitution (e.g. to get the type of every field of an
+    // applied structure), and comparing it with the last one is cheaper than hashing it.
+    Substitution substitution = { .from = from, .to = to, .type_count = type_count };
+    if (type_table->last_substitution.id != SIZE_MAX &&
+        compare_substitutions(&type_table->last_substitution, &substitution))
+        return type_table->last_substitution.id;
+
+    HashCode hash = hash_types(hash_types(hash_init(), from, type_count), to, type_count);
+    const Substitution* substitution_ptr = find_in_hash_table(&type_table->substitutions,
+        &substitution, hash, sizeof(Substitution), compare_substitutions);
+    if (substitution_ptr)
+        return (type_table->last_substitution = *substitution_ptr).id;
+
+    substitution.from = copy_types(type_table, from, type_count);
+    substitution.to = copy_types(type_table, to, type_count);
+    substitution.id = type_table->substitutions.size;
+    if (!insert_in_hash_table(&type_table->substitutions,
+        &substitution, hash, sizeof(Substitution), compare_substitutions))
+        assert(false && "cannot insert substitution in type table");
+    return (type_table->last_substitution = substitution).id;
+}
+
+static bool compare_replaced_types(const void* left, const void* right) {
+    const ReplacedType* left_type = left, *right_type = right;
+    return
+        left_type->type_id == right_type->type_id &&
+        left_type->substitution_id == right_type->substitution_id;
+}
+
+static inline HashCode hash_replaced_type(const ReplacedType* replaced_type) {
+    return hash_uint32(hash_uint32(hash_init(), replaced_type->type_id), replaced_type->substitution_id);
+}
+
 const Type* replace_types(
     TypeTable* type_table,
     const Type* type,
@@ -927,10 +1439,101 @@ const Type* replace_types(
     const Type** to,
     size_t mapped_type_count)
 {
-    TypeMap type_map = new_type_map();
+    uint64_t var_mask = 0;
+    for (size_t i = 0; i < mapped_type_count; ++i)
+        var_mask |= from[i]->var_mask;
+    if (!(type->var_mask & var_mask))
+        return type;
+
+    ReplacedType key = {
+        .type_id = type->id,
+        .substitution_id = get_or_insert_substitution(type_table, from, to, mapped_type_count)
+    };
+    const ReplacedType* cached_type = find_in_hash_table(&type_table->replaced_types,
+        &key, hash_replaced_type(&key), sizeof(ReplacedType), compare_replaced_types);
+    if (cached_type) {
+        type_table->replace_cache_hits++;
+        return cached_type->replaced_type;
+    }
+    type_table->replace_cache_misses++;
+
+    TypeMap type_map = acquire_type_map(&type_table->type_maps);
     for (size_t i = 0; i < mapped_type_count; ++i)
         insert_in_type_map(&type_map, from[i], (void*)to[i]);
-    const Type* replaced_type = replace_types_with_map(type_table, type, &type_map);
-    free_type_map(&type_map);
-    return replaced_type;
+    key.replaced_type = replace_types_with_map(type_table, type, &type_map);
+    release_type_map(&type_table->type_maps, &type_map);
+
+    insert_in_hash_table(&type_table->replaced_types,
+        &key, hash_replaced_type(&key), sizeof(ReplacedType), compare_replaced_types);
+    return key.replaced_type;
+}
+
+static bool compare_instances(const void* left, const void* right) {
+    const Instance* left_instance = left, *right_instance = right;
+    return
+        left_instance->app_type_id == right_instance->app_type_id &&
+        left_instance->applied_type_id == right_instance->applied_type_id;
+}
+
+static inline HashCode hash_instance(const Instance* instance) {
+    return hash_uint32(hash_uint32(hash_init(), instance->app_type_id), instance->applied_type_id);
+}
+
+const Type** get_instance_member_types(TypeTable* type_table, const Type* app_type) {
+    assert(app_type->tag == TYPE_APP);
+    const Type* applied_type = get_applied_type(app_type);
+    assert(applied_type->tag == TYPE_STRUCT || applied_type->tag == TYPE_ENUM);
+    if (!get_type_ancestors(applied_type))
+        return NULL;
+
+    bool is_struct = applied_type->tag == TYPE_STRUCT;
+    Instance key = {
+        .app_type_id = app_type->id,
+        .applied_type_id = applied_type->id,
+        .members = is_struct ? (const void*)applied_type->struct_.fields : (const void*)applied_type->enum_.options
+    };
+    Instance* instance = find_in_hash_table(&type_table->instances,
+        &key, hash_instance(&key), sizeof(Instance), compare_instances);
+    if (instance && instance->members == key.members) {
+        type_table->instance_cache_hits++;
+        return instance->member_types;
+    }
+    type_table->instance_cache_misses++;
+
+    size_t member_count = is_struct ? applied_type->struct_.field_count : applied_type->enum_.option_count;
+    const Type** type_params = is_struct ? applied_type->struct_.type_params : applied_type->enum_.type_params;
+    key.member_types = alloc_from_mem_pool(type_table->mem_pool, sizeof(Type*) * member_count);
+    for (size_t i = 0; i < member_count; ++i) {
+        key.member_types[i] = replace_types(type_table,
+            is_struct ? applied_type->struct_.fields[i].type : applied_type->enum_.options[i].param_type,
+            type_params,
+            app_type->app.args,
+            app_type->app.arg_count);
+    }
+
+    // Computing the member types may have modified the cache, so the entry needs to be searched again.
+    instance = find_in_hash_table(&type_table->instances,
+        &key, hash_instance(&key), sizeof(Instance), compare_instances);
+    if (instance)
+        *instance = key;
+    else {
+        insert_in_hash_table(&type_table->instances,
+            &key, hash_instance(&key), sizeof(Instance), compare_instances);
+    }
+    return key.member_types;
+}
+
+const Type** lookup_signature_var(TypeTable* type_table, const Type* signature, const char* name) {
+    record_member_lookup(type_table->mem_pool, signature);
+    return find_signature_var(signature, name);
+}
+
+const StructField* lookup_struct_field(TypeTable* type_table, const Type* struct_type, const char* name) {
+    record_member_lookup(type_table->mem_pool, struct_type);
+    return find_struct_field(struct_type, name);
+}
+
+const EnumOption* lookup_enum_option(TypeTable* type_table, const Type* enum_type, const char* name) {
+    record_member_lookup(type_table->mem_pool, enum_type);
+    return find_enum_option(enum_type, name);
 }
@@ -2,18 +2,60 @@
 #define FU_LANG_TYPE_TABLE_H
 
 #include "fu/lang/types.h"
+#include "fu/core/hash_table.h"
 
 /*
  * The type-table is a factory object for types. Types that can be structurally compared are
  * created uniquely, and other (i.e. nominal) types are created every time they are requested.
+ * Pointers, monomorphic functions, and small tuples are interned separately, by the identifiers
+ * of their children.
+ * The type-table also remembers the result of subtyping queries between types that do not contain
+ * variables, since those results cannot change once computed. Similarly, the result of replacing
+ * types in another type is remembered for each (interned) substitution, and the member types of
+ * applied structures and enumerations are computed once per application.
+ *
+ * Several type tables can share the same interner, in which case they create the same structural
+ * types and strings, and hand out distinct type identifiers. Each of them can then be used by a
+ * different thread, with its own memory pool and caches, provided that the interner has more than
+ * one shard (an interner with a single shard never locks). The memory pools of all the type
+ * tables that share an interner must outlive it, since types created by one type table can be
+ * returned to the others.
  */
 
 typedef struct TypeTable TypeTable;
+typedef struct TypeInterner TypeInterner;
 typedef struct MemPool MemPool;
 
+typedef struct {
+    size_t type_count;      // Number of types created, excluding kinds
+    size_t kind_count;      // Number of kinds created
+    size_t str_count;       // Number of interned strings
+    HashTableStats types;   // Occupancy of the table of structural types
+    HashTableStats strs;    // Occupancy of the string pool
+    HashTableStats shallow_types;   // Occupancy of the table of pointers, functions, and small tuples
+    HashTableStats sub_types;       // Occupancy of the subtyping cache
+    size_t sub_type_cache_hits;     // Number of subtyping queries answered by the cache
+    size_t sub_type_cache_misses;   // Number of subtyping queries that had to be computed
+    size_t substitution_count;      // Number of distinct substitutions passed to `replace_types()`
+    size_t replace_cache_hits;      // Number of substitutions answered by the cache
+    size_t replace_cache_misses;    // Number of substitutions that had to be computed
+    size_t instance_count;          // Number of applied structures or enumerations instantiated
+    size_t instance_cache_hits;     // Number of member type queries answered by the cache
+    size_t instance_cache_misses;   // Number of member type queries that had to be computed
+} TypeTableStats;
+
+TypeInterner* new_type_interner(size_t shard_count);
+void free_type_interner(TypeInterner*);
+
+/// Creates a type table with its own interner, which has a single shard.
 TypeTable* new_type_table(MemPool*);
+TypeTable* new_shared_type_table(TypeInterner*, MemPool*);
 void free_type_table(TypeTable*);
 
+TypeInterner* get_type_interner(const TypeTable*);
+
+TypeTableStats get_type_table_stats(const TypeTable*);
+
 //====================================== KINDS ===========================================
 
 const Kind* make_star_kind(TypeTable*);
@@ -75,6 +117,13 @@ const Type* make_poly_fun_type(
     const Type* dom,
     const Type* codom);
 
+//=================================== SUBTYPING CACHE ====================================
+
+/// Returns the cached result of the subtyping query `left <: right`, or `NULL` if it is not known.
+/// The types must not contain variables.
+const bool* find_sub_type_result(TypeTable*, const Type* left, const Type* right);
+void insert_sub_type_result(TypeTable*, const Type* left, const Type* right, bool);
+
 //================================== SUBSTITUTION ========================================
 
 const Type* replace_types_with_map(TypeTable*, const Type*, TypeMap*);
@@ -86,4 +135,19 @@ const Type* replace_types(
     const Type** to,
     size_t type_count);
 
+//================================== MEMBER LOOKUP =======================================
+
+/// Same as `find_signature_var()`, `find_struct_field()` and `find_enum_option()`, except that the
+/// lookup is recorded, so that the members of the types that are looked up often get indexed.
+const Type** lookup_signature_var(TypeTable*, const Type* signature, const char* name);
+const StructField* lookup_struct_field(TypeTable*, const Type* struct_type, const char* name);
+const EnumOption* lookup_enum_option(TypeTable*, const Type* enum_type, const char* name);
+
+//================================= INSTANTIATIONS =======================================
+
+/// Returns the field types (for structures) or option parameter types (for enumerations) of an
+/// application of a structure or enumeration, with the type arguments of the application
+/// substituted. Returns `NULL` if the applied type is not sealed yet.
+const Type** get_instance_member_types(TypeTable*, const Type* app_type);
+
 #endif
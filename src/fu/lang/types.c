@@ -1,74 +1,109 @@
 #include "fu/lang/types.h"
 #include "fu/lang/type_table.h"
+#include "fu/core/mem_pool.h"
 #include "fu/core/hash.h"
 #include "fu/core/utils.h"
 #include "fu/core/alloc.h"
 
 #include <assert.h>
 #include <string.h>
+#include <stdatomic.h>
 
 //================================== TYPE MAPS/SETS ======================================
 
-typedef struct TypeMapElem {
-    const Type* from;
-    void* to;
-} TypeMapElem;
+#define MIN_TYPE_MAP_CAPACITY 8
 
 TypeMap new_type_map(void) {
-    return (TypeMap) { .hash_table = new_hash_table(sizeof(TypeMapElem)) };
+    return (TypeMap) { .indices = NULL };
 }
 
 TypeSet new_type_set(void) {
-    return (TypeSet) { .hash_table = new_hash_table(sizeof(Type*)) };
+    return (TypeSet) { .type_map = new_type_map() };
 }
 
-void clear_type_map(TypeMap* type_map) { clear_hash_table(&type_map->hash_table); }
-void clear_type_set(TypeSet* type_set) { clear_hash_table(&type_set->hash_table); }
-void free_type_map(TypeMap* type_map) { free_hash_table(&type_map->hash_table); }
-void free_type_set(TypeSet* type_set) { free_hash_table(&type_set->hash_table); }
+void clear_type_map(TypeMap* type_map) { type_map->elem_count = 0; type_map->var_mask = 0; }
+void clear_type_set(TypeSet* type_set) { clear_type_map(&type_set->type_map); }
+void free_type_set(TypeSet* type_set) { free_type_map(&type_set->type_map); }
 
-static bool compare_type_map_elems(const void* left, const void* right) {
-    return ((TypeMapElem*)left)->from == ((TypeMapElem*)right)->from;
+void free_type_map(TypeMap* type_map) {
+    free(type_map->indices);
+    free(type_map->elems);
 }
 
-bool insert_in_type_map(TypeMap* type_map, const Type* from, void* to) {
-    assert(from != NULL);
-    return insert_in_hash_table(&type_map->hash_table,
-        &(TypeMapElem) { .from = from, .to = to },
-        hash_uint64(hash_init(), from->id),
-        sizeof(TypeMapElem),
-        compare_type_map_elems);
+static inline TypeMapElem* find_type_map_elem(const TypeMap* type_map, const Type* from) {
+    // Indices may be stale, since clearing the map does not reset them.
+    if (from->id >= type_map->index_count)
+        return NULL;
+    uint32_t index = type_map->indices[from->id];
+    if (index >= type_map->elem_count || type_map->elems[index].from != from)
+        return NULL;
+    return &type_map->elems[index];
 }
 
-static bool compare_type_set_elems(const void* left, const void* right) {
-    return *(Type**)left == *(Type**)right;
+static void grow_type_map_indices(TypeMap* type_map, size_t min_index_count) {
+    size_t index_count = type_map->index_count > 0 ? type_map->index_count : MIN_TYPE_MAP_CAPACITY;
+    while (index_count < min_index_count)
+        index_count *= 2;
+    type_map->indices = realloc_or_die(type_map->indices, sizeof(uint32_t) * index_count);
+    memset(type_map->indices + type_map->index_count, 0,
+        sizeof(uint32_t) * (index_count - type_map->index_count));
+    type_map->index_count = index_count;
 }
 
-bool insert_in_type_set(TypeSet* type_set, const Type* from) {
+bool insert_in_type_map(TypeMap* type_map, const Type* from, void* to) {
     assert(from != NULL);
-    return insert_in_hash_table(&type_set->hash_table,
-        &from,
-        hash_uint64(hash_init(), from->id),
-        sizeof(Type*),
-        compare_type_set_elems);
+    if (find_type_map_elem(type_map, from))
+        return false;
+    if (from->id >= type_map->index_count)
+        grow_type_map_indices(type_map, from->id + 1);
+    if (type_map->elem_count >= type_map->elem_capacity) {
+        type_map->elem_capacity = type_map->elem_capacity > 0 ? type_map->elem_capacity * 2 : MIN_TYPE_MAP_CAPACITY;
+        type_map->elems = realloc_or_die(type_map->elems, sizeof(TypeMapElem) * type_map->elem_capacity);
+    }
+    assert(type_map->elem_count < UINT32_MAX);
+    type_map->indices[from->id] = type_map->elem_count;
+    type_map->elems[type_map->elem_count++] = (TypeMapElem) { .from = from, .to = to };
+    type_map->var_mask |= from->var_mask;
+    return true;
+}
+
+bool insert_in_type_set(TypeSet* type_set, const Type* from) {
+    return insert_in_type_map(&type_set->type_map, from, NULL);
 }
 
 void* find_in_type_map(const TypeMap* type_map, const Type* from) {
-    const TypeMapElem* elem = find_in_hash_table(&type_map->hash_table,
-        &(TypeMapElem) { .from = from },
-        hash_uint64(hash_init(), from->id),
-        sizeof(TypeMapElem),
-        compare_type_map_elems);
+    const TypeMapElem* elem = find_type_map_elem(type_map, from);
     return elem ? elem->to : NULL;
 }
 
 bool find_in_type_set(const TypeSet* type_set, const Type* from) {
-    const TypeMapElem* elem = find_in_hash_table(&type_set->hash_table,
-        &(TypeMapElem) { .from = from },
-        hash_uint64(hash_init(), from->id),
-        sizeof(Type*),
-        compare_type_set_elems);
-    return elem != NULL;
+    return find_type_map_elem(&type_set->type_map, from) != NULL;
+}
+
+TypeMapPool new_type_map_pool(void) {
+    return (TypeMapPool) { .type_maps = NULL };
+}
+
+void free_type_map_pool(TypeMapPool* type_map_pool) {
+    for (size_t i = 0; i < type_map_pool->type_map_count; ++i)
+        free_type_map(&type_map_pool->type_maps[i]);
+    free(type_map_pool->type_maps);
+}
+
+TypeMap acquire_type_map(TypeMapPool* type_map_pool) {
+    if (type_map_pool->type_map_count == 0)
+        return new_type_map();
+    return type_map_pool->type_maps[--type_map_pool->type_map_count];
+}
+
+void release_type_map(TypeMapPool* type_map_pool, TypeMap* type_map) {
+    if (type_map_pool->type_map_count >= type_map_pool->type_map_capacity) {
+        type_map_pool->type_map_capacity = type_map_pool->type_map_capacity > 0 ? type_map_pool->type_map_capacity * 2 : 1;
+        type_map_pool->type_maps = realloc_or_die(type_map_pool->type_maps,
+            sizeof(TypeMap) * type_map_pool->type_map_capacity);
+    }
+    clear_type_map(type_map);
+    type_map_pool->type_maps[type_map_pool->type_map_count++] = *type_map;
 }
 
 //========================================================================================
@@ -135,6 +170,8 @@ bool is_tuple_like_struct_type(const Type* type) {
     return type->tag == TYPE_STRUCT && type->struct_.is_tuple_like;
 }
 
+static bool is_sub_composite_type(TypeTable*, const Type*, const Type*);
+
 bool is_sub_type(TypeTable* type_table, const Type* left, const Type* right) {
     left = resolve_type(left);
     right = resolve_type(right);
@@ -152,6 +189,18 @@ bool is_sub_type(TypeTable* type_table, const Type* left, const Type* right) {
         (is_float_type(left->tag) && is_float_type(right->tag)))
         return get_prim_type_bitwidth(left->tag) <= get_prim_type_bitwidth(right->tag);
 
+    // The result can only be cached when it cannot change as variables get bound
+    if (left->contains_var || right->contains_var)
+        return is_sub_composite_type(type_table, left, right);
+    const bool* cached_result = find_sub_type_result(type_table, left, right);
+    if (cached_result)
+        return *cached_result;
+    bool result = is_sub_composite_type(type_table, left, right);
+    insert_sub_type_result(type_table, left, right, result);
+    return result;
+}
+
+static bool is_sub_composite_type(TypeTable* type_table, const Type* left, const Type* right) {
     if (is_sub_struct_type(type_table, left, right))
         return true;
 
@@ -178,7 +227,7 @@ bool is_sub_type(TypeTable* type_table, const Type* left, const Type* right) {
     return false;
 }
 
-static const Type* replace_types_using_type_app(
+const Type* replace_types_using_type_app(
     TypeTable* type_table,
     const Type* type,
     const Type* type_app)
@@ -215,6 +264,14 @@ static bool is_sub_struct_or_super_enum_type(
     if (left_depth < right_depth)
         return false;
 
+    // Sealed types have an inheritance display, which directly gives the ancestor at the right depth
+    const Type** ancestors = get_type_ancestors(left_struct_or_enum);
+    if (ancestors && left_depth > right_depth) {
+        if (get_applied_type(ancestors[right_depth]) != right_struct_or_enum)
+            return false;
+        return replace_types_using_type_app(type_table, ancestors[right_depth], left) == right;
+    }
+
     while (left_depth > right_depth) {
         left = replace_types_using_type_app(type_table,
             type_tag == TYPE_STRUCT
@@ -242,6 +299,9 @@ const Type* get_struct_field_type(TypeTable* type_table, const Type* type, size_
     assert(struct_type->tag == TYPE_STRUCT);
     if (type->tag != TYPE_APP)
         return struct_type->struct_.fields[i].type;
+    const Type** member_types = get_instance_member_types(type_table, type);
+    if (member_types)
+        return member_types[i];
     return replace_types(type_table,
         struct_type->struct_.fields[i].type,
         struct_type->struct_.type_params,
@@ -254,9 +314,12 @@ const Type* get_enum_option_param_type(TypeTable* type_table, const Type* type,
     assert(enum_type->tag == TYPE_ENUM);
     if (type->tag != TYPE_APP)
         return enum_type->enum_.options[i].param_type;
+    const Type** member_types = get_instance_member_types(type_table, type);
+    if (member_types)
+        return member_types[i];
     return replace_types(type_table,
         enum_type->enum_.options[i].param_type,
-        enum_type->struct_.type_params,
+        enum_type->enum_.type_params,
         type->app.args,
         type->app.arg_count);
 }
@@ -328,7 +391,11 @@ size_t get_type_inheritance_depth(const Type* type) {
     size_t depth = 0;
     while (true) {
         type = get_applied_type(type);
-        if (type->tag == TYPE_STRUCT && type->struct_.super_type)
+        if (type->tag == TYPE_STRUCT && type->struct_.ancestors)
+            return depth + type->struct_.inheritance_depth;
+        else if (type->tag == TYPE_ENUM && type->enum_.ancestors)
+            return depth + type->enum_.inheritance_depth;
+        else if (type->tag == TYPE_STRUCT && type->struct_.super_type)
             type = type->struct_.super_type, depth++;
         else if (type->tag == TYPE_ENUM && type->enum_.sub_type)
             type = type->enum_.sub_type, depth++;
@@ -338,6 +405,14 @@ size_t get_type_inheritance_depth(const Type* type) {
     return depth;
 }
 
+const Type** get_type_ancestors(const Type* type) {
+    if (type->tag == TYPE_STRUCT)
+        return type->struct_.ancestors;
+    if (type->tag == TYPE_ENUM)
+        return type->enum_.ancestors;
+    return NULL;
+}
+
 static inline TypeVariance invert_variance(TypeVariance variance) {
     if (variance == TYPE_COVARIANT) return TYPE_CONTRAVARIANT;
     if (variance == TYPE_CONTRAVARIANT) return TYPE_COVARIANT;
@@ -461,8 +536,147 @@ static inline void* safe_bsearch(
     return bsearch(key, elems, elem_count, elem_size, compare_elems);
 }
 
+// Member indices are open-addressing hash tables with linear probing, whose capacity is a power
+// of two that is at least twice the number of members. Each entry holds the position of a member
+// plus one, or zero if the entry is empty. Building the table costs about as much as a binary search
+// per member, so it is only built once the members have been looked up often enough: Large types
+// that are looked up a few times, such as the structures of a long inheritance chain, never pay for
+// it. Lookups may happen on several threads, hence the atomics.
+#define MIN_INDEXED_MEMBER_COUNT 16
+#define MEMBERS_PER_INDEXED_LOOKUP 8
+
+struct MemberIndex {
+    _Atomic(const uint32_t*) entries;
+    atomic_size_t lookup_count;
+};
+
+typedef const char* (*GetMemberName)(const void*, size_t);
+
+static const char* get_signature_var_name(const void* vars, size_t i) { return ((const Type**)vars)[i]->var.name; }
+static const char* get_struct_field_name(const void* fields, size_t i) { return ((const StructField*)fields)[i].name; }
+static const char* get_enum_option_name(const void* options, size_t i) { return ((const EnumOption*)options)[i].name; }
+
+static inline size_t get_member_index_capacity(size_t member_count) {
+    size_t capacity = MIN_INDEXED_MEMBER_COUNT;
+    while (capacity < member_count * 2)
+        capacity *= 2;
+    return capacity;
+}
+
+MemberIndex* make_member_index(MemPool* mem_pool, size_t member_count) {
+    if (member_count < MIN_INDEXED_MEMBER_COUNT)
+        return NULL;
+    assert(member_count < UINT32_MAX);
+    MemberIndex* member_index = alloc_from_mem_pool(mem_pool, sizeof(MemberIndex));
+    atomic_init(&member_index->entries, NULL);
+    atomic_init(&member_index->lookup_count, 0);
+    return member_index;
+}
+
+static const uint32_t* make_member_index_entries(
+    MemPool* mem_pool,
+    const void* members,
+    size_t member_count,
+    GetMemberName get_member_name)
+{
+    size_t capacity = get_member_index_capacity(member_count);
+    uint32_t* entries = alloc_from_mem_pool(mem_pool, sizeof(uint32_t) * capacity);
+    memset(entries, 0, sizeof(uint32_t) * capacity);
+    for (size_t i = 0; i < member_count; ++i) {
+        size_t j = hash_str(hash_init(), get_member_name(members, i)) & (capacity - 1);
+        while (entries[j] != 0)
+            j = (j + 1) & (capacity - 1);
+        entries[j] = i + 1;
+    }
+    return entries;
+}
+
+static inline bool get_indexed_members(
+    const Type* type,
+    MemberIndex** member_index,
+    const void** members,
+    size_t* member_count,
+    GetMemberName* get_member_name)
+{
+    switch (type->tag) {
+        case TYPE_SIGNATURE:
+            *member_index = type->signature.var_index;
+            *members = type->signature.vars;
+            *member_count = type->signature.var_count;
+            *get_member_name = get_signature_var_name;
+            break;
+        case TYPE_STRUCT:
+            *member_index = type->struct_.field_index;
+            *members = type->struct_.fields;
+            *member_count = type->struct_.field_count;
+            *get_member_name = get_struct_field_name;
+            break;
+        case TYPE_ENUM:
+            *member_index = type->enum_.option_index;
+            *members = type->enum_.options;
+            *member_count = type->enum_.option_count;
+            *get_member_name = get_enum_option_name;
+            break;
+        default:
+            assert(false && "invalid nominal type");
+            return false;
+    }
+    return *member_index != NULL;
+}
+
+void record_member_lookup(MemPool* mem_pool, const Type* type) {
+    MemberIndex* member_index;
+    const void* members;
+    size_t member_count;
+    GetMemberName get_member_name;
+    if (!get_indexed_members(type, &member_index, &members, &member_count, &get_member_name))
+        return;
+    // Only the lookup that reaches the threshold builds the table, the others use a binary search
+    // until it is published
+    size_t lookup_count = atomic_fetch_add_explicit(&member_index->lookup_count, 1, memory_order_relaxed);
+    if (lookup_count + 1 != member_count / MEMBERS_PER_INDEXED_LOOKUP)
+        return;
+    const uint32_t* entries = make_member_index_entries(mem_pool, members, member_count, get_member_name);
+    atomic_store_explicit(&member_index->entries, entries, memory_order_release);
+}
+
+static inline bool find_in_member_index(
+    const MemberIndex* member_index,
+    const void* members,
+    size_t member_count,
+    size_t member_size,
+    GetMemberName get_member_name,
+    const char* name,
+    const void** member)
+{
+    // Returns `false` if the table of the index has not been built yet
+    const uint32_t* entries = member_index
+        ? atomic_load_explicit(&member_index->entries, memory_order_acquire) : NULL;
+    if (!entries)
+        return false;
+    size_t capacity = get_member_index_capacity(member_count);
+    size_t j = hash_str(hash_init(), name) & (capacity - 1);
+    *member = NULL;
+    for (; entries[j] != 0; j = (j + 1) & (capacity - 1)) {
+        size_t i = entries[j] - 1;
+        if (!strcmp(get_member_name(members, i), name)) {
+            *member = ((const char*)members) + member_size * i;
+            break;
+        }
+    }
+    return true;
+}
+
 const Type** find_signature_var(const Type* signature, const char* name) {
     assert(signature->tag == TYPE_SIGNATURE);
+    const void* var;
+    if (find_in_member_index(signature->signature.var_index,
+        signature->signature.vars,
+        signature->signature.var_count,
+        sizeof(Type*),
+        get_signature_var_name,
+        name, &var))
+        return (const Type**)var;
     const Type* key = &(Type) { .var.name = name };
     return safe_bsearch(&key,
         signature->signature.vars,
@@ -473,6 +687,14 @@ const Type** find_signature_var(const Type* signature, const char* name) {
 
 const StructField* find_struct_field(const Type* struct_type, const char* name) {
     assert(struct_type->tag == TYPE_STRUCT);
+    const void* field;
+    if (find_in_member_index(struct_type->struct_.field_index,
+        struct_type->struct_.fields,
+        struct_type->struct_.field_count,
+        sizeof(StructField),
+        get_struct_field_name,
+        name, &field))
+        return field;
     return safe_bsearch(&(StructField) { .name = name },
         struct_type->struct_.fields,
         struct_type->struct_.field_count,
@@ -482,6 +704,14 @@ const StructField* find_struct_field(const Type* struct_type, const char* name)
 
 const EnumOption* find_enum_option(const Type* enum_type, const char* name) {
     assert(enum_type->tag == TYPE_ENUM);
+    const void* option;
+    if (find_in_member_index(enum_type->enum_.option_index,
+        enum_type->enum_.options,
+        enum_type->enum_.option_count,
+        sizeof(EnumOption),
+        get_enum_option_name,
+        name, &option))
+        return option;
     return safe_bsearch(&(EnumOption) { .name = name },
         enum_type->enum_.options,
         enum_type->enum_.option_count,
@@ -2,10 +2,10 @@
 #define FU_LANG_TYPES_H
 
 #include "fu/core/format.h"
-#include "fu/core/hash_table.h"
 
 #include <stddef.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 /*
  * Front-end types, including a simple module system based on M. Lillibridge's translucent
@@ -28,6 +28,8 @@
 typedef struct Type Type;
 typedef struct Type Kind; // For documentation purposes only
 typedef struct TypeTable TypeTable;
+typedef struct MemPool MemPool;
+typedef struct MemberIndex MemberIndex;
 
 typedef enum {
 #define f(name, ...) TYPE_##name,
@@ -73,11 +75,15 @@ typedef enum TypeVariance {
     TYPE_INVARIANT = TYPE_COVARIANT | TYPE_CONTRAVARIANT
 } TypeVariance;
 
+// The type table allocates types with only the space needed for the member of the union that
+// corresponds to their tag, so the other members must never be accessed.
 struct Type {
     TypeTag tag;
     bool contains_error : 1;
     bool contains_unknown : 1;
-    size_t id;
+    bool contains_var : 1; // Set when the type may change as variables get bound to values
+    uint32_t id;
+    uint64_t var_mask;     // Summary of the variables in the type, with one bit per variable
     const Kind* kind;
     union {
         struct {
@@ -98,6 +104,9 @@ struct Type {
             size_t type_param_count;
             EnumOption* options;
             size_t option_count;
+            MemberIndex* option_index; // Optional, see `make_member_index()`
+            const Type** ancestors; // Inheritance display, see `get_type_ancestors()`
+            size_t inheritance_depth;
 #ifndef NDEBUG
             bool is_sealed;
 #endif
@@ -109,7 +118,10 @@ struct Type {
             size_t type_param_count;
             StructField* fields;
             size_t field_count;
+            MemberIndex* field_index; // Optional, see `make_member_index()`
             const Type* parent_enum;
+            const Type** ancestors; // Inheritance display, see `get_type_ancestors()`
+            size_t inheritance_depth;
             bool is_tuple_like;
 #ifndef NDEBUG
             bool is_sealed;
@@ -120,6 +132,7 @@ struct Type {
             size_t type_param_count;
             const Type** vars;
             size_t var_count;
+            MemberIndex* var_index; // Optional, see `make_member_index()`
 #ifndef NDEBUG
             bool is_sealed;
 #endif
@@ -166,8 +179,32 @@ typedef struct TypeBounds {
 
 //================================== TYPE MAPS/SETS ======================================
 
-typedef struct TypeMap { HashTable hash_table; } TypeMap;
-typedef struct TypeSet { HashTable hash_table; } TypeSet;
+// Type maps and sets are sparse sets indexed by type identifier: Insertion, lookup, and clearing
+// take constant time. The index array grows up to the largest identifier inserted, which makes
+// creating a new map for every query expensive. Instead, maps should be borrowed from a pool and
+// returned to it after use.
+
+typedef struct TypeMapElem {
+    const Type* from;
+    void* to;
+} TypeMapElem;
+
+typedef struct TypeMap {
+    uint32_t* indices;      // Position of each type in `elems`, indexed by type identifier
+    size_t index_count;
+    TypeMapElem* elems;
+    size_t elem_count;
+    size_t elem_capacity;
+    uint64_t var_mask;      // Union of the variable masks of the keys
+} TypeMap;
+
+typedef struct TypeSet { TypeMap type_map; } TypeSet;
+
+typedef struct TypeMapPool {
+    TypeMap* type_maps;
+    size_t type_map_count;
+    size_t type_map_capacity;
+} TypeMapPool;
 
 TypeMap new_type_map(void);
 TypeSet new_type_set(void);
@@ -180,6 +217,12 @@ bool insert_in_type_set(TypeSet*, const Type*);
 void* find_in_type_map(const TypeMap*, const Type*);
 bool find_in_type_set(const TypeSet*, const Type*);
 
+TypeMapPool new_type_map_pool(void);
+void free_type_map_pool(TypeMapPool*);
+/// Returns an empty type map, which must be given back with `release_type_map()`.
+TypeMap acquire_type_map(TypeMapPool*);
+void release_type_map(TypeMapPool*, TypeMap*);
+
 //========================================================================================
 
 bool is_prim_type(TypeTag);
@@ -200,6 +243,7 @@ bool is_sub_struct_type(TypeTable*, const Type*, const Type*);
 bool is_sub_enum_type(TypeTable*, const Type*, const Type*);
 
 const Type* get_struct_field_type(TypeTable*, const Type*, size_t);
+const Type* replace_types_using_type_app(TypeTable*, const Type* type, const Type* type_app);
 const Type* get_enum_option_param_type(TypeTable*, const Type*, size_t);
 
 const Type* resolve_type(const Type*);
@@ -210,6 +254,11 @@ const Type** get_type_params(const Type*);
 size_t get_type_param_count(const Type*);
 size_t get_prim_type_bitwidth(TypeTag);
 size_t get_type_inheritance_depth(const Type*);
+
+/// Returns the inheritance display of a sealed structure or enumeration, or `NULL` if it is not sealed.
+/// The display is an array in which the ancestor at depth `i` is stored at index `i`, expressed in
+/// terms of the type parameters of the given type. The last element is the given type itself.
+const Type** get_type_ancestors(const Type*);
 const Kind* get_type_kind(const Type*);
 
 void get_type_vars_bounds(const Type*, const Type*, TypeVariance, TypeMap*);
@@ -223,6 +272,15 @@ const Type** find_signature_var(const Type*, const char*);
 const EnumOption* find_enum_option(const Type*, const char*);
 const StructField* find_struct_field(const Type*, const char*);
 
+/// Creates an index mapping the names of the members of a nominal type to their position, so that
+/// the functions above do not need a binary search. The index is empty at first, and is only built
+/// by `record_member_lookup()`. Returns `NULL` when there are too few members for the index to be
+/// worthwhile.
+MemberIndex* make_member_index(MemPool*, size_t member_count);
+/// Records a lookup in the members of a nominal type, and builds its index, allocated in the given
+/// pool, once the members have been looked up often enough.
+void record_member_lookup(MemPool*, const Type*);
+
 void print_type(FormatState*, const Type*);
 
 #ifndef NDEBUG
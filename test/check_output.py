@@ -0,0 +1,45 @@
+#!/usr/bin/env python3
+# Runs a command and checks its exit status and its output (standard output and error combined).
+# usage: check_output.py [--fail] [--expect TEXT]... [--reject TEXT]... -- command...
+
+import subprocess
+import sys
+
+def main(argv):
+    should_fail = False
+    expected, rejected = [], []
+    i = 1
+    while i < len(argv) and argv[i] != '--':
+        if argv[i] == '--fail':
+            should_fail = True
+        elif argv[i] in ('--expect', '--reject') and i + 1 < len(argv):
+            (expected if argv[i] == '--expect' else rejected).append(argv[i + 1])
+            i += 1
+        else:
+            print(f"invalid argument '{argv[i]}'")
+            return 1
+        i += 1
+    command = argv[i + 1:]
+    if not command:
+        print('missing command')
+        return 1
+
+    result = subprocess.run(command, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, text=True)
+    print(result.stdout, end='')
+    status = True
+    # Crashes are never expected, even for commands that should fail
+    if result.returncode < 0 or (result.returncode != 0) != should_fail:
+        print(f'unexpected exit status {result.returncode}')
+        status = False
+    for text in expected:
+        if text not in result.stdout:
+            print(f"missing expected output '{text}'")
+            status = False
+    for text in rejected:
+        if text in result.stdout:
+            print(f"unexpected output '{text}'")
+            status = False
+    return 0 if status else 1
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv))
@@ -0,0 +1,217 @@
+#include "generator.h"
+
+#include <string.h>
+#include <assert.h>
+
+// Maximum length of inheritance chains and chains of module references
+#define MAX_CHAIN_LENGTH 16
+// Number of types declared in the signature used by the where clauses
+#define SIG_TYPE_COUNT 8
+
+const char* get_shape_name(Shape shape) {
+    switch (shape) {
+#define f(name, str, ...) case SHAPE_##name: return str;
+        SHAPE_LIST(f)
+#undef f
+        default:
+            assert(false && "invalid shape");
+            return "";
+    }
+}
+
+const char* get_shape_description(Shape shape) {
+    switch (shape) {
+#define f(name, str, desc) case SHAPE_##name: return desc;
+        SHAPE_LIST(f)
+#undef f
+        default:
+            assert(false && "invalid shape");
+            return "";
+    }
+}
+
+bool find_shape(const char* name, Shape* shape) {
+    for (size_t i = 0; i < SHAPE_COUNT; ++i) {
+        if (!strcmp(get_shape_name(i), name)) {
+            *shape = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool needs_no_type_check(Shape shape) {
+    // Binary expressions are not supported by the type-checker yet
+    return shape == SHAPE_EXPRS;
+}
+
+static void generate_structs(FILE* file, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        if (i % MAX_CHAIN_LENGTH == 0)
+            fprintf(file, "struct S%zu { x%zu: i32 = %zu }\n", i, i, i);
+        else
+            fprintf(file, "struct S%zu : S%zu { x%zu: i32 = %zu }\n", i, i - 1, i, i);
+    }
+    for (size_t i = 0; i < size; ++i)
+        fprintf(file, "const s%zu : S%zu = S%zu {};\n", i, i - i % MAX_CHAIN_LENGTH, i);
+}
+
+static void generate_mods(FILE* file, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        if (i % MAX_CHAIN_LENGTH == 0) {
+            fprintf(file,
+                "mod M%zu[T, U] {\n"
+                "    pub type X = T;\n"
+                "    pub type Y = U;\n"
+                "    pub struct S { x: X, y: Y }\n"
+                "}\n", i);
+        } else {
+            fprintf(file,
+                "mod M%zu[T, U] {\n"
+                "    pub type X = M%zu[U, T].Y;\n"
+                "    pub type Y = M%zu[U, T].X;\n"
+                "    pub struct S { x: X, y: Y }\n"
+                "}\n", i, i - 1, i - 1);
+        }
+    }
+    for (size_t i = 0; i < size; ++i)
+        fprintf(file, "const m%zu = M%zu[i32, i64].S { x = 1 : M%zu[i32, i64].X, y = 2 : i64 };\n", i, i, i);
+}
+
+static void generate_enums(FILE* file, size_t size) {
+    fprintf(file, "enum E {\n");
+    for (size_t i = 0; i < size; ++i) {
+        const char* sep = i + 1 < size ? "," : "";
+        switch (i % 3) {
+            case 0: fprintf(file, "    O%zu%s\n", i, sep); break;
+            case 1: fprintf(file, "    O%zu(i32)%s\n", i, sep); break;
+            default: fprintf(file, "    O%zu { x: i32 }%s\n", i, sep); break;
+        }
+    }
+    fprintf(file, "}\n");
+    for (size_t i = 0; i < size; ++i) {
+        switch (i % 3) {
+            case 0: fprintf(file, "const e%zu : E = E.O%zu;\n", i, i); break;
+            case 1: fprintf(file, "const e%zu : E = E.O%zu(%zu);\n", i, i, i); break;
+            default: fprintf(file, "const e%zu : E = E.O%zu { x = %zu };\n", i, i, i); break;
+        }
+    }
+}
+
+static void generate_exprs(FILE* file, size_t size) {
+    static const char* ops[] = { "+", "*", "-", "&", "|", "^", "<<", ">>" };
+    fprintf(file, "fun f(x: i32, y: i32) -> i32 =\n    x");
+    for (size_t i = 0; i < size; ++i)
+        fprintf(file, "%s %s %s", i % 8 == 7 ? "\n   " : "", ops[i % 8], i % 2 ? "x" : "y");
+    fprintf(file, ";\n");
+}
+
+static void generate_poly_funs(FILE* file, size_t size) {
+    fprintf(file, "fun p0[T, U](t: T, u: U) = (t, u);\n");
+    for (size_t i = 1; i < size; ++i)
+        fprintf(file, "fun p%zu[T, U](t: T, u: U) = p%zu(u, t);\n", i, i - 1);
+    for (size_t i = 0; i < size; ++i)
+        fprintf(file, "const q%zu = p%zu(%zu, %zu : i64);\n", i, i, i, i);
+}
+
+static void generate_where_clauses(FILE* file, size_t size) {
+    fprintf(file, "sig G {\n");
+    for (size_t i = 0; i < SIG_TYPE_COUNT; ++i)
+        fprintf(file, "    type T%zu;\n", i);
+    fprintf(file, "    val g : fun (T0) -> T1;\n}\n");
+    for (size_t i = 0; i < size; ++i) {
+        fprintf(file, "type W%zu = G where { T%zu = i32", i, i % SIG_TYPE_COUNT);
+        if (i % 2 == 1)
+            fprintf(file, ", T%zu = i64", (i + 1) % SIG_TYPE_COUNT);
+        fprintf(file, " };\n");
+    }
+}
+
+static void generate_siblings(FILE* file, size_t size) {
+    fprintf(file, "mod M {\n");
+    for (size_t i = 0; i < size; ++i) {
+        if (i % 2 == 0)
+            fprintf(file, "    pub const c%zu : i32 = %zu;\n", i, i);
+        else
+            fprintf(file, "    pub fun f%zu(x: i32) = (x, c%zu);\n", i, i - 1);
+    }
+    fprintf(file, "}\n");
+}
+
+static void generate_nesting(FILE* file, size_t size) {
+    fprintf(file, "fun f(x0: i32) -> i32 =");
+    for (size_t i = 0; i < size; ++i)
+        fprintf(file, " {\n    const x%zu = x%zu;", i + 1, i);
+    fprintf(file, "\n    x%zu", size);
+    for (size_t i = 0; i < size; ++i)
+        fprintf(file, "\n}");
+    fprintf(file, ";\n");
+}
+
+static void generate_inheritance(FILE* file, size_t size) {
+    fprintf(file, "struct S0 { x0: i32 = 0 }\n");
+    for (size_t i = 1; i < size; ++i)
+        fprintf(file, "struct S%zu : S%zu { x%zu: i32 = %zu }\n", i, i - 1, i, i);
+    for (size_t i = 0; i < size; i += MAX_CHAIN_LENGTH)
+        fprintf(file, "const s%zu : S0 = S%zu {};\n", i, size - 1 - i);
+}
+
+static void generate_type_params(FILE* file, size_t size) {
+    fprintf(file, "struct S[");
+    for (size_t i = 0; i < size; ++i)
+        fprintf(file, "%sT%zu", i > 0 ? ", " : "", i);
+    fprintf(file, "] {");
+    for (size_t i = 0; i < size; ++i)
+        fprintf(file, "%s x%zu: T%zu", i > 0 ? "," : "", i, i);
+    fprintf(file, " }\nfun f[");
+    for (size_t i = 0; i < size; ++i)
+        fprintf(file, "%sT%zu", i > 0 ? ", " : "", i);
+    fprintf(file, "](");
+    for (size_t i = 0; i < size; ++i)
+        fprintf(file, "%sx%zu: T%zu", i > 0 ? ", " : "", i, i);
+    fprintf(file, ") = (");
+    for (size_t i = 0; i < size; ++i)
+        fprintf(file, "%sx%zu", i > 0 ? ", " : "", i);
+    fprintf(file, ");\nconst s = S[");
+    for (size_t i = 0; i < size; ++i)
+        fprintf(file, "%s%s", i > 0 ? ", " : "", i % 2 ? "i64" : "i32");
+    fprintf(file, "] {");
+    for (size_t i = 0; i < size; ++i)
+        fprintf(file, "%s x%zu = %zu : %s", i > 0 ? "," : "", i, i, i % 2 ? "i64" : "i32");
+    fprintf(file, " };\nconst y = f(");
+    for (size_t i = 0; i < size; ++i)
+        fprintf(file, "%s%zu", i > 0 ? ", " : "", i);
+    fprintf(file, ");\n");
+}
+
+static void generate_tuples(FILE* file, size_t size) {
+    fprintf(file, "const t : (");
+    for (size_t i = 0; i < size; ++i)
+        fprintf(file, "%s%s", i > 0 ? ", " : "", i % 2 ? "i64" : "i32");
+    fprintf(file, ") = (");
+    for (size_t i = 0; i < size; ++i)
+        fprintf(file, "%s%zu", i > 0 ? ", " : "", i);
+    fprintf(file, ");\nconst u = (");
+    for (size_t i = 0; i < size; ++i)
+        fprintf(file, "%s(%zu, %zu)", i > 0 ? ", " : "", i, i + 1);
+    fprintf(file, ");\n");
+}
+
+void generate_program(FILE* file, Shape shape, size_t size) {
+    switch (shape) {
+        case SHAPE_STRUCTS:       generate_structs(file, size);       break;
+        case SHAPE_MODS:          generate_mods(file, size);          break;
+        case SHAPE_ENUMS:         generate_enums(file, size);         break;
+        case SHAPE_EXPRS:         generate_exprs(file, size);         break;
+        case SHAPE_POLY_FUNS:     generate_poly_funs(file, size);     break;
+        case SHAPE_WHERE_CLAUSES: generate_where_clauses(file, size); break;
+        case SHAPE_SIBLINGS:      generate_siblings(file, size);      break;
+        case SHAPE_NESTING:       generate_nesting(file, size);       break;
+        case SHAPE_INHERITANCE:   generate_inheritance(file, size);   break;
+        case SHAPE_TYPE_PARAMS:   generate_type_params(file, size);   break;
+        case SHAPE_TUPLES:        generate_tuples(file, size);        break;
+        default:
+            assert(false && "invalid shape");
+            break;
+    }
+}
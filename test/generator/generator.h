@@ -0,0 +1,43 @@
+#ifndef FU_TEST_GENERATOR_H
+#define FU_TEST_GENERATOR_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/*
+ * The generator produces synthetic Fu programs of a given shape, whose size grows linearly with a
+ * size parameter. These programs are used to measure the throughput of the compiler, and how its
+ * running time grows with the size of its input.
+ */
+
+#define SHAPE_LIST(f) \
+    f(STRUCTS, "structs", "structures organized in inheritance chains") \
+    f(MODS, "mods", "parametric modules that refer to each other") \
+    f(ENUMS, "enums", "one enumeration with many options") \
+    f(EXPRS, "exprs", "one long chain of binary expressions") \
+    f(POLY_FUNS, "poly-funs", "polymorphic functions calling each other") \
+    f(WHERE_CLAUSES, "where-clauses", "type aliases of a signature with where clauses") \
+    f(SIBLINGS, "siblings", "sibling declarations in one module") \
+    f(NESTING, "nesting", "deeply nested blocks") \
+    f(INHERITANCE, "inheritance", "one long inheritance chain") \
+    f(TYPE_PARAMS, "type-params", "structures and functions with many type parameters") \
+    f(TUPLES, "tuples", "wide tuples and tuple types")
+
+typedef enum {
+#define f(name, ...) SHAPE_##name,
+    SHAPE_LIST(f)
+#undef f
+    SHAPE_COUNT
+} Shape;
+
+const char* get_shape_name(Shape);
+const char* get_shape_description(Shape);
+bool find_shape(const char* name, Shape*);
+
+/// Returns true if the generated programs use language features that cannot be type-checked yet.
+bool needs_no_type_check(Shape);
+
+void generate_program(FILE*, Shape, size_t size);
+
+#endif
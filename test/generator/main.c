@@ -0,0 +1,35 @@
+#include "generator.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+
+static void usage(void) {
+    printf("usage: generator shape size [output]\nshapes:\n");
+    for (size_t i = 0; i < SHAPE_COUNT; ++i)
+        printf("  %-16s%s\n", get_shape_name(i), get_shape_description(i));
+}
+
+int main(int argc, char** argv) {
+    Shape shape;
+    if (argc < 3 || argc > 4 || !find_shape(argv[1], &shape)) {
+        usage();
+        return EXIT_FAILURE;
+    }
+
+    char* end = NULL;
+    size_t size = strtoull(argv[2], &end, 10);
+    if (*end || size == 0) {
+        fprintf(stderr, "invalid program size '%s'\n", argv[2]);
+        return EXIT_FAILURE;
+    }
+
+    FILE* file = argc == 4 ? fopen(argv[3], "wb") : stdout;
+    if (!file) {
+        fprintf(stderr, "cannot open file '%s'\n", argv[3]);
+        return EXIT_FAILURE;
+    }
+    generate_program(file, shape, size);
+    if (file != stdout)
+        fclose(file);
+    return EXIT_SUCCESS;
+}
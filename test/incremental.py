@@ -0,0 +1,106 @@
+#!/usr/bin/env python3
+# Checks incremental compilation over several runs, on a copy of a two-file program whose second file
+# depends on a structure of the first one.
+# usage: incremental.py fu input_dir
+
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+
+FIRST_FILE = 'first.fu'
+SECOND_FILE = 'second.fu'
+OLD_POINT = 'pub struct Point { x: i32, y: i32 }'
+NEW_POINT = 'pub struct Point { x: i64, y: i32 }'
+OLD_MAKE_POINT = 'pub fun make_point(x: i32'
+NEW_MAKE_POINT = 'pub fun make_point(x: i64'
+# Reported in the second file when the field of the first file changes type
+DEPENDENT_ERROR = "expected at most type 'Geometry.Coord', but got type 'i64'"
+
+class Runner:
+    def __init__(self, fu, work_dir):
+        self.fu = fu
+        self.work_dir = work_dir
+        self.cache_file = os.path.join(work_dir, 'incremental.cache')
+        self.status = True
+
+    def run(self, step, should_fail, expected=None):
+        files = [os.path.join(self.work_dir, file) for file in (FIRST_FILE, SECOND_FILE)]
+        result = subprocess.run([self.fu, '--no-color', '--incremental', self.cache_file] + files,
+            stdout=subprocess.PIPE, stderr=subprocess.STDOUT, text=True)
+        print(f'--- {step}')
+        print(result.stdout, end='')
+        # Crashes are never expected, even for runs that should fail
+        if result.returncode < 0 or (result.returncode != 0) != should_fail:
+            print(f'unexpected exit status {result.returncode}')
+            self.status = False
+        if expected and (expected not in result.stdout or SECOND_FILE not in result.stdout):
+            print(f"missing expected error '{expected}' in '{SECOND_FILE}'")
+            self.status = False
+
+    def edit(self, file, old, new):
+        path = os.path.join(self.work_dir, file)
+        with open(path) as f:
+            data = f.read()
+        if old not in data:
+            print(f"cannot find '{old}' in '{file}'")
+            self.status = False
+        with open(path, 'w') as f:
+            f.write(data.replace(old, new))
+
+    def edit_point(self, is_new):
+        self.edit(FIRST_FILE, *((OLD_POINT, NEW_POINT) if is_new else (NEW_POINT, OLD_POINT)))
+        self.edit(FIRST_FILE, *((OLD_MAKE_POINT, NEW_MAKE_POINT) if is_new else (NEW_MAKE_POINT, OLD_MAKE_POINT)))
+
+    def corrupt_cache(self, corrupt):
+        with open(self.cache_file, 'rb') as f:
+            data = f.read()
+        with open(self.cache_file, 'wb') as f:
+            f.write(corrupt(data))
+
+def drop_deps_of_get_x(data):
+    # Reading this cache up to the invalid record would skip `get_x`, which is clean and has no
+    # dependencies in it, and would thus hide the error
+    lines = data.decode().splitlines()
+    for i, line in enumerate(lines):
+        fields = line.split()
+        if fields[0] == 'get_x':
+            lines[i] = ' '.join(fields[:2] + ['1', '0'])
+    return ('\n'.join(lines) + '\nfile\n').encode()
+
+def main(argv):
+    if len(argv) != 3:
+        print('usage: incremental.py fu input_dir')
+        return 1
+    fu, input_dir = os.path.abspath(argv[1]), argv[2]
+    with tempfile.TemporaryDirectory() as work_dir:
+        for file in (FIRST_FILE, SECOND_FILE):
+            shutil.copy(os.path.join(input_dir, file), work_dir)
+        runner = Runner(fu, work_dir)
+
+        runner.run('first run', False)
+        runner.run('unchanged files', False)
+        runner.edit_point(True)
+        runner.run('changed dependency', True, DEPENDENT_ERROR)
+        # Declarations that had errors are checked again, even if nothing changed
+        runner.run('unchanged files with errors', True, DEPENDENT_ERROR)
+        runner.edit_point(False)
+        runner.run('reverted dependency', False)
+
+        # A cache that cannot be read must not hide the error, since every declaration is checked
+        for name, corrupt in (
+            ('cache with an invalid record', drop_deps_of_get_x),
+            ('truncated cache', lambda data: data[:len(data) // 2]),
+            ('garbage cache', lambda data: bytes(reversed(data))),
+            ('empty cache', lambda data: b'')):
+            runner.run('first run', False)
+            runner.corrupt_cache(corrupt)
+            runner.edit_point(True)
+            runner.run(name, True, DEPENDENT_ERROR)
+            runner.edit_point(False)
+            runner.run(f'{name}, reverted', False)
+        return 0 if runner.status else 1
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv))
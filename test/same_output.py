@@ -0,0 +1,51 @@
+#!/usr/bin/env python3
+# Runs two commands and checks that they have the same exit status and output (standard output and
+# error combined).
+# usage: same_output.py [--fail] -- command... -- other_command...
+
+import subprocess
+import sys
+
+def run(command):
+    result = subprocess.run(command, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, text=True)
+    print(f"--- {' '.join(command)}")
+    print(result.stdout, end='')
+    return result
+
+def main(argv):
+    should_fail = False
+    i = 1
+    while i < len(argv) and argv[i] != '--':
+        if argv[i] == '--fail':
+            should_fail = True
+        else:
+            print(f"invalid argument '{argv[i]}'")
+            return 1
+        i += 1
+    commands = argv[i + 1:]
+    if '--' not in commands:
+        print('missing commands')
+        return 1
+    separator = commands.index('--')
+    command, other_command = commands[:separator], commands[separator + 1:]
+    if not command or not other_command:
+        print('missing command')
+        return 1
+
+    results = [run(command), run(other_command)]
+    status = True
+    for result in results:
+        # Crashes are never expected, even for commands that should fail
+        if result.returncode < 0 or (result.returncode != 0) != should_fail:
+            print(f'unexpected exit status {result.returncode}')
+            status = False
+    if results[0].returncode != results[1].returncode:
+        print('exit statuses differ')
+        status = False
+    if results[0].stdout != results[1].stdout:
+        print('outputs differ')
+        status = False
+    return 0 if status else 1
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv))
@@ -0,0 +1,269 @@
+#include "fu/driver/options.h"
+#include "fu/driver/driver.h"
+#include "fu/driver/session.h"
+#include "fu/core/trace.h"
+#include "fu/core/log.h"
+
+#include "../generator/generator.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+/*
+ * This program checks that the time spent in each pass of the front-end grows at most polynomially
+ * with a given exponent. For each shape of program, it measures the passes on programs of size
+ * N, 2N, 4N, and 8N, and estimates the exponent with a least-squares fit in log-log space.
+ * Programs are compiled repeatedly until every pass has run for a minimum amount of time, so that
+ * fast passes are measured as well. A pass that cannot be measured makes the test fail.
+ */
+
+#define SIZE_COUNT 4
+#define MAX_PASSES 8
+#define DEFAULT_MAX_EXPONENT 1.5
+#define DEFAULT_BASE_SIZE 500
+#define DEFAULT_REPEAT_COUNT 3
+#define DEFAULT_MIN_TIME 2000000 // ns
+#define MAX_ITERATION_COUNT 4096
+#define DEFAULT_WORK_FILE "scaling.fu"
+
+typedef struct {
+    const char* name;
+    double times[SIZE_COUNT]; // Time per compilation, in ns
+    bool is_measured[SIZE_COUNT];
+} PassTimes;
+
+typedef struct {
+    double max_exponent;
+    size_t base_size;
+    size_t repeat_count;
+    uint64_t min_time;
+    const char* work_file;
+} ScalingOptions;
+
+static void usage(void) {
+    printf(
+        "usage: scaling [options] shapes...\n"
+        "options:\n"
+        "  -h    --help          Shows this message\n"
+        "        --max-exponent  Sets the maximum allowed growth exponent (default: %.1f)\n"
+        "        --base-size     Sets the size N of the smallest program (default: %d)\n"
+        "        --repeat        Sets the number of measurements per size, the best is kept (default: %d)\n"
+        "        --work-file     Sets the file in which programs are generated (default: '%s')\n"
+        "shapes:\n",
+        DEFAULT_MAX_EXPONENT, DEFAULT_BASE_SIZE, DEFAULT_REPEAT_COUNT, DEFAULT_WORK_FILE);
+    for (size_t i = 0; i < SHAPE_COUNT; ++i)
+        printf("  %-16s%s\n", get_shape_name(i), get_shape_description(i));
+}
+
+static PassTimes* find_or_insert_pass(PassTimes* passes, size_t* pass_count, const char* name) {
+    for (size_t i = 0; i < *pass_count; ++i) {
+        if (!strcmp(passes[i].name, name))
+            return &passes[i];
+    }
+    if (*pass_count >= MAX_PASSES)
+        return NULL;
+    PassTimes* pass = &passes[(*pass_count)++];
+    pass->name = name;
+    for (size_t i = 0; i < SIZE_COUNT; ++i) {
+        pass->times[i] = HUGE_VAL;
+        pass->is_measured[i] = false;
+    }
+    return pass;
+}
+
+static bool compile_repeatedly(
+    const ScalingOptions* scaling_options,
+    const Options* options,
+    size_t iteration_count,
+    PassTimes* passes,
+    size_t* pass_count,
+    uint64_t* times)
+{
+    // Sums the time spent in each pass over the given number of compilations
+    for (size_t i = 0; i < MAX_PASSES; ++i)
+        times[i] = 0;
+    for (size_t i = 0; i < iteration_count; ++i) {
+        FormatState state = new_format_state("    ", !is_color_supported(stderr));
+        Log log = new_log(&state);
+        Session* session = new_session(options, &log);
+        bool status = compile_file(session, scaling_options->work_file);
+
+        const Span* spans = session->trace->spans.elems;
+        for (size_t j = 0; j < session->trace->spans.size && status; ++j) {
+            if (strcmp(spans[j].category, "pass"))
+                continue;
+            PassTimes* pass = find_or_insert_pass(passes, pass_count, spans[j].name);
+            if (pass)
+                times[pass - passes] += spans[j].end_time - spans[j].begin_time;
+        }
+
+        free_session(session);
+        write_format_state(&state, stderr);
+        free_format_state(&state);
+        free_log(&log);
+        if (!status)
+            return false;
+    }
+    return true;
+}
+
+static bool measure_passes(
+    const ScalingOptions* scaling_options,
+    Shape shape,
+    size_t size_index,
+    PassTimes* passes,
+    size_t* pass_count)
+{
+    FILE* file = fopen(scaling_options->work_file, "wb");
+    if (!file) {
+        fprintf(stderr, "cannot open file '%s'\n", scaling_options->work_file);
+        return false;
+    }
+    generate_program(file, shape, scaling_options->base_size << size_index);
+    fclose(file);
+
+    Options options = default_options;
+    options.time_passes = true;
+    options.no_type_check = needs_no_type_check(shape);
+
+    // Double the number of compilations until the fastest pass runs for long enough
+    size_t iteration_count = 1;
+    uint64_t times[MAX_PASSES];
+    while (true) {
+        if (!compile_repeatedly(scaling_options, &options, iteration_count, passes, pass_count, times))
+            return false;
+        uint64_t min_time = UINT64_MAX;
+        for (size_t i = 0; i < *pass_count; ++i)
+            min_time = times[i] < min_time ? times[i] : min_time;
+        if (min_time >= scaling_options->min_time || iteration_count >= MAX_ITERATION_COUNT)
+            break;
+        iteration_count *= 2;
+    }
+
+    for (size_t i = 0; i < scaling_options->repeat_count; ++i) {
+        if (i > 0 && !compile_repeatedly(scaling_options, &options, iteration_count, passes, pass_count, times))
+            return false;
+        // Only keep the best time for each pass, as the other measurements contain more noise
+        for (size_t j = 0; j < *pass_count; ++j) {
+            double time = (double)times[j] / (double)iteration_count;
+            if (time < passes[j].times[size_index])
+                passes[j].times[size_index] = time;
+            passes[j].is_measured[size_index] |= times[j] >= scaling_options->min_time;
+        }
+    }
+    return true;
+}
+
+static double estimate_exponent(const double* times) {
+    // Least-squares fit of log(time) = exponent * log(size) + c, with sizes 1, 2, 4, ...
+    double mean_x = 0, mean_y = 0;
+    for (size_t i = 0; i < SIZE_COUNT; ++i) {
+        mean_x += (double)i;
+        mean_y += log2(times[i]);
+    }
+    mean_x /= SIZE_COUNT;
+    mean_y /= SIZE_COUNT;
+    double num = 0, den = 0;
+    for (size_t i = 0; i < SIZE_COUNT; ++i) {
+        double dx = (double)i - mean_x;
+        num += dx * (log2(times[i]) - mean_y);
+        den += dx * dx;
+    }
+    return num / den;
+}
+
+static bool check_shape(const ScalingOptions* options, Shape shape) {
+    PassTimes passes[MAX_PASSES];
+    size_t pass_count = 0;
+    for (size_t i = 0; i < SIZE_COUNT; ++i) {
+        if (!measure_passes(options, shape, i, passes, &pass_count)) {
+            printf("%-16s failed to compile a program of size %zu\n", get_shape_name(shape), options->base_size << i);
+            return false;
+        }
+    }
+
+    bool status = true;
+    for (size_t i = 0; i < pass_count; ++i) {
+        printf("%-16s %-8s", get_shape_name(shape), passes[i].name);
+        for (size_t j = 0; j < SIZE_COUNT; ++j)
+            printf(" %10.3fms", passes[i].times[j] * 1.0e-6);
+        bool is_measured = true;
+        for (size_t j = 0; j < SIZE_COUNT; ++j)
+            is_measured &= passes[i].is_measured[j];
+        if (!is_measured) {
+            printf("  too fast to measure FAILED\n");
+            status = false;
+            continue;
+        }
+        // Avoid taking the logarithm of zero
+        for (size_t j = 0; j < SIZE_COUNT; ++j)
+            passes[i].times[j] = passes[i].times[j] > 0 ? passes[i].times[j] : 1;
+        double exponent = estimate_exponent(passes[i].times);
+        bool is_ok = exponent <= options->max_exponent;
+        printf("  exponent %.2f %s\n", exponent, is_ok ? "ok" : "FAILED");
+        status &= is_ok;
+    }
+    return status;
+}
+
+static inline bool check_option_arg(int i, int argc, char** argv) {
+    if (i + 1 >= argc) {
+        fprintf(stderr, "missing argument for option '%s'\n", argv[i]);
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    ScalingOptions options = {
+        .max_exponent = DEFAULT_MAX_EXPONENT,
+        .base_size = DEFAULT_BASE_SIZE,
+        .repeat_count = DEFAULT_REPEAT_COUNT,
+        .min_time = DEFAULT_MIN_TIME,
+        .work_file = DEFAULT_WORK_FILE
+    };
+    bool shapes[SHAPE_COUNT] = { false };
+    size_t shape_count = 0;
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help")) {
+            usage();
+            return EXIT_SUCCESS;
+        } else if (!strcmp(argv[i], "--max-exponent")) {
+            if (!check_option_arg(i, argc, argv))
+                return EXIT_FAILURE;
+            options.max_exponent = strtod(argv[++i], NULL);
+        } else if (!strcmp(argv[i], "--base-size")) {
+            if (!check_option_arg(i, argc, argv))
+                return EXIT_FAILURE;
+            options.base_size = strtoull(argv[++i], NULL, 10);
+        } else if (!strcmp(argv[i], "--repeat")) {
+            if (!check_option_arg(i, argc, argv))
+                return EXIT_FAILURE;
+            options.repeat_count = strtoull(argv[++i], NULL, 10);
+        } else if (!strcmp(argv[i], "--work-file")) {
+            if (!check_option_arg(i, argc, argv))
+                return EXIT_FAILURE;
+            options.work_file = argv[++i];
+        } else {
+            Shape shape;
+            if (!find_shape(argv[i], &shape)) {
+                fprintf(stderr, "unknown shape '%s'\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+            shape_count += !shapes[shape];
+            shapes[shape] = true;
+        }
+    }
+    if (shape_count == 0 || options.base_size == 0 || options.repeat_count == 0) {
+        usage();
+        return EXIT_FAILURE;
+    }
+
+    bool status = true;
+    for (size_t i = 0; i < SHAPE_COUNT; ++i) {
+        if (shapes[i])
+            status &= check_shape(&options, i);
+    }
+    return status ? EXIT_SUCCESS : EXIT_FAILURE;
+}